@@ -0,0 +1,133 @@
+#include "association_events.h"
+
+#include <utility>
+
+#include "siprec_metadata_internal.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+class EventLine
+{
+   private:
+    std::string& out_;
+
+   public:
+    EventLine(std::string& out, std::string_view recording, std::string_view event, std::string_view kind,
+              const Timestamp& time)
+        : out_(out)
+    {
+        out_.append("{\"recording\":");
+        AppendJSONString(out_, recording);
+        out_.append(",\"event\":\"");
+        out_.append(event);
+        out_.append("\",\"kind\":\"");
+        out_.append(kind);
+        out_.append("\",\"time\":\"");
+        char text[Timestamp::rfc3339_max_size];
+        out_.append(text, time.to_rfc3339(text));
+        out_.push_back('"');
+    }
+
+    ~EventLine() { out_.append("}\n"); }
+
+    void Member(std::string_view key, std::string_view value)
+    {
+        out_.append(",\"");
+        out_.append(key);
+        out_.append("\":");
+        AppendJSONString(out_, value);
+    }
+
+    void Member(std::string_view key, bool value)
+    {
+        out_.append(",\"");
+        out_.append(key);
+        out_.append(value ? "\":true" : "\":false");
+    }
+};
+
+// One line at the associate time and one at the disassociate time, if any
+template <typename Association, typename Members>
+void AppendEvents(std::string& out, std::string_view recording, std::string_view kind, const Association& assoc,
+                  Members members)
+{
+    {
+        EventLine line(out, recording, "associate", kind, assoc.AssociateTime());
+        members(line);
+    }
+    if (assoc.DisassociateTime()) {
+        EventLine line(out, recording, "disassociate", kind, assoc.DisassociateTime().value());
+        members(line);
+    }
+}
+}  // namespace
+
+AssociationEventExporter::AssociationEventExporter(Sink sink, std::size_t flush_bytes)
+    : sink_(std::move(sink)), flush_bytes_(flush_bytes)
+{
+    buffer_.reserve(flush_bytes_ + 1024);
+}
+
+AssociationEventExporter::~AssociationEventExporter() { Flush(); }
+
+template <typename Source>
+bool AssociationEventExporter::ExportEvents(const Source& source, std::string_view recording)
+{
+    // Lines are flushed one element at a time, so the buffer never grows much past the threshold
+    auto flush_if_full = [&] { return (buffer_.size() < flush_bytes_) or Flush(); };
+
+    for (const auto& element : source.CS_RS_Associations()) {
+        const auto& assoc = Deref(element);
+        AppendEvents(buffer_, recording, "session_recording", assoc,
+                     [&](EventLine& line) { line.Member("session_id", assoc.SessionId()); });
+        if (not flush_if_full())
+            return false;
+    }
+
+    for (const auto& element : source.ParticipantSessionAssociations()) {
+        const auto& assoc = Deref(element);
+        AppendEvents(buffer_, recording, "participant_session", assoc, [&](EventLine& line) {
+            line.Member("participant_id", assoc.ParticipantId());
+            line.Member("session_id", assoc.SessionId());
+        });
+        if (not flush_if_full())
+            return false;
+    }
+
+    for (const auto& element : source.ParticipantStreamAssociations()) {
+        const auto& assoc = Deref(element);
+        AppendEvents(buffer_, recording, "participant_stream", assoc, [&](EventLine& line) {
+            line.Member("participant_id", assoc.ParticipantId());
+            line.Member("stream_id", assoc.StreamId());
+            line.Member("send", assoc.IsSender());
+            line.Member("recv", assoc.IsReceiver());
+        });
+        if (not flush_if_full())
+            return false;
+    }
+
+    return true;
+}
+
+bool AssociationEventExporter::Export(const RecordingSession& session, std::string_view recording)
+{
+    return not failed_ and ExportEvents(session, recording);
+}
+
+bool AssociationEventExporter::Export(const RecordingSessionSnapshot& snapshot, std::string_view recording)
+{
+    return not failed_ and ExportEvents(snapshot, recording);
+}
+
+bool AssociationEventExporter::Flush()
+{
+    if (failed_)
+        return false;
+    if (buffer_.empty())
+        return true;
+    failed_ = not sink_(buffer_);
+    buffer_.clear();
+    return not failed_;
+}
@@ -0,0 +1,61 @@
+// association_events.h
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+/**
+ * @brief Streams association and disassociation events of recording sessions as NDJSON
+ *
+ * Every association of a session with the recording, of a participant with a session and of a participant with a
+ * stream becomes one line at its associate time, and one more line at its disassociate time if it has one:
+ *
+ *   {"recording":"call-1","event":"associate","kind":"participant_stream","time":"2024-05-06T10:00:00Z",
+ *    "participant_id":"...","stream_id":"...","send":true,"recv":false}
+ *
+ * Lines are collected in a buffer which is handed to the sink whenever it grows past the flush threshold, so memory
+ * use does not depend on the number or the size of the exported sessions.
+ *
+ */
+class AssociationEventExporter
+{
+   public:
+    // Receives complete lines, returns false to stop the export
+    using Sink = std::function<bool(std::string_view)>;
+
+   private:
+    Sink sink_;
+    std::size_t flush_bytes_;
+    std::string buffer_;
+    bool failed_ = false;
+
+    template <typename Source>
+    bool ExportEvents(const Source &source, std::string_view recording);
+
+   public:
+    explicit AssociationEventExporter(Sink sink, std::size_t flush_bytes = 64 * 1024);
+    ~AssociationEventExporter();
+
+    AssociationEventExporter(const AssociationEventExporter &) = delete;
+    AssociationEventExporter &operator=(const AssociationEventExporter &) = delete;
+
+    /**
+     * @brief Export the events of a session, labelled with the recording key (for example the Call-ID)
+     */
+    bool Export(const RecordingSession &session, std::string_view recording);
+    bool Export(const RecordingSessionSnapshot &snapshot, std::string_view recording);
+
+    /**
+     * @brief Hand the buffered lines to the sink
+     */
+    bool Flush();
+};
+
+}  // namespace siprec_metadata
@@ -0,0 +1,533 @@
+#include "columnar_export.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
+#include "siprec_metadata_internal.h"
+
+using namespace siprec_metadata;
+
+/*
+ * Columnar file layout, version 1. Integers are little-endian, strings are a u32 length followed by the bytes.
+ *
+ *   header      "SRMC", u32 version, u32 table count
+ *   directory   per table: name, u64 rows, u32 column count
+ *               per column: name, u8 type, u64 offset, u64 size, u64 dictionary offset, u64 dictionary size
+ *   columns     values of every column, fixed width by type
+ *   dictionaries  per string column: u32 count, then the strings in code order
+ */
+
+static_assert(std::endian::native == std::endian::little, "columnar integers are stored in host byte order");
+
+namespace
+{
+constexpr std::string_view columnar_magic = "SRMC";
+constexpr std::uint32_t columnar_version = 1;
+constexpr std::uint64_t max_string_size = 1 << 30;
+
+struct ColumnSchema
+{
+    std::string_view name;
+    ColumnType type;
+};
+
+struct TableSchema
+{
+    std::string_view name;
+    std::vector<ColumnSchema> columns;
+};
+
+const std::vector<TableSchema>& Schema()
+{
+    static const std::vector<TableSchema> schema = {
+        {"participants", {{"recording", ColumnType::String}, {"participant_id", ColumnType::String}}},
+        {"name_ids",
+         {{"recording", ColumnType::String},
+          {"participant_id", ColumnType::String},
+          {"name", ColumnType::String},
+          {"aor", ColumnType::String}}},
+        {"streams",
+         {{"recording", ColumnType::String},
+          {"stream_id", ColumnType::String},
+          {"session_id", ColumnType::String},
+          {"label", ColumnType::String},
+          {"content_type", ColumnType::String}}},
+        {"session_recording_associations",
+         {{"recording", ColumnType::String},
+          {"session_id", ColumnType::String},
+          {"associate_time", ColumnType::Time},
+          {"disassociate_time", ColumnType::Time}}},
+        {"participant_session_associations",
+         {{"recording", ColumnType::String},
+          {"participant_id", ColumnType::String},
+          {"session_id", ColumnType::String},
+          {"associate_time", ColumnType::Time},
+          {"disassociate_time", ColumnType::Time}}},
+        {"participant_stream_associations",
+         {{"recording", ColumnType::String},
+          {"participant_id", ColumnType::String},
+          {"stream_id", ColumnType::String},
+          {"send", ColumnType::Bool},
+          {"recv", ColumnType::Bool},
+          {"associate_time", ColumnType::Time},
+          {"disassociate_time", ColumnType::Time}}},
+    };
+    return schema;
+}
+
+// Positions of the tables in the schema
+enum TableIndex : std::size_t
+{
+    ParticipantsTable,
+    NameIdsTable,
+    StreamsTable,
+    CSRSAssociationsTable,
+    ParticipantSessionAssociationsTable,
+    ParticipantStreamAssociationsTable,
+};
+
+template <typename T>
+T Load(const char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void Store(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void StoreString(std::string& out, std::string_view value)
+{
+    Store<std::uint32_t>(out, static_cast<std::uint32_t>(value.size()));
+    out.append(value);
+}
+
+std::size_t ValueSize(ColumnType type)
+{
+    switch (type) {
+        case ColumnType::String:
+            return sizeof(std::uint32_t);
+        case ColumnType::Time:
+            return sizeof(std::int64_t);
+        case ColumnType::Bool:
+            return sizeof(std::uint8_t);
+    }
+    return 0;
+}
+
+struct StringHash
+{
+    using is_transparent = void;
+    std::size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+};
+
+struct Column
+{
+    ColumnType type;
+    std::string values;
+    std::vector<std::string> dictionary;
+    std::unordered_map<std::string, std::uint32_t, StringHash, std::equal_to<>> codes;
+
+    std::uint32_t Code(std::string_view value)
+    {
+        auto code_it = codes.find(value);
+        if (code_it != codes.end())
+            return code_it->second;
+        const auto code = static_cast<std::uint32_t>(dictionary.size());
+        dictionary.emplace_back(value);
+        codes.emplace(dictionary.back(), code);
+        return code;
+    }
+};
+
+struct Table
+{
+    std::size_t rows = 0;
+    std::vector<Column> columns;
+};
+
+// Appends the values of one row column by column
+class Row
+{
+   private:
+    std::vector<Column>& columns_;
+    std::size_t column_ = 0;
+
+   public:
+    explicit Row(Table& table) : columns_(table.columns) { ++table.rows; }
+
+    Row& String(std::string_view value)
+    {
+        auto& column = columns_[column_++];
+        Store<std::uint32_t>(column.values, column.Code(value));
+        return *this;
+    }
+
+    template <typename Text>
+    Row& OptionalString(const std::optional<Text>& value)
+    {
+        if (value)
+            return String(value.value());
+        Store<std::uint32_t>(columns_[column_++].values, null_string_code);
+        return *this;
+    }
+
+    Row& Time(const Timestamp& time)
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_point().time_since_epoch());
+        Store<std::int64_t>(columns_[column_++].values, ns.count());
+        return *this;
+    }
+
+    Row& Time(const std::optional<Timestamp>& time)
+    {
+        if (time)
+            return Time(time.value());
+        Store<std::int64_t>(columns_[column_++].values, null_time);
+        return *this;
+    }
+
+    Row& Bool(bool value)
+    {
+        Store<std::uint8_t>(columns_[column_++].values, value ? 1 : 0);
+        return *this;
+    }
+};
+}  // namespace
+
+struct ColumnarExporter::Tables
+{
+    std::vector<Table> tables;
+
+    Tables()
+    {
+        for (const auto& table_schema : Schema()) {
+            auto& table = tables.emplace_back();
+            for (const auto& column_schema : table_schema.columns) {
+                table.columns.push_back(Column{column_schema.type, {}, {}, {}});
+            }
+        }
+    }
+};
+
+ColumnarExporter::ColumnarExporter() : tables_(std::make_unique<Tables>()) {}
+
+ColumnarExporter::~ColumnarExporter() = default;
+
+template <typename Source>
+void ColumnarExporter::AddRows(const Source& source, std::string_view recording)
+{
+    auto& tables = tables_->tables;
+
+    for (const auto& element : source.Participants()) {
+        const auto& participant = Deref(element);
+        Row(tables[ParticipantsTable]).String(recording).String(participant.ParticipantId());
+        for (const auto& [name, aor] : participant.NameIds()) {
+            Row(tables[NameIdsTable])
+                .String(recording)
+                .String(participant.ParticipantId())
+                .String(name)
+                .String(aor);
+        }
+    }
+
+    for (const auto& element : source.MediaStreams()) {
+        const auto& stream = Deref(element);
+        Row(tables[StreamsTable])
+            .String(recording)
+            .String(stream.StreamId())
+            .String(stream.SessionId())
+            .String(stream.Label())
+            .OptionalString(stream.ContentType());
+    }
+
+    for (const auto& element : source.CS_RS_Associations()) {
+        const auto& assoc = Deref(element);
+        Row(tables[CSRSAssociationsTable])
+            .String(recording)
+            .String(assoc.SessionId())
+            .Time(assoc.AssociateTime())
+            .Time(assoc.DisassociateTime());
+    }
+
+    for (const auto& element : source.ParticipantSessionAssociations()) {
+        const auto& assoc = Deref(element);
+        Row(tables[ParticipantSessionAssociationsTable])
+            .String(recording)
+            .String(assoc.ParticipantId())
+            .String(assoc.SessionId())
+            .Time(assoc.AssociateTime())
+            .Time(assoc.DisassociateTime());
+    }
+
+    for (const auto& element : source.ParticipantStreamAssociations()) {
+        const auto& assoc = Deref(element);
+        Row(tables[ParticipantStreamAssociationsTable])
+            .String(recording)
+            .String(assoc.ParticipantId())
+            .String(assoc.StreamId())
+            .Bool(assoc.IsSender())
+            .Bool(assoc.IsReceiver())
+            .Time(assoc.AssociateTime())
+            .Time(assoc.DisassociateTime());
+    }
+}
+
+void ColumnarExporter::Add(const RecordingSession& session, std::string_view recording) { AddRows(session, recording); }
+
+void ColumnarExporter::Add(const RecordingSessionSnapshot& snapshot, std::string_view recording)
+{
+    AddRows(snapshot, recording);
+}
+
+std::size_t ColumnarExporter::Rows(std::string_view table) const
+{
+    const auto& schema = Schema();
+    auto schema_it = std::ranges::find(schema, table, &TableSchema::name);
+    if (schema_it == schema.end())
+        return 0;
+    return tables_->tables[static_cast<std::size_t>(schema_it - schema.begin())].rows;
+}
+
+void ColumnarExporter::Clear() { tables_ = std::make_unique<Tables>(); }
+
+bool ColumnarExporter::Write(const std::string& path) const
+{
+    const auto& schema = Schema();
+    const auto& tables = tables_->tables;
+
+    std::vector<std::string> dictionaries;
+    for (const auto& table : tables) {
+        for (const auto& column : table.columns) {
+            auto& dictionary = dictionaries.emplace_back();
+            if (column.type != ColumnType::String)
+                continue;
+            Store<std::uint32_t>(dictionary, static_cast<std::uint32_t>(column.dictionary.size()));
+            for (const auto& value : column.dictionary) {
+                StoreString(dictionary, value);
+            }
+        }
+    }
+
+    // The directory has a fixed size, so it is built once to learn where the data starts and once more with offsets
+    auto directory = [&](std::uint64_t data_offset) {
+        std::string out(columnar_magic);
+        Store<std::uint32_t>(out, columnar_version);
+        Store<std::uint32_t>(out, static_cast<std::uint32_t>(tables.size()));
+        std::uint64_t offset = data_offset;
+        std::size_t dictionary_index = 0;
+        for (std::size_t t = 0; t < tables.size(); ++t) {
+            StoreString(out, schema[t].name);
+            Store<std::uint64_t>(out, tables[t].rows);
+            Store<std::uint32_t>(out, static_cast<std::uint32_t>(tables[t].columns.size()));
+            for (std::size_t c = 0; c < tables[t].columns.size(); ++c) {
+                const auto& column = tables[t].columns[c];
+                const auto& dictionary = dictionaries[dictionary_index++];
+                StoreString(out, schema[t].columns[c].name);
+                Store<std::uint8_t>(out, static_cast<std::uint8_t>(column.type));
+                Store<std::uint64_t>(out, offset);
+                Store<std::uint64_t>(out, column.values.size());
+                offset += column.values.size();
+                Store<std::uint64_t>(out, dictionary.empty() ? 0 : offset);
+                Store<std::uint64_t>(out, dictionary.size());
+                offset += dictionary.size();
+            }
+        }
+        return out;
+    };
+    const std::string header = directory(directory(0).size());
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (not file)
+        return false;
+    bool ok = (std::fwrite(header.data(), 1, header.size(), file) == header.size());
+    std::size_t dictionary_index = 0;
+    for (const auto& table : tables) {
+        for (const auto& column : table.columns) {
+            const auto& dictionary = dictionaries[dictionary_index++];
+            ok = ok and (std::fwrite(column.values.data(), 1, column.values.size(), file) == column.values.size())
+                 and (std::fwrite(dictionary.data(), 1, dictionary.size(), file) == dictionary.size());
+        }
+    }
+    return (std::fclose(file) == 0) and ok;
+}
+
+ColumnarReader::~ColumnarReader() { Close(); }
+
+bool ColumnarReader::Open(const std::string& path)
+{
+    Close();
+    file_ = std::fopen(path.c_str(), "rb");
+    if (not file_)
+        return false;
+
+    // Directory
+    std::string block;
+    std::size_t pos = 0;
+    auto need = [&](std::size_t size) {
+        if (block.size() - pos >= size)
+            return true;
+        // The directory is small, it is read in growing pieces until it is complete
+        const std::size_t missing = size - (block.size() - pos);
+        const std::size_t read_size = std::max<std::size_t>(missing, 4096);
+        const std::size_t old_size = block.size();
+        block.resize(old_size + read_size);
+        const std::size_t read = std::fread(block.data() + old_size, 1, read_size, file_);
+        block.resize(old_size + read);
+        return (read >= missing);
+    };
+    auto read_string = [&](std::string& value) {
+        if (not need(4))
+            return false;
+        const auto size = Load<std::uint32_t>(block.data() + pos);
+        pos += 4;
+        if ((size > max_string_size) or not need(size))
+            return false;
+        value.assign(block, pos, size);
+        pos += size;
+        return true;
+    };
+
+    bool ok = need(12) and std::string_view(block).starts_with(columnar_magic)
+              and (Load<std::uint32_t>(block.data() + 4) == columnar_version);
+    std::uint32_t table_count = 0;
+    if (ok) {
+        table_count = Load<std::uint32_t>(block.data() + 8);
+        pos = 12;
+    }
+    for (std::uint32_t t = 0; ok and (t < table_count); ++t) {
+        auto& table = tables_.emplace_back();
+        ok = read_string(table.name) and need(12);
+        if (not ok)
+            break;
+        table.rows = Load<std::uint64_t>(block.data() + pos);
+        const auto column_count = Load<std::uint32_t>(block.data() + pos + 8);
+        pos += 12;
+        for (std::uint32_t c = 0; ok and (c < column_count); ++c) {
+            auto& column = table.columns.emplace_back();
+            ok = read_string(column.name) and need(33);
+            if (not ok)
+                break;
+            column.type = static_cast<ColumnType>(Load<std::uint8_t>(block.data() + pos));
+            column.offset = Load<std::uint64_t>(block.data() + pos + 1);
+            column.size = Load<std::uint64_t>(block.data() + pos + 9);
+            column.dictionary_offset = Load<std::uint64_t>(block.data() + pos + 17);
+            column.dictionary_size = Load<std::uint64_t>(block.data() + pos + 25);
+            pos += 33;
+            const auto value_size = ValueSize(column.type);
+            ok = (value_size != 0) and (column.size == table.rows * value_size);
+        }
+    }
+
+    ok = ok and (std::fseek(file_, 0, SEEK_END) == 0);
+    if (ok) {
+        file_size_ = static_cast<std::uint64_t>(std::ftell(file_));
+        for (const auto& table : tables_) {
+            for (const auto& column : table.columns) {
+                ok = ok and (column.offset <= file_size_) and (column.size <= file_size_ - column.offset)
+                     and (column.dictionary_offset <= file_size_)
+                     and (column.dictionary_size <= file_size_ - column.dictionary_offset);
+            }
+        }
+    }
+    if (not ok)
+        Close();
+    return ok;
+}
+
+void ColumnarReader::Close()
+{
+    if (file_)
+        std::fclose(file_);
+    file_ = nullptr;
+    file_size_ = 0;
+    tables_.clear();
+}
+
+const ColumnarReader::ColumnInfo* ColumnarReader::Find(std::string_view table, std::string_view column,
+                                                         ColumnType type) const
+{
+    auto table_it = std::ranges::find(tables_, table, &TableInfo::name);
+    if (table_it == tables_.end())
+        return nullptr;
+    auto column_it = std::ranges::find(table_it->columns, column, &ColumnInfo::name);
+    if ((column_it == table_it->columns.end()) or (column_it->type != type))
+        return nullptr;
+    return &*column_it;
+}
+
+bool ColumnarReader::ReadBlock(std::uint64_t offset, std::uint64_t size, std::string& block) const
+{
+    block.resize(size);
+    if (size == 0)
+        return true;
+    return file_ and (std::fseek(file_, static_cast<long>(offset), SEEK_SET) == 0)
+           and (std::fread(block.data(), 1, size, file_) == size);
+}
+
+bool ColumnarReader::ReadCodes(std::string_view table, std::string_view column,
+                               std::vector<std::uint32_t>& codes) const
+{
+    const auto* info = Find(table, column, ColumnType::String);
+    std::string block;
+    if (not info or not ReadBlock(info->offset, info->size, block))
+        return false;
+    codes.resize(block.size() / sizeof(std::uint32_t));
+    std::memcpy(codes.data(), block.data(), block.size());
+    return true;
+}
+
+bool ColumnarReader::ReadDictionary(std::string_view table, std::string_view column,
+                                    std::vector<std::string>& dictionary) const
+{
+    const auto* info = Find(table, column, ColumnType::String);
+    std::string block;
+    if (not info or not ReadBlock(info->dictionary_offset, info->dictionary_size, block) or (block.size() < 4))
+        return false;
+    const auto count = Load<std::uint32_t>(block.data());
+    dictionary.clear();
+    std::size_t pos = 4;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (block.size() - pos < 4)
+            return false;
+        const auto size = Load<std::uint32_t>(block.data() + pos);
+        pos += 4;
+        if (block.size() - pos < size)
+            return false;
+        dictionary.emplace_back(block, pos, size);
+        pos += size;
+    }
+    return true;
+}
+
+bool ColumnarReader::ReadTimes(std::string_view table, std::string_view column, std::vector<std::int64_t>& times) const
+{
+    const auto* info = Find(table, column, ColumnType::Time);
+    std::string block;
+    if (not info or not ReadBlock(info->offset, info->size, block))
+        return false;
+    times.resize(block.size() / sizeof(std::int64_t));
+    std::memcpy(times.data(), block.data(), block.size());
+    return true;
+}
+
+bool ColumnarReader::ReadBools(std::string_view table, std::string_view column, std::vector<bool>& values) const
+{
+    const auto* info = Find(table, column, ColumnType::Bool);
+    std::string block;
+    if (not info or not ReadBlock(info->offset, info->size, block))
+        return false;
+    values.assign(block.size(), false);
+    for (std::size_t i = 0; i < block.size(); ++i) {
+        values[i] = (block[i] != 0);
+    }
+    return true;
+}
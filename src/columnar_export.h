@@ -0,0 +1,143 @@
+// columnar_export.h
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+enum class ColumnType : std::uint8_t
+{
+    String = 1,  // u32 codes into the dictionary of the column
+    Time = 2,    // i64 nanoseconds since the Unix epoch
+    Bool = 3,    // u8
+};
+
+// Absent optional values
+constexpr std::uint32_t null_string_code = std::numeric_limits<std::uint32_t>::max();
+constexpr std::int64_t null_time = std::numeric_limits<std::int64_t>::min();
+
+/**
+ * @brief Accumulates participants, streams and associations of many recording sessions in column buffers
+ *
+ * Tables and their columns, every table starts with the recording key given to Add():
+ *
+ *   participants                       recording, participant_id
+ *   name_ids                           recording, participant_id, name, aor
+ *   streams                            recording, stream_id, session_id, label, content_type
+ *   session_recording_associations     recording, session_id, associate_time, disassociate_time
+ *   participant_session_associations   recording, participant_id, session_id, associate_time, disassociate_time
+ *   participant_stream_associations    recording, participant_id, stream_id, send, recv, associate_time,
+ *                                      disassociate_time
+ *
+ * String columns are dictionary encoded per column, so a scan of one column never reads the strings of another.
+ *
+ */
+class ColumnarExporter
+{
+   private:
+    struct Tables;
+    std::unique_ptr<Tables> tables_;
+
+    template <typename Source>
+    void AddRows(const Source &source, std::string_view recording);
+
+   public:
+    ColumnarExporter();
+    ~ColumnarExporter();
+
+    ColumnarExporter(const ColumnarExporter &) = delete;
+    ColumnarExporter &operator=(const ColumnarExporter &) = delete;
+
+    void Add(const RecordingSession &session, std::string_view recording);
+    void Add(const RecordingSessionSnapshot &snapshot, std::string_view recording);
+
+    /**
+     * @brief Number of rows accumulated in a table
+     */
+    std::size_t Rows(std::string_view table) const;
+
+    /**
+     * @brief Write the tables to a file
+     */
+    bool Write(const std::string &path) const;
+
+    /**
+     * @brief Drop the accumulated rows
+     */
+    void Clear();
+};
+
+/**
+ * @brief Reads single columns of a file written by ColumnarExporter
+ *
+ * Only the table directory is read on Open(); every column and its dictionary are read on request.
+ *
+ */
+class ColumnarReader
+{
+   public:
+    struct ColumnInfo
+    {
+        std::string name;
+        ColumnType type;
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint64_t dictionary_offset;
+        std::uint64_t dictionary_size;
+    };
+
+    struct TableInfo
+    {
+        std::string name;
+        std::uint64_t rows;
+        std::vector<ColumnInfo> columns;
+    };
+
+   private:
+    std::FILE *file_ = nullptr;
+    std::uint64_t file_size_ = 0;
+    std::vector<TableInfo> tables_;
+
+    const ColumnInfo *Find(std::string_view table, std::string_view column, ColumnType type) const;
+    bool ReadBlock(std::uint64_t offset, std::uint64_t size, std::string &block) const;
+
+   public:
+    ColumnarReader() = default;
+    ~ColumnarReader();
+
+    ColumnarReader(const ColumnarReader &) = delete;
+    ColumnarReader &operator=(const ColumnarReader &) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+
+    const std::vector<TableInfo> &Tables() const { return tables_; }
+
+    /**
+     * @brief Dictionary codes of a string column, null_string_code for absent values
+     */
+    bool ReadCodes(std::string_view table, std::string_view column, std::vector<std::uint32_t> &codes) const;
+
+    /**
+     * @brief Dictionary of a string column
+     */
+    bool ReadDictionary(std::string_view table, std::string_view column, std::vector<std::string> &dictionary) const;
+
+    /**
+     * @brief Values of a time column, null_time for absent values
+     */
+    bool ReadTimes(std::string_view table, std::string_view column, std::vector<std::int64_t> &times) const;
+
+    bool ReadBools(std::string_view table, std::string_view column, std::vector<bool> &values) const;
+};
+
+}  // namespace siprec_metadata
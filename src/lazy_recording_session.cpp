@@ -0,0 +1,380 @@
+#include "lazy_recording_session.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "pugixml.hpp"
+#include "siprec_metadata_internal.h"
+#include "siprec_metadata_schema.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+bool IsSpace(char c) { return (c == ' ') or (c == '\t') or (c == '\n') or (c == '\r'); }
+
+void AppendUTF8(std::string& out, std::uint32_t code)
+{
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// Length of the reference at the start of the text, 0 if it is not one that pugixml replaces
+std::size_t AppendReference(std::string& out, std::string_view text)
+{
+    const std::size_t end = text.find(';');
+    if ((end == std::string_view::npos) or (end < 2))
+        return 0;
+    const std::string_view name = text.substr(1, end - 1);
+
+    static constexpr std::pair<std::string_view, char> entities[] = {
+        {"lt", '<'}, {"gt", '>'}, {"amp", '&'}, {"quot", '"'}, {"apos", '\''}};
+    for (const auto& [entity, c] : entities) {
+        if (name == entity) {
+            out.push_back(c);
+            return end + 1;
+        }
+    }
+
+    if (name[0] != '#')
+        return 0;
+    const bool hex = (name.size() > 1) and (name[1] == 'x');
+    const std::string_view digits = name.substr(hex ? 2 : 1);
+    if (digits.empty() or (digits.size() > 8))
+        return 0;
+    std::uint32_t code = 0;
+    for (const char c : digits) {
+        std::uint32_t digit;
+        if ((c >= '0') and (c <= '9'))
+            digit = c - '0';
+        else if (hex and (c >= 'a') and (c <= 'f'))
+            digit = c - 'a' + 10;
+        else if (hex and (c >= 'A') and (c <= 'F'))
+            digit = c - 'A' + 10;
+        else
+            return 0;
+        code = code * (hex ? 16 : 10) + digit;
+    }
+    if (code > 0x10FFFF)
+        return 0;
+    AppendUTF8(out, code);
+    return end + 1;
+}
+
+// Character data decoded the way pugixml does by default: escapes are replaced, line ends become '\n' in text and
+// whitespace becomes spaces in attribute values, and text of whitespace only is dropped
+std::string Unescape(std::string_view raw, bool attribute)
+{
+    std::string out;
+    if (not attribute and std::ranges::all_of(raw, IsSpace))
+        return out;
+
+    out.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        const char c = raw[i];
+        if (c == '&') {
+            const std::size_t length = AppendReference(out, raw.substr(i));
+            if (length > 0) {
+                i += length - 1;
+                continue;
+            }
+            out.push_back(c);
+        } else if (c == '\r') {
+            out.push_back(attribute ? ' ' : '\n');
+            if ((i + 1 < raw.size()) and (raw[i + 1] == '\n'))
+                ++i;
+        } else if (attribute and ((c == '\n') or (c == '\t'))) {
+            out.push_back(' ');
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+using RecordingSchema = schema::Schema<RecordingSession>;
+
+// Id attribute of the recording elements which can be looked up
+std::string_view IdAttribute(std::string_view element)
+{
+    switch (schema::child_matcher<RecordingSession>.Find(element)) {
+        case RecordingSchema::Session:
+            return schema::Schema<CommunicationSession>::key.name;
+        case RecordingSchema::Participant:
+            return schema::Schema<Participant>::key.name;
+        case RecordingSchema::Stream:
+            return schema::Schema<MediaStream>::key.name;
+        default:
+            return {};
+    }
+}
+
+std::size_t NameEnd(std::string_view xml, std::size_t pos)
+{
+    while ((pos < xml.size()) and not IsSpace(xml[pos]) and (xml[pos] != '/') and (xml[pos] != '>')
+           and (xml[pos] != '='))
+        ++pos;
+    return pos;
+}
+
+std::size_t SkipSpace(std::string_view xml, std::size_t pos)
+{
+    while ((pos < xml.size()) and IsSpace(xml[pos]))
+        ++pos;
+    return pos;
+}
+
+template <typename T>
+std::vector<std::string_view> Ids(const std::vector<T>& slices)
+{
+    std::vector<std::string_view> ids;
+    ids.reserve(slices.size());
+    for (const auto& slice : slices) {
+        ids.emplace_back(slice.id);
+    }
+    return ids;
+}
+
+// Lookups find the first element with an id, like a scan of the document would. The keys are views of the ids of the
+// slices, so the index is built once the slices are complete.
+template <typename Elements>
+void IndexIds(Elements& elements)
+{
+    elements.by_id.reserve(elements.slices.size());
+    for (std::size_t i = 0; i < elements.slices.size(); ++i) {
+        elements.by_id.try_emplace(elements.slices[i].id, i);
+    }
+}
+}  // namespace
+
+LazyRecordingSession::LazyRecordingSession() : doc_(std::make_unique<pugi::xml_document>()) {}
+
+LazyRecordingSession::~LazyRecordingSession() = default;
+
+bool LazyRecordingSession::Parse(std::string xml_content)
+{
+    xml_ = std::move(xml_content);
+    data_mode_ = "complete";
+    start_time_.reset();
+    end_time_.reset();
+    sessions_ = {};
+    streams_ = {};
+    participants_ = {};
+    return Scan();
+}
+
+bool LazyRecordingSession::Scan()
+{
+    const std::string_view xml = xml_;
+    std::size_t pos = xml.starts_with("\xEF\xBB\xBF") ? 3 : 0;
+
+    std::vector<std::string_view> open;  // names of the open elements
+    bool root_closed = false;
+    std::size_t child_begin = 0;         // start of the open element of the recording
+    std::size_t content_begin = 0;       // and of its content
+    std::string child_id;
+    bool data_mode_seen = false;
+
+    // Elements of the recording are complete, the ones of interest are recorded
+    auto child_complete = [&](std::string_view name, std::size_t end, std::size_t content_end) {
+        const std::size_t offset = child_begin;
+        const std::size_t length = end - child_begin;
+        const auto child = schema::child_matcher<RecordingSession>.Find(name);
+        switch (child) {
+            case RecordingSchema::Session:
+                sessions_.slices.push_back({offset, length, std::move(child_id)});
+                break;
+            case RecordingSchema::Participant:
+                participants_.slices.push_back({offset, length, std::move(child_id)});
+                break;
+            case RecordingSchema::Stream:
+                streams_.slices.push_back({offset, length, std::move(child_id)});
+                break;
+            case RecordingSchema::DataMode:
+            case RecordingSchema::StartTime:
+            case RecordingSchema::EndTime: {
+                std::string text;
+                const std::string_view content = xml.substr(content_begin, content_end - content_begin);
+                if (content.find('<') == std::string_view::npos) {
+                    text = Unescape(content, false);
+                } else {
+                    // Comments and CDATA sections are left to the full parser
+                    if (not doc_->load_buffer(xml.data() + offset, length, pugi::parse_default, pugi::encoding_utf8))
+                        return false;
+                    text = doc_->document_element().text().get();
+                }
+
+                // The first element of a kind counts, as in RecordingSession::FromXML()
+                if (child == RecordingSchema::DataMode) {
+                    if (not data_mode_seen)
+                        data_mode_ = std::move(text);
+                    data_mode_seen = true;
+                } else if (child == RecordingSchema::StartTime) {
+                    if (not start_time_)
+                        start_time_ = Timestamp::from_rfc3339(text);
+                } else if (not end_time_) {
+                    end_time_ = Timestamp::from_rfc3339(text);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        child_id.clear();
+        return true;
+    };
+
+    while (not root_closed) {
+        const std::size_t lt = xml.find('<', pos);
+        if (lt == std::string_view::npos)
+            return false;
+        const std::string_view tag = xml.substr(lt);
+
+        // Declarations, processing instructions, comments and CDATA sections
+        std::string_view terminator;
+        if (tag.starts_with("<?"))
+            terminator = "?>";
+        else if (tag.starts_with("<!--"))
+            terminator = "-->";
+        else if (tag.starts_with("<![CDATA["))
+            terminator = "]]>";
+        else if (tag.starts_with("<!"))
+            terminator = ">";
+        if (not terminator.empty()) {
+            if (tag.starts_with("<!DOCTYPE") and (tag.find('[') < tag.find('>')))
+                terminator = "]>";
+            const std::size_t end = xml.find(terminator, lt + 2);
+            if (end == std::string_view::npos)
+                return false;
+            pos = end + terminator.size();
+            continue;
+        }
+
+        if (tag.starts_with("</")) {
+            const std::size_t name_end = NameEnd(xml, lt + 2);
+            const std::size_t gt = SkipSpace(xml, name_end);
+            if ((gt >= xml.size()) or (xml[gt] != '>'))
+                return false;
+            const std::string_view name = xml.substr(lt + 2, name_end - lt - 2);
+            if (open.empty() or (open.back() != name))
+                return false;
+            open.pop_back();
+            pos = gt + 1;
+            if ((open.size() == 1) and not child_complete(name, pos, lt))
+                return false;
+            root_closed = open.empty();
+            continue;
+        }
+
+        // Start tag and its attributes
+        const std::size_t name_end = NameEnd(xml, lt + 1);
+        const std::string_view name = xml.substr(lt + 1, name_end - lt - 1);
+        if (name.empty())
+            return false;
+        const std::string_view id_attribute = (open.size() == 1) ? IdAttribute(name) : std::string_view();
+        std::size_t i = name_end;
+        bool self_closing = false;
+        for (;;) {
+            i = SkipSpace(xml, i);
+            if (i >= xml.size())
+                return false;
+            if (xml[i] == '>')
+                break;
+            if (xml.substr(i).starts_with("/>")) {
+                self_closing = true;
+                ++i;
+                break;
+            }
+            const std::size_t attribute_end = NameEnd(xml, i);
+            const std::string_view attribute = xml.substr(i, attribute_end - i);
+            i = SkipSpace(xml, attribute_end);
+            if (attribute.empty() or (i >= xml.size()) or (xml[i] != '='))
+                return false;
+            i = SkipSpace(xml, i + 1);
+            if ((i >= xml.size()) or ((xml[i] != '"') and (xml[i] != '\'')))
+                return false;
+            const std::size_t close = xml.find(xml[i], i + 1);
+            if (close == std::string_view::npos)
+                return false;
+            if (not id_attribute.empty() and (attribute == id_attribute))
+                child_id = Unescape(xml.substr(i + 1, close - i - 1), true);
+            i = close + 1;
+        }
+        pos = i + 1;
+
+        if (open.empty()) {
+            if (name != RecordingSchema::element)
+                return false;
+            root_closed = self_closing;
+            if (not self_closing)
+                open.push_back(name);
+            continue;
+        }
+        if (open.size() == 1) {
+            child_begin = lt;
+            content_begin = pos;
+        }
+        if (not self_closing)
+            open.push_back(name);
+        else if ((open.size() == 1) and not child_complete(name, pos, pos))
+            return false;
+    }
+
+    IndexIds(sessions_);
+    IndexIds(participants_);
+    IndexIds(streams_);
+    return true;
+}
+
+template <typename T>
+const T* LazyRecordingSession::Decode(Elements<T>& elements, std::string_view id)
+{
+    auto found = elements.by_id.find(id);
+    if (found == elements.by_id.end())
+        return nullptr;
+    auto slice = elements.slices.begin() + found->second;
+    if (slice->decoded)
+        return slice->decoded;
+
+    const std::string_view xml = std::string_view(xml_).substr(slice->offset, slice->length);
+    if (not doc_->load_buffer(xml.data(), xml.size(), pugi::parse_default, pugi::encoding_utf8))
+        return nullptr;
+    if (not siprec_metadata::FromXML(elements.decoded, doc_->document_element(), xml))
+        return nullptr;
+    slice->decoded = &elements.decoded.back();
+    return &elements.decoded.back();
+}
+
+std::vector<std::string_view> LazyRecordingSession::CommSessionIds() const { return Ids(sessions_.slices); }
+
+std::vector<std::string_view> LazyRecordingSession::ParticipantIds() const { return Ids(participants_.slices); }
+
+std::vector<std::string_view> LazyRecordingSession::StreamIds() const { return Ids(streams_.slices); }
+
+const CommunicationSession* LazyRecordingSession::FindCommSession(std::string_view session_id)
+{
+    return Decode(sessions_, session_id);
+}
+
+const Participant* LazyRecordingSession::FindParticipant(std::string_view participant_id)
+{
+    return Decode(participants_, participant_id);
+}
+
+const MediaStream* LazyRecordingSession::FindStream(std::string_view stream_id) { return Decode(streams_, stream_id); }
+
+bool LazyRecordingSession::ToRecordingSession(RecordingSession& session) const { return session.FromXML(xml_); }
@@ -0,0 +1,96 @@
+// lazy_recording_session.h
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+/**
+ * @brief Recording metadata which is decoded only as far as it is used
+ *
+ * Parse() keeps the document and scans it once for the byte ranges of the elements of the recording. The data mode,
+ * the start and end times and the ids of sessions, participants and streams are taken from that scan. A session,
+ * participant or stream is parsed the first time it is looked up, and the whole session only on request.
+ *
+ * The scan checks the nesting of the document but not the content of the elements, so a malformed element is only
+ * noticed when it is decoded.
+ *
+ */
+class LazyRecordingSession
+{
+   private:
+    template <typename T>
+    struct Slice
+    {
+        std::size_t offset;
+        std::size_t length;
+        std::string id;
+        const T *decoded = nullptr;  // element in Elements::decoded once it is parsed
+    };
+
+    template <typename T>
+    struct Elements
+    {
+        std::vector<Slice<T>> slices;
+        std::unordered_map<std::string_view, std::size_t> by_id;  // first slice of an id
+        std::list<T> decoded;
+    };
+
+    std::string xml_;
+    std::string data_mode_ = "complete";
+    std::optional<Timestamp> start_time_;
+    std::optional<Timestamp> end_time_;
+    Elements<CommunicationSession> sessions_;
+    Elements<MediaStream> streams_;
+    Elements<Participant> participants_;
+    std::unique_ptr<pugi::xml_document> doc_;
+
+    bool Scan();
+
+    template <typename T>
+    const T *Decode(Elements<T> &elements, std::string_view id);
+
+   public:
+    LazyRecordingSession();
+    ~LazyRecordingSession();
+
+    LazyRecordingSession(const LazyRecordingSession &) = delete;
+    LazyRecordingSession &operator=(const LazyRecordingSession &) = delete;
+
+    /**
+     * @brief Keep the document and scan it, false if it is not a well-nested recording document
+     */
+    bool Parse(std::string xml_content);
+
+    const std::string &DataMode() const { return data_mode_; }
+    const std::optional<Timestamp> &StartTime() const { return start_time_; }
+    const std::optional<Timestamp> &EndTime() const { return end_time_; }
+
+    std::vector<std::string_view> CommSessionIds() const;
+    std::vector<std::string_view> ParticipantIds() const;
+    std::vector<std::string_view> StreamIds() const;
+
+    /**
+     * @brief Element with the id, parsed on first access; nullptr if there is none or it is malformed
+     */
+    const CommunicationSession *FindCommSession(std::string_view session_id);
+    const Participant *FindParticipant(std::string_view participant_id);
+    const MediaStream *FindStream(std::string_view stream_id);
+
+    /**
+     * @brief Parse the whole document into a session, like RecordingSession::FromXML()
+     */
+    bool ToRecordingSession(RecordingSession &session) const;
+};
+
+}  // namespace siprec_metadata
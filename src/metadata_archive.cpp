@@ -0,0 +1,654 @@
+#include "metadata_archive.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <tuple>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace siprec_metadata;
+
+/*
+ * Archive file layout, version 1. Integers are little-endian.
+ *
+ *   header   "SRMA", u32 version
+ *   records  u32 length, binary encoded RecordingSession (see RecordingSession::ToBinary())
+ *   footer   u64 record count, u64 open record count, i64 longest closed record duration (ns),
+ *            u64 session key count, u64 AoR key count, u64 key blob size
+ *            records        u64 offset, u32 length, u32 reserved, i64 start (ns), i64 end (ns)
+ *            by start       u32 record, for records with known start and end, sorted by start
+ *            open records   u32 record, for records with unknown start or end
+ *            session keys   u64 hash, u64 key offset, u32 key length, u32 record, sorted by hash and record
+ *            AoR keys       same as session keys
+ *            key blob       key strings referenced by the key tables
+ *   trailer  u64 footer offset, "SRMAIDX1"
+ */
+
+static_assert(std::endian::native == std::endian::little, "archive integers are stored in host byte order");
+
+namespace
+{
+constexpr std::string_view archive_magic = "SRMA";
+constexpr std::uint32_t archive_version = 1;
+constexpr std::string_view index_magic = "SRMAIDX1";
+constexpr std::size_t header_size = 8;
+constexpr std::size_t trailer_size = 16;
+constexpr std::size_t footer_header_size = 48;
+constexpr std::size_t record_entry_size = 32;
+constexpr std::size_t key_entry_size = 24;
+constexpr std::int64_t unknown_start = std::numeric_limits<std::int64_t>::min();
+constexpr std::int64_t unknown_end = std::numeric_limits<std::int64_t>::max();
+
+template <typename T>
+T Load(const char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void Store(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// fseek() takes a long, which has 32 bits on Windows, so archives past 2 GiB need the 64-bit variants
+bool Seek(std::FILE* file, std::uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Read size bytes at offset into out
+bool ReadAt(std::FILE* file, std::uint64_t offset, std::size_t size, std::string& out)
+{
+    out.resize(size);
+    return Seek(file, offset) and (std::fread(out.data(), 1, size, file) == size);
+}
+
+std::uint64_t Hash(std::string_view key)
+{
+    // FNV-1a
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : key) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::int64_t Nanoseconds(const Timestamp& time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_point().time_since_epoch()).count();
+}
+
+// Recording start is the start time or the earliest association; the end is the end time or, once every
+// communication session has been disassociated from the recording, the latest disassociation
+std::pair<std::int64_t, std::int64_t> TimeRangeOf(const RecordingSession& session)
+{
+    std::int64_t start = unknown_start;
+    if (session.StartTime()) {
+        start = Nanoseconds(session.StartTime().value());
+    } else {
+        std::optional<std::int64_t> earliest;
+        auto consider = [&](const Timestamp& time) {
+            earliest = std::min(earliest.value_or(unknown_end), Nanoseconds(time));
+        };
+        for (const auto& comm_session : session.CommSessions()) {
+            if (comm_session.StartTime())
+                consider(comm_session.StartTime().value());
+        }
+        for (const auto& assoc : session.CS_RS_Associations()) {
+            consider(assoc.AssociateTime());
+        }
+        if (earliest)
+            start = earliest.value();
+    }
+
+    std::int64_t end = unknown_end;
+    if (session.EndTime()) {
+        end = Nanoseconds(session.EndTime().value());
+    } else if (not session.CS_RS_Associations().empty()) {
+        std::int64_t latest = unknown_start;
+        bool closed = true;
+        for (const auto& assoc : session.CS_RS_Associations()) {
+            if (not assoc.DisassociateTime()) {
+                closed = false;
+                break;
+            }
+            latest = std::max(latest, Nanoseconds(assoc.DisassociateTime().value()));
+        }
+        if (closed)
+            end = latest;
+    }
+
+    return {start, end};
+}
+
+template <typename Keys>
+void AddKeys(std::vector<MetadataArchiveWriter::KeyEntry>& entries, Keys keys, std::uint32_t record)
+{
+    std::ranges::sort(keys);
+    const auto duplicates = std::ranges::unique(keys);
+    keys.erase(duplicates.begin(), duplicates.end());
+    for (auto& key : keys) {
+        const auto hash = Hash(key);
+        entries.push_back(MetadataArchiveWriter::KeyEntry{hash, std::string(key), record});
+    }
+}
+
+void IndexRecord(const RecordingSession& session, std::uint64_t offset, std::uint32_t length,
+                 std::vector<MetadataArchiveWriter::RecordEntry>& records,
+                 std::vector<MetadataArchiveWriter::KeyEntry>& session_keys,
+                 std::vector<MetadataArchiveWriter::KeyEntry>& aor_keys)
+{
+    const auto record = static_cast<std::uint32_t>(records.size());
+    const auto [start, end] = TimeRangeOf(session);
+    records.push_back(MetadataArchiveWriter::RecordEntry{offset, length, start, end});
+
+    std::vector<std::string_view> keys;
+    for (const auto& comm_session : session.CommSessions()) {
+        keys.push_back(comm_session.SessionId());
+        for (const auto& sip_session_id : comm_session.SipSessionIds()) {
+            keys.push_back(sip_session_id);
+        }
+    }
+    AddKeys(session_keys, std::move(keys), record);
+
+    std::vector<std::string_view> aors;
+    for (const auto& participant : session.Participants()) {
+        for (const auto& [name, aor] : participant.NameIds()) {
+            aors.push_back(aor);
+        }
+    }
+    AddKeys(aor_keys, std::move(aors), record);
+}
+
+struct Footer
+{
+    std::uint64_t record_count;
+    std::uint64_t open_count;
+    std::int64_t max_duration_ns;
+    std::uint64_t session_key_count;
+    std::uint64_t aor_key_count;
+    std::uint64_t key_blob_size;
+    const char* records;
+    const char* by_start;
+    const char* open;
+    const char* session_keys;
+    const char* aor_keys;
+    const char* key_blob;
+};
+
+// Validate the footer found at footer_offset, all tables must fit into footer_size bytes
+bool ParseFooter(const char* footer, std::uint64_t footer_size, std::uint64_t footer_offset, Footer& parsed)
+{
+    if (footer_size < footer_header_size)
+        return false;
+
+    parsed.record_count = Load<std::uint64_t>(footer);
+    parsed.open_count = Load<std::uint64_t>(footer + 8);
+    parsed.max_duration_ns = Load<std::int64_t>(footer + 16);
+    parsed.session_key_count = Load<std::uint64_t>(footer + 24);
+    parsed.aor_key_count = Load<std::uint64_t>(footer + 32);
+    parsed.key_blob_size = Load<std::uint64_t>(footer + 40);
+
+    const std::uint64_t limit = footer_size;
+    if ((parsed.record_count > limit) or (parsed.open_count > parsed.record_count)
+        or (parsed.session_key_count > limit) or (parsed.aor_key_count > limit) or (parsed.key_blob_size > limit))
+        return false;
+    const std::uint64_t tables_size = parsed.record_count * record_entry_size + parsed.record_count * 4
+                                      + (parsed.session_key_count + parsed.aor_key_count) * key_entry_size
+                                      + parsed.key_blob_size;
+    if (footer_header_size + tables_size != footer_size)
+        return false;
+
+    parsed.records = footer + footer_header_size;
+    parsed.by_start = parsed.records + parsed.record_count * record_entry_size;
+    parsed.open = parsed.by_start + (parsed.record_count - parsed.open_count) * 4;
+    parsed.session_keys = parsed.open + parsed.open_count * 4;
+    parsed.aor_keys = parsed.session_keys + parsed.session_key_count * key_entry_size;
+    parsed.key_blob = parsed.aor_keys + parsed.aor_key_count * key_entry_size;
+
+    for (std::uint64_t i = 0; i < parsed.record_count; ++i) {
+        const char* entry = parsed.records + i * record_entry_size;
+        const auto offset = Load<std::uint64_t>(entry);
+        const auto length = Load<std::uint32_t>(entry + 8);
+        if ((offset < header_size) or (offset > footer_offset) or (length > footer_offset - offset))
+            return false;
+    }
+    for (const char* keys : {parsed.session_keys, parsed.aor_keys}) {
+        const auto count = (keys == parsed.session_keys) ? parsed.session_key_count : parsed.aor_key_count;
+        for (std::uint64_t i = 0; i < count; ++i) {
+            const char* entry = keys + i * key_entry_size;
+            const auto key_offset = Load<std::uint64_t>(entry + 8);
+            const auto key_length = Load<std::uint32_t>(entry + 16);
+            const auto record = Load<std::uint32_t>(entry + 20);
+            if ((key_offset > parsed.key_blob_size) or (key_length > parsed.key_blob_size - key_offset)
+                or (record >= parsed.record_count))
+                return false;
+        }
+    }
+    for (std::uint64_t i = 0; i < parsed.record_count; ++i) {
+        if (Load<std::uint32_t>(parsed.by_start + i * 4) >= parsed.record_count)
+            return false;
+    }
+
+    return true;
+}
+
+void StoreKeys(std::string& footer, std::string& blob, std::vector<MetadataArchiveWriter::KeyEntry>& keys)
+{
+    std::ranges::sort(keys, [](const auto& lhs, const auto& rhs) {
+        return std::tie(lhs.hash, lhs.record) < std::tie(rhs.hash, rhs.record);
+    });
+    for (const auto& key : keys) {
+        Store<std::uint64_t>(footer, key.hash);
+        Store<std::uint64_t>(footer, blob.size());
+        Store<std::uint32_t>(footer, static_cast<std::uint32_t>(key.key.size()));
+        Store<std::uint32_t>(footer, key.record);
+        blob.append(key.key);
+    }
+}
+
+void LoadKeys(const char* keys, std::uint64_t count, const char* blob,
+              std::vector<MetadataArchiveWriter::KeyEntry>& entries)
+{
+    entries.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const char* entry = keys + i * key_entry_size;
+        entries.push_back(MetadataArchiveWriter::KeyEntry{
+            Load<std::uint64_t>(entry),
+            std::string(blob + Load<std::uint64_t>(entry + 8), Load<std::uint32_t>(entry + 16)),
+            Load<std::uint32_t>(entry + 20)});
+    }
+}
+}  // namespace
+
+MetadataArchiveWriter::~MetadataArchiveWriter() { Close(); }
+
+bool MetadataArchiveWriter::LoadIndex(const std::string& path)
+{
+    std::error_code error;
+    const std::uint64_t size = std::filesystem::file_size(path, error);
+    if (error)
+        return false;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (not file)
+        return false;
+    const bool loaded = LoadIndex(file, size);
+    std::fclose(file);
+    return loaded;
+}
+
+bool MetadataArchiveWriter::LoadIndex(std::FILE* file, std::uint64_t size)
+{
+    std::string buffer;
+    if ((size < header_size) or not ReadAt(file, 0, header_size, buffer) or not buffer.starts_with(archive_magic)
+        or (Load<std::uint32_t>(buffer.data() + 4) != archive_version))
+        return false;
+
+    // Normally the index is taken from the footer, which is the only part read
+    if ((size >= header_size + trailer_size) and ReadAt(file, size - trailer_size, trailer_size, buffer)) {
+        const auto footer_offset = Load<std::uint64_t>(buffer.data());
+        Footer footer;
+        if ((std::string_view(buffer.data() + 8, 8) == index_magic) and (footer_offset >= header_size)
+            and (footer_offset <= size - trailer_size)
+            and ReadAt(file, footer_offset, size - trailer_size - footer_offset, buffer)
+            and ParseFooter(buffer.data(), buffer.size(), footer_offset, footer)) {
+            records_.reserve(footer.record_count);
+            for (std::uint64_t i = 0; i < footer.record_count; ++i) {
+                const char* entry = footer.records + i * record_entry_size;
+                records_.push_back(RecordEntry{Load<std::uint64_t>(entry), Load<std::uint32_t>(entry + 8),
+                                               Load<std::int64_t>(entry + 16), Load<std::int64_t>(entry + 24)});
+            }
+            LoadKeys(footer.session_keys, footer.session_key_count, footer.key_blob, session_keys_);
+            LoadKeys(footer.aor_keys, footer.aor_key_count, footer.key_blob, aor_keys_);
+            end_offset_ = footer_offset;
+            return true;
+        }
+    }
+
+    // The footer was not written, rebuild the index from the records. A record which does not decode is skipped by
+    // its length and kept in the file, the archive ends after the last record which decodes so that only a torn
+    // record or footer is cut off.
+    std::uint64_t offset = header_size;
+    end_offset_ = header_size;
+    while ((size - offset >= 4) and ReadAt(file, offset, 4, buffer)) {
+        const auto length = Load<std::uint32_t>(buffer.data());
+        if ((length > size - offset - 4) or not ReadAt(file, offset + 4, length, buffer))
+            break;
+        RecordingSession session;
+        if (session.FromBinary(buffer)) {
+            IndexRecord(session, offset + 4, length, records_, session_keys_, aor_keys_);
+            end_offset_ = offset + 4 + length;
+        }
+        offset += 4 + length;
+    }
+    return true;
+}
+
+bool MetadataArchiveWriter::Open(const std::string& path)
+{
+    if (file_)
+        return false;
+
+    records_.clear();
+    session_keys_.clear();
+    aor_keys_.clear();
+
+    failed_ = false;
+    path_ = path;
+    std::error_code error;
+    if (std::filesystem::exists(path, error) and (std::filesystem::file_size(path, error) > 0)) {
+        if (not LoadIndex(path))
+            return false;
+        // Records are appended over the old footer
+        std::filesystem::resize_file(path, end_offset_, error);
+        if (error)
+            return false;
+        file_ = std::fopen(path.c_str(), "r+b");
+        if (not file_)
+            return false;
+        if (not Seek(file_, end_offset_)) {
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    file_ = std::fopen(path.c_str(), "w+b");
+    if (not file_)
+        return false;
+    std::string header(archive_magic);
+    Store<std::uint32_t>(header, archive_version);
+    if (std::fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    end_offset_ = header_size;
+    return true;
+}
+
+bool MetadataArchiveWriter::Append(const RecordingSession& session)
+{
+    if (not file_ or failed_)
+        return false;
+
+    const std::string payload = session.ToBinary();
+    if (payload.size() > std::numeric_limits<std::uint32_t>::max())
+        return false;
+    const auto length = static_cast<std::uint32_t>(payload.size());
+
+    std::string frame;
+    frame.reserve(4 + payload.size());
+    Store<std::uint32_t>(frame, length);
+    frame.append(payload);
+    if (std::fwrite(frame.data(), 1, frame.size(), file_) != frame.size()) {
+        // The bytes of the partial record are cut off, so the next record starts where this one should have
+        std::error_code error;
+        std::fflush(file_);
+        std::filesystem::resize_file(path_, end_offset_, error);
+        failed_ = error or not Seek(file_, end_offset_);
+        return false;
+    }
+
+    IndexRecord(session, end_offset_ + 4, length, records_, session_keys_, aor_keys_);
+    end_offset_ += frame.size();
+    return true;
+}
+
+bool MetadataArchiveWriter::WriteFooter()
+{
+    std::vector<std::uint32_t> by_start;
+    std::vector<std::uint32_t> open;
+    std::int64_t max_duration_ns = 0;
+    for (std::uint32_t record = 0; record < records_.size(); ++record) {
+        const auto& entry = records_[record];
+        if ((entry.start_ns == unknown_start) or (entry.end_ns == unknown_end)) {
+            open.push_back(record);
+        } else {
+            by_start.push_back(record);
+            max_duration_ns = std::max(max_duration_ns, entry.end_ns - entry.start_ns);
+        }
+    }
+    std::ranges::stable_sort(by_start, {}, [&](std::uint32_t record) { return records_[record].start_ns; });
+
+    std::string footer;
+    Store<std::uint64_t>(footer, records_.size());
+    Store<std::uint64_t>(footer, open.size());
+    Store<std::int64_t>(footer, max_duration_ns);
+    Store<std::uint64_t>(footer, session_keys_.size());
+    Store<std::uint64_t>(footer, aor_keys_.size());
+    const auto blob_size_pos = footer.size();
+    Store<std::uint64_t>(footer, 0);
+
+    for (const auto& entry : records_) {
+        Store<std::uint64_t>(footer, entry.offset);
+        Store<std::uint32_t>(footer, entry.length);
+        Store<std::uint32_t>(footer, 0);
+        Store<std::int64_t>(footer, entry.start_ns);
+        Store<std::int64_t>(footer, entry.end_ns);
+    }
+    for (const auto record : by_start) {
+        Store<std::uint32_t>(footer, record);
+    }
+    for (const auto record : open) {
+        Store<std::uint32_t>(footer, record);
+    }
+
+    std::string blob;
+    StoreKeys(footer, blob, session_keys_);
+    StoreKeys(footer, blob, aor_keys_);
+    const std::uint64_t blob_size = blob.size();
+    std::memcpy(footer.data() + blob_size_pos, &blob_size, sizeof(blob_size));
+    footer.append(blob);
+
+    Store<std::uint64_t>(footer, end_offset_);
+    footer.append(index_magic);
+
+    return (std::fwrite(footer.data(), 1, footer.size(), file_) == footer.size());
+}
+
+bool MetadataArchiveWriter::Close()
+{
+    if (not file_)
+        return true;
+
+    // Without a known end of the records there is no place to write the footer, reopening recovers the records
+    bool ok = not failed_ and WriteFooter();
+    ok = (std::fflush(file_) == 0) and ok;
+    ok = (std::fclose(file_) == 0) and ok;
+    file_ = nullptr;
+    return ok;
+}
+
+MetadataArchiveReader::~MetadataArchiveReader() { Close(); }
+
+bool MetadataArchiveReader::Open(const std::string& path)
+{
+    Close();
+
+#if defined(_WIN32)
+    std::ifstream stream(path, std::ios::binary);
+    if (not stream)
+        return false;
+    buffer_.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if ((::fstat(fd, &st) != 0) or (st.st_size == 0)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+    data_ = static_cast<const char*>(mapping);
+    size_ = static_cast<size_t>(st.st_size);
+#endif
+
+    const std::string_view contents(data_, size_);
+    if ((size_ < header_size + trailer_size) or not contents.starts_with(archive_magic)
+        or (Load<std::uint32_t>(data_ + 4) != archive_version) or not contents.ends_with(index_magic)) {
+        Close();
+        return false;
+    }
+
+    const auto footer_offset = Load<std::uint64_t>(data_ + size_ - trailer_size);
+    Footer footer;
+    if ((footer_offset < header_size) or (footer_offset > size_ - trailer_size)
+        or not ParseFooter(data_ + footer_offset, size_ - trailer_size - footer_offset, footer_offset, footer)) {
+        Close();
+        return false;
+    }
+
+    record_count_ = footer.record_count;
+    open_count_ = footer.open_count;
+    max_duration_ns_ = footer.max_duration_ns;
+    session_key_count_ = footer.session_key_count;
+    aor_key_count_ = footer.aor_key_count;
+    key_blob_size_ = footer.key_blob_size;
+    records_ = footer.records;
+    by_start_ = footer.by_start;
+    open_ = footer.open;
+    session_keys_ = footer.session_keys;
+    aor_keys_ = footer.aor_keys;
+    key_blob_ = footer.key_blob;
+    return true;
+}
+
+void MetadataArchiveReader::Close()
+{
+#if !defined(_WIN32)
+    if (data_ and buffer_.empty())
+        ::munmap(const_cast<char*>(data_), size_);
+#endif
+    buffer_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    record_count_ = 0;
+    open_count_ = 0;
+    session_key_count_ = 0;
+    aor_key_count_ = 0;
+    key_blob_size_ = 0;
+}
+
+bool MetadataArchiveReader::Read(std::size_t record, RecordingSession& session) const
+{
+    if (record >= record_count_)
+        return false;
+    const char* entry = records_ + record * record_entry_size;
+    return session.FromBinary(std::string_view(data_ + Load<std::uint64_t>(entry), Load<std::uint32_t>(entry + 8)));
+}
+
+std::vector<std::size_t> MetadataArchiveReader::FindKey(const char* keys, std::uint64_t key_count,
+                                                        std::string_view key) const
+{
+    const auto hash = Hash(key);
+
+    std::uint64_t low = 0;
+    std::uint64_t high = key_count;
+    while (low < high) {
+        const auto middle = low + (high - low) / 2;
+        if (Load<std::uint64_t>(keys + middle * key_entry_size) < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    std::vector<std::size_t> records;
+    for (auto i = low; (i < key_count) and (Load<std::uint64_t>(keys + i * key_entry_size) == hash); ++i) {
+        const char* entry = keys + i * key_entry_size;
+        const std::string_view stored(key_blob_ + Load<std::uint64_t>(entry + 8), Load<std::uint32_t>(entry + 16));
+        if (stored == key)
+            records.push_back(Load<std::uint32_t>(entry + 20));
+    }
+    return records;
+}
+
+bool MetadataArchiveReader::Overlaps(std::size_t record, std::int64_t from_ns, std::int64_t to_ns) const
+{
+    const char* entry = records_ + record * record_entry_size;
+    return (Load<std::int64_t>(entry + 16) <= to_ns) and (Load<std::int64_t>(entry + 24) >= from_ns);
+}
+
+std::vector<std::size_t> MetadataArchiveReader::FindBySessionId(std::string_view session_id) const
+{
+    return FindKey(session_keys_, session_key_count_, session_id);
+}
+
+std::vector<std::size_t> MetadataArchiveReader::FindByAor(std::string_view aor) const
+{
+    return FindKey(aor_keys_, aor_key_count_, aor);
+}
+
+std::vector<std::size_t> MetadataArchiveReader::FindByAor(std::string_view aor, const Timestamp& from,
+                                                          const Timestamp& to) const
+{
+    auto records = FindByAor(aor);
+    const auto from_ns = Nanoseconds(from);
+    const auto to_ns = Nanoseconds(to);
+    std::erase_if(records, [&](std::size_t record) { return not Overlaps(record, from_ns, to_ns); });
+    return records;
+}
+
+std::vector<std::size_t> MetadataArchiveReader::FindByTime(const Timestamp& from, const Timestamp& to) const
+{
+    const auto from_ns = Nanoseconds(from);
+    const auto to_ns = Nanoseconds(to);
+    std::vector<std::size_t> records;
+
+    // A closed record overlapping the range starts no earlier than the longest record before its beginning
+    const auto earliest_start =
+        (from_ns < unknown_start + max_duration_ns_) ? unknown_start : from_ns - max_duration_ns_;
+    const auto closed_count = record_count_ - open_count_;
+    auto start_of = [&](std::uint64_t i) {
+        return Load<std::int64_t>(records_ + Load<std::uint32_t>(by_start_ + i * 4) * record_entry_size + 16);
+    };
+    std::uint64_t low = 0;
+    std::uint64_t high = closed_count;
+    while (low < high) {
+        const auto middle = low + (high - low) / 2;
+        if (start_of(middle) < earliest_start)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for (auto i = low; (i < closed_count) and (start_of(i) <= to_ns); ++i) {
+        const auto record = Load<std::uint32_t>(by_start_ + i * 4);
+        if (Overlaps(record, from_ns, to_ns))
+            records.push_back(record);
+    }
+
+    for (std::uint64_t i = 0; i < open_count_; ++i) {
+        const auto record = Load<std::uint32_t>(open_ + i * 4);
+        if (Overlaps(record, from_ns, to_ns))
+            records.push_back(record);
+    }
+
+    std::ranges::sort(records);
+    return records;
+}
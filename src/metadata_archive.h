@@ -0,0 +1,159 @@
+// metadata_archive.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+/**
+ * @brief Appends recording session revisions to an archive file
+ *
+ * An archive is a sequence of binary encoded recording sessions followed by an index footer. The footer is rewritten
+ * on Close(); reopening an archive drops the old footer and continues after the last record.
+ *
+ * A failed Append() cuts the partial record off the file. If that fails as well, further appends are refused and
+ * Close() writes no footer, so the next Open() recovers the records by scanning them.
+ *
+ */
+class MetadataArchiveWriter
+{
+   public:
+    struct RecordEntry
+    {
+        std::uint64_t offset;
+        std::uint32_t length;
+        std::int64_t start_ns;
+        std::int64_t end_ns;  // INT64_MAX while the recording has no known end
+    };
+
+    struct KeyEntry
+    {
+        std::uint64_t hash;
+        std::string key;
+        std::uint32_t record;
+    };
+
+   private:
+    std::FILE *file_ = nullptr;
+    std::string path_;
+    std::uint64_t end_offset_ = 0;  // end of the last complete record
+    bool failed_ = false;           // the file position is unknown after a failed write
+    std::vector<RecordEntry> records_;
+    std::vector<KeyEntry> session_keys_;
+    std::vector<KeyEntry> aor_keys_;
+
+    bool LoadIndex(const std::string &path);
+    bool LoadIndex(std::FILE *file, std::uint64_t size);
+    bool WriteFooter();
+
+   public:
+    MetadataArchiveWriter() = default;
+    ~MetadataArchiveWriter();
+
+    MetadataArchiveWriter(const MetadataArchiveWriter &) = delete;
+    MetadataArchiveWriter &operator=(const MetadataArchiveWriter &) = delete;
+
+    /**
+     * @brief Create an archive or reopen an existing one for appending
+     *
+     * Reopening truncates the old footer, so no MetadataArchiveReader may have the file open: its memory mapping
+     * would cover bytes which are gone and reading them raises SIGBUS.
+     */
+    bool Open(const std::string &path);
+
+    /**
+     * @brief Append a revision, indexed by its session and SIP session IDs, participant AoRs and time range
+     */
+    bool Append(const RecordingSession &session);
+
+    /**
+     * @brief Write the index footer and close the file
+     */
+    bool Close();
+
+    std::size_t Size() const { return records_.size(); }
+};
+
+/**
+ * @brief Read-only memory-mapped view of an archive file
+ *
+ * Lookups binary search the footer index in place and never touch records that do not match; only Read() decodes a
+ * record.
+ *
+ * The file must not be reopened by a MetadataArchiveWriter while a reader has it open, see
+ * MetadataArchiveWriter::Open().
+ *
+ */
+class MetadataArchiveReader
+{
+   private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    std::string buffer_;  // file contents where memory mapping is not available
+
+    const char *records_ = nullptr;
+    const char *by_start_ = nullptr;
+    const char *open_ = nullptr;
+    const char *session_keys_ = nullptr;
+    const char *aor_keys_ = nullptr;
+    const char *key_blob_ = nullptr;
+    std::uint64_t record_count_ = 0;
+    std::uint64_t open_count_ = 0;
+    std::uint64_t session_key_count_ = 0;
+    std::uint64_t aor_key_count_ = 0;
+    std::uint64_t key_blob_size_ = 0;
+    std::int64_t max_duration_ns_ = 0;
+
+    std::vector<std::size_t> FindKey(const char *keys, std::uint64_t key_count, std::string_view key) const;
+    bool Overlaps(std::size_t record, std::int64_t from_ns, std::int64_t to_ns) const;
+
+   public:
+    MetadataArchiveReader() = default;
+    ~MetadataArchiveReader();
+
+    MetadataArchiveReader(const MetadataArchiveReader &) = delete;
+    MetadataArchiveReader &operator=(const MetadataArchiveReader &) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+
+    /**
+     * @brief Number of records
+     */
+    std::size_t Size() const { return record_count_; }
+
+    /**
+     * @brief Decode a record
+     */
+    bool Read(std::size_t record, RecordingSession &session) const;
+
+    /**
+     * @brief Records containing a communication session with this session ID or SIP session ID
+     */
+    std::vector<std::size_t> FindBySessionId(std::string_view session_id) const;
+
+    /**
+     * @brief Records with a participant having this AoR
+     */
+    std::vector<std::size_t> FindByAor(std::string_view aor) const;
+
+    /**
+     * @brief Records with a participant having this AoR and overlapping the time range
+     */
+    std::vector<std::size_t> FindByAor(std::string_view aor, const Timestamp &from, const Timestamp &to) const;
+
+    /**
+     * @brief Records overlapping the time range
+     */
+    std::vector<std::size_t> FindByTime(const Timestamp &from, const Timestamp &to) const;
+};
+
+}  // namespace siprec_metadata
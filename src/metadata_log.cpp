@@ -0,0 +1,319 @@
+#include "metadata_log.h"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace siprec_metadata;
+
+/*
+ * Log file layout, version 1. Integers are little-endian.
+ *
+ *   header   "SRML", u32 version
+ *   records  u32 body length, u32 CRC-32 of the body, body
+ *            body: u8 type, varint key length, key, payload
+ *            update payload is a binary encoded RecordingSession delta, remove payload is empty
+ */
+
+namespace
+{
+constexpr std::string_view log_magic = "SRML";
+constexpr std::uint32_t log_version = 1;
+constexpr std::size_t header_size = 8;
+constexpr std::size_t record_header_size = 8;
+
+enum RecordType : std::uint8_t
+{
+    RecordUpdate = 1,
+    RecordRemove = 2,
+};
+
+constexpr std::array<std::uint32_t, 256> crc32_table = [] {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : (crc >> 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+std::uint32_t Crc32(std::string_view data)
+{
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = crc32_table[(crc ^ static_cast<std::uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void StoreU32(std::string& out, std::uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+std::uint32_t LoadU32(const char* data)
+{
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+std::string Header()
+{
+    std::string header(log_magic);
+    StoreU32(header, log_version);
+    return header;
+}
+
+bool ReadFile(const std::string& path, std::string& contents)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (not file)
+        return false;
+    char buffer[65536];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, read);
+    }
+    const bool ok = (std::ferror(file) == 0);
+    std::fclose(file);
+    return ok;
+}
+
+// Call visitor for every intact record and return the offset after the last one
+template <typename Visitor>
+size_t ScanRecords(std::string_view contents, Visitor visitor)
+{
+    size_t offset = header_size;
+    while (contents.size() - offset >= record_header_size) {
+        const auto length = LoadU32(contents.data() + offset);
+        const auto crc = LoadU32(contents.data() + offset + 4);
+        if (length > contents.size() - offset - record_header_size)
+            break;
+        const auto body = contents.substr(offset + record_header_size, length);
+        if ((body.empty()) or (Crc32(body) != crc))
+            break;
+
+        // Type and key
+        const auto type = static_cast<std::uint8_t>(body[0]);
+        size_t pos = 1;
+        uint64_t key_length = 0;
+        bool key_ok = false;
+        for (int shift = 0; (shift < 64) and (pos < body.size()); shift += 7) {
+            const auto byte = static_cast<std::uint8_t>(body[pos++]);
+            key_length |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                key_ok = true;
+                break;
+            }
+        }
+        if (not key_ok or (key_length > body.size() - pos))
+            break;
+        if (not visitor(type, body.substr(pos, key_length), body.substr(pos + key_length)))
+            break;
+
+        offset += record_header_size + length;
+    }
+    return offset;
+}
+}  // namespace
+
+MetadataLog::~MetadataLog() { Close(); }
+
+bool MetadataLog::Open(const std::string& path, const Options& options)
+{
+    if (file_)
+        return false;
+
+    std::error_code error;
+    if (std::filesystem::exists(path, error) and (std::filesystem::file_size(path, error) > 0)) {
+        std::string contents;
+        if (not ReadFile(path, contents) or not std::string_view(contents).starts_with(Header()))
+            return false;
+        const auto end = ScanRecords(contents, [](auto, auto, auto) { return true; });
+        if (end != contents.size()) {
+            std::filesystem::resize_file(path, end, error);
+            if (error)
+                return false;
+        }
+        file_ = std::fopen(path.c_str(), "ab");
+        if (not file_)
+            return false;
+    } else {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (not file_)
+            return false;
+        const auto header = Header();
+        if ((std::fwrite(header.data(), 1, header.size(), file_) != header.size()) or (std::fflush(file_) != 0)) {
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+    }
+
+    options_ = options;
+    pending_.clear();
+    next_sequence_ = 0;
+    pending_sequence_ = 0;
+    durable_sequence_ = 0;
+    failed_ = false;
+    stopping_ = false;
+    writer_ = std::thread(&MetadataLog::WriterLoop, this);
+    return true;
+}
+
+bool MetadataLog::Close()
+{
+    if (not file_)
+        return true;
+
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    pending_cv_.notify_all();
+    writer_.join();
+
+    // Append() reads the file under the lock
+    std::lock_guard lock(mutex_);
+    const bool ok = (std::fclose(file_) == 0) and not failed_;
+    file_ = nullptr;
+    return ok;
+}
+
+std::uint64_t MetadataLog::Append(std::uint8_t type, std::string_view key, std::string_view payload)
+{
+    std::string body;
+    body.reserve(1 + 10 + key.size() + payload.size());
+    body.push_back(static_cast<char>(type));
+    for (uint64_t length = key.size(); true; length >>= 7) {
+        if (length < 0x80) {
+            body.push_back(static_cast<char>(length));
+            break;
+        }
+        body.push_back(static_cast<char>((length & 0x7F) | 0x80));
+    }
+    body.append(key);
+    body.append(payload);
+    const auto crc = Crc32(body);
+
+    std::uint64_t sequence;
+    {
+        std::lock_guard lock(mutex_);
+        if (not file_ or failed_ or stopping_)
+            return 0;
+        StoreU32(pending_, static_cast<std::uint32_t>(body.size()));
+        StoreU32(pending_, crc);
+        pending_.append(body);
+        sequence = ++next_sequence_;
+        pending_sequence_ = sequence;
+    }
+    pending_cv_.notify_one();
+    return sequence;
+}
+
+void MetadataLog::WriterLoop()
+{
+    std::unique_lock lock(mutex_);
+    while (true) {
+        pending_cv_.wait(lock, [this] { return stopping_ or not pending_.empty(); });
+        if (pending_.empty())
+            break;
+
+        // Group commit: let concurrent updates join the batch
+        if (not stopping_ and (options_.group_commit_delay.count() > 0)
+            and (pending_.size() < options_.max_batch_bytes)) {
+            pending_cv_.wait_for(lock, options_.group_commit_delay,
+                                 [this] { return stopping_ or (pending_.size() >= options_.max_batch_bytes); });
+        }
+
+        std::string batch;
+        batch.swap(pending_);
+        const auto batch_sequence = pending_sequence_;
+        lock.unlock();
+
+        bool ok = (std::fwrite(batch.data(), 1, batch.size(), file_) == batch.size()) and (std::fflush(file_) == 0);
+        if (ok and options_.sync) {
+#if defined(_WIN32)
+            ok = (_commit(_fileno(file_)) == 0);
+#else
+            ok = (::fdatasync(::fileno(file_)) == 0);
+#endif
+        }
+
+        lock.lock();
+        if (ok) {
+            durable_sequence_ = batch_sequence;
+        } else {
+            failed_ = true;
+        }
+        durable_cv_.notify_all();
+        if (failed_)
+            break;
+    }
+    // Nobody waits for records which will never be written
+    stopping_ = true;
+    durable_cv_.notify_all();
+}
+
+std::uint64_t MetadataLog::LogUpdate(std::string_view key, const RecordingSession& delta)
+{
+    return Append(RecordUpdate, key, delta.ToBinary());
+}
+
+std::uint64_t MetadataLog::LogXML(std::string_view key, const std::string& xml_content)
+{
+    RecordingSession delta;
+    if (not delta.FromXML(xml_content))
+        return 0;
+    return LogUpdate(key, delta);
+}
+
+std::uint64_t MetadataLog::LogRemove(std::string_view key) { return Append(RecordRemove, key, {}); }
+
+bool MetadataLog::WaitDurable(std::uint64_t sequence)
+{
+    std::unique_lock lock(mutex_);
+    // The writer drains every queued record before it stops, unless a write fails
+    durable_cv_.wait(lock,
+                     [&] { return (durable_sequence_ >= sequence) or failed_ or (sequence > next_sequence_); });
+    return (durable_sequence_ >= sequence);
+}
+
+bool MetadataLog::Replay(const std::string& path, std::unordered_map<std::string, RecordingSession>& sessions)
+{
+    std::string contents;
+    if (not ReadFile(path, contents) or not std::string_view(contents).starts_with(Header()))
+        return false;
+
+    ScanRecords(contents, [&](std::uint8_t type, std::string_view key, std::string_view payload) {
+        switch (type) {
+            case RecordUpdate: {
+                RecordingSession delta;
+                if (not delta.FromBinary(payload))
+                    return false;
+                sessions.try_emplace(std::string(key)).first->second.Merge(delta);
+                return true;
+            }
+            case RecordRemove:
+                sessions.erase(std::string(key));
+                return true;
+            default:
+                return false;
+        }
+    });
+    return true;
+}
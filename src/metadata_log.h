@@ -0,0 +1,105 @@
+// metadata_log.h
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+/**
+ * @brief Write-ahead log of metadata updates
+ *
+ * Every update is a delta for the recording session registered under a key (for example the Call-ID): new elements
+ * added by Add* calls, changed associations or a parsed partial metadata document. Deltas are applied with
+ * RecordingSession::Merge() on replay. Records are written by a background thread in batches, one fsync per batch,
+ * so many concurrent updates share the cost of a single disk flush.
+ *
+ */
+class MetadataLog
+{
+   public:
+    struct Options
+    {
+        // How long the writer waits for more updates before flushing a batch
+        std::chrono::microseconds group_commit_delay{500};
+        // Batch size which is flushed without waiting
+        std::size_t max_batch_bytes = 1 << 20;
+        // Flush batches to the disk, not only to the operating system
+        bool sync = true;
+    };
+
+   private:
+    std::FILE *file_ = nullptr;
+    Options options_;
+
+    std::mutex mutex_;
+    std::condition_variable pending_cv_;
+    std::condition_variable durable_cv_;
+    std::string pending_;
+    std::uint64_t next_sequence_ = 0;
+    std::uint64_t pending_sequence_ = 0;
+    std::uint64_t durable_sequence_ = 0;
+    bool failed_ = false;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    std::uint64_t Append(std::uint8_t type, std::string_view key, std::string_view payload);
+    void WriterLoop();
+
+   public:
+    MetadataLog() = default;
+    ~MetadataLog();
+
+    MetadataLog(const MetadataLog &) = delete;
+    MetadataLog &operator=(const MetadataLog &) = delete;
+
+    /**
+     * @brief Open a log for appending, a torn record left by a crash is cut off
+     */
+    bool Open(const std::string &path, const Options &options);
+    bool Open(const std::string &path) { return Open(path, Options{}); }
+
+    /**
+     * @brief Flush everything logged so far and close the log
+     */
+    bool Close();
+
+    /**
+     * @brief Queue a delta for the recording session under the key
+     *
+     * Returns the sequence number of the record, or 0 if the log is not open or has failed.
+     */
+    std::uint64_t LogUpdate(std::string_view key, const RecordingSession &delta);
+
+    /**
+     * @brief Parse a metadata document and queue it as a delta, 0 if it cannot be parsed
+     */
+    std::uint64_t LogXML(std::string_view key, const std::string &xml_content);
+
+    /**
+     * @brief Queue removal of the recording session under the key
+     */
+    std::uint64_t LogRemove(std::string_view key);
+
+    /**
+     * @brief Wait until the record with the sequence number and all records before it are on the disk
+     */
+    bool WaitDurable(std::uint64_t sequence);
+
+    /**
+     * @brief Rebuild recording sessions from a log, stopping at the first torn or corrupted record
+     */
+    static bool Replay(const std::string &path, std::unordered_map<std::string, RecordingSession> &sessions);
+};
+
+}  // namespace siprec_metadata
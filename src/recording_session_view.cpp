@@ -0,0 +1,272 @@
+#include "recording_session_view.h"
+
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include "pugixml.hpp"
+#include "siprec_metadata_schema.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+/*
+ * Members of the view of every element type, in the order of its schema table, so that the names and the one pass
+ * over the children come from the schema like in RecordingSession::FromXML()
+ */
+template <typename Entity>
+struct ViewFields;
+
+template <>
+struct ViewFields<CommunicationSessionGroup>
+{
+    using View = CommunicationSessionGroupView;
+
+    static constexpr auto key = &View::group_id;
+    static constexpr std::tuple<> attributes{};
+    static constexpr std::tuple children{&View::associate_time, &View::disassociate_time};
+};
+
+template <>
+struct ViewFields<CommunicationSession>
+{
+    using View = CommunicationSessionView;
+
+    static constexpr auto key = &View::session_id;
+    static constexpr std::tuple<> attributes{};
+    static constexpr std::tuple children{&View::reason, &View::start_time, &View::stop_time, &View::sip_session_ids,
+                                         &View::group_ref};
+};
+
+template <>
+struct ViewFields<Participant>
+{
+    using View = ParticipantView;
+
+    static constexpr auto key = &View::participant_id;
+    static constexpr std::tuple<> attributes{};
+    static constexpr std::tuple children{&View::name_ids};
+};
+
+template <>
+struct ViewFields<MediaStream>
+{
+    using View = MediaStreamView;
+
+    static constexpr auto key = &View::stream_id;
+    static constexpr std::tuple attributes{&View::session_id};
+    static constexpr std::tuple children{&View::label, &View::content_type};
+};
+
+template <>
+struct ViewFields<CSRSAssociation>
+{
+    using View = CSRSAssociationView;
+
+    static constexpr std::tuple attributes{&View::session_id};
+    static constexpr std::tuple children{&View::associate_time, &View::disassociate_time};
+};
+
+template <>
+struct ViewFields<ParticipantSessionAssociation>
+{
+    using View = ParticipantSessionAssociationView;
+
+    static constexpr std::tuple attributes{&View::participant_id, &View::session_id};
+    static constexpr std::tuple children{&View::associate_time, &View::disassociate_time, &View::params};
+};
+
+// Id attribute, false if the element has none
+bool Id(const pugi::xml_node& node, std::string_view name, std::string_view& id)
+{
+    auto attribute = node.attribute(name);
+    if (not attribute)
+        return false;
+    id = attribute.value();
+    return true;
+}
+
+// Other attributes, false if a required one is missing
+template <typename Entity>
+bool ReadAttribute(const pugi::xml_node& node, const schema::Attribute<Entity>& field, std::string_view& value)
+{
+    auto attribute = node.attribute(field.name);
+    if (not attribute)
+        return not field.required;
+    value = attribute.value();
+    return true;
+}
+
+// Values of the parsed document point into its buffer. A single value is read from the first element, lists from
+// every element.
+template <typename Field>
+void ReadChild(const pugi::xml_node& child, const Field&, std::string_view& value, bool first)
+{
+    if (first)
+        value = child.text().get();
+}
+
+template <typename Field>
+void ReadChild(const pugi::xml_node& child, const Field&, std::vector<std::string_view>& values, bool)
+{
+    values.emplace_back(child.text().get());
+}
+
+void ReadChild(const pugi::xml_node& child, const schema::NameIds& field,
+               std::vector<std::pair<std::string_view, std::string_view>>& name_ids, bool)
+{
+    if (auto name = child.child(field.display_name))
+        name_ids.emplace_back(name.text().get(), child.attribute(field.aor).value());
+}
+
+template <typename Entity>
+bool ReadView(const pugi::xml_node& node, typename ViewFields<Entity>::View& view)
+{
+    using Schema = schema::Schema<Entity>;
+    using Fields = ViewFields<Entity>;
+
+    if constexpr (requires { Schema::key; }) {
+        if (not Id(node, Schema::key.name, view.*Fields::key))
+            return false;
+    }
+    constexpr std::size_t attribute_count = std::tuple_size_v<std::remove_const_t<decltype(Schema::attributes)>>;
+    const bool attributes_read = [&]<std::size_t... I>(std::index_sequence<I...>) {
+        return (ReadAttribute(node, std::get<I>(Schema::attributes), view.*std::get<I>(Fields::attributes)) and ...);
+    }(std::make_index_sequence<attribute_count>());
+    if (not attributes_read)
+        return false;
+
+    // One pass over the children, each is matched against the schema by its name
+    constexpr std::size_t child_count = schema::child_count<Entity>;
+    static_assert(child_count <= 32);
+    std::uint32_t read = 0;
+    for (auto child : node.children()) {
+        if (child.type() != pugi::node_element)
+            continue;
+        const std::size_t index = schema::child_matcher<Entity>.Find(child.name());
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ([&] {
+                if (index != I)
+                    return;
+                const bool first = not (read & (1u << I));
+                read |= 1u << I;
+                ReadChild(child, std::get<I>(Schema::children), view.*std::get<I>(Fields::children), first);
+            }(), ...);
+        }(std::make_index_sequence<child_count>());
+    }
+    return true;
+}
+
+// Stream associations have a child per direction
+bool ReadView(const pugi::xml_node& node, ParticipantStreamAssociationView& view)
+{
+    using Schema = schema::Schema<ParticipantStreamAssociation>;
+
+    if (not Id(node, Schema::participant, view.participant_id))
+        return false;
+    for (auto child : node.children()) {
+        if (child.type() != pugi::node_element)
+            continue;
+        switch (schema::child_matcher<ParticipantStreamAssociation>.Find(child.name())) {
+            case Schema::Send:
+                view.send.emplace_back(child.text().get());
+                break;
+            case Schema::Recv:
+                view.recv.emplace_back(child.text().get());
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+RecordingSessionView::RecordingSessionView() : doc_(std::make_unique<pugi::xml_document>()) {}
+
+RecordingSessionView::~RecordingSessionView() = default;
+
+void RecordingSessionView::Clear()
+{
+    data_mode_ = "complete";
+    start_time_ = {};
+    end_time_ = {};
+    groups_.clear();
+    comm_sessions_.clear();
+    participants_.clear();
+    media_streams_.clear();
+    csrs_associations_.clear();
+    participant_session_associations_.clear();
+    participant_stream_associations_.clear();
+}
+
+bool RecordingSessionView::Parse(std::string xml_content)
+{
+    Clear();
+    doc_->reset();
+    xml_ = std::move(xml_content);
+    if (not doc_->load_buffer_inplace(xml_.data(), xml_.size(), pugi::parse_default, pugi::encoding_utf8))
+        return false;
+
+    using Schema = schema::Schema<RecordingSession>;
+    auto recording_node = doc_->child(Schema::element);
+    if (not recording_node)
+        return false;
+
+    bool data_mode_seen = false;
+    bool start_time_seen = false;
+    bool end_time_seen = false;
+    bool parsed = true;
+    for (auto child : recording_node.children()) {
+        if (child.type() != pugi::node_element)
+            continue;
+        switch (schema::child_matcher<RecordingSession>.Find(child.name())) {
+            case Schema::DataMode:
+                if (not data_mode_seen)
+                    data_mode_ = child.text().get();
+                data_mode_seen = true;
+                break;
+            case Schema::StartTime:
+                if (not start_time_seen)
+                    start_time_ = child.text().get();
+                start_time_seen = true;
+                break;
+            case Schema::EndTime:
+                if (not end_time_seen)
+                    end_time_ = child.text().get();
+                end_time_seen = true;
+                break;
+            case Schema::Group:
+                parsed = ReadView<CommunicationSessionGroup>(child, groups_.emplace_back());
+                break;
+            case Schema::Session:
+                parsed = ReadView<CommunicationSession>(child, comm_sessions_.emplace_back());
+                break;
+            case Schema::Stream:
+                parsed = ReadView<MediaStream>(child, media_streams_.emplace_back());
+                break;
+            case Schema::Participant:
+                parsed = ReadView<Participant>(child, participants_.emplace_back());
+                break;
+            case Schema::SessionRecordingAssoc:
+                parsed = ReadView<CSRSAssociation>(child, csrs_associations_.emplace_back());
+                break;
+            case Schema::ParticipantSessionAssoc:
+                parsed = ReadView<ParticipantSessionAssociation>(child,
+                                                                 participant_session_associations_.emplace_back());
+                break;
+            case Schema::ParticipantStreamAssoc:
+                parsed = ReadView(child, participant_stream_associations_.emplace_back());
+                break;
+            default:
+                break;
+        }
+        if (not parsed) {
+            Clear();
+            return false;
+        }
+    }
+
+    return true;
+}
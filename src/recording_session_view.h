@@ -0,0 +1,137 @@
+// recording_session_view.h
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+/*
+ * Elements of a recording as views into its document. Missing values are empty, times are the RFC3339 text of the
+ * document and can be read with Timestamp::from_rfc3339().
+ */
+
+struct CommunicationSessionGroupView
+{
+    std::string_view group_id;
+    std::string_view associate_time;
+    std::string_view disassociate_time;
+};
+
+struct CommunicationSessionView
+{
+    std::string_view session_id;
+    std::string_view reason;
+    std::string_view start_time;
+    std::string_view stop_time;
+    std::vector<std::string_view> sip_session_ids;
+    std::string_view group_ref;
+};
+
+struct ParticipantView
+{
+    std::string_view participant_id;
+    std::vector<std::pair<std::string_view, std::string_view>> name_ids;  // (Name, AoR)
+};
+
+struct MediaStreamView
+{
+    std::string_view stream_id;
+    std::string_view session_id;
+    std::string_view label;
+    std::string_view content_type;
+};
+
+struct CSRSAssociationView
+{
+    std::string_view session_id;
+    std::string_view associate_time;
+    std::string_view disassociate_time;
+};
+
+struct ParticipantSessionAssociationView
+{
+    std::string_view participant_id;
+    std::string_view session_id;
+    std::string_view associate_time;
+    std::string_view disassociate_time;
+    std::vector<std::string_view> params;
+};
+
+// One participantstreamassoc element, with the streams the participant sends and receives
+struct ParticipantStreamAssociationView
+{
+    std::string_view participant_id;
+    std::vector<std::string_view> send;
+    std::vector<std::string_view> recv;
+};
+
+/**
+ * @brief Read-only recording metadata referring to its document instead of copying from it
+ *
+ * Parse() takes over the document and parses it in place: escapes are decoded within the buffer and every value is a
+ * view into it, so no string is copied. The views stay valid until the next Parse() or the end of the view.
+ *
+ * Elements are accepted like RecordingSession::FromXML() accepts them, extension elements are skipped.
+ *
+ */
+class RecordingSessionView
+{
+   private:
+    std::string xml_;
+    std::unique_ptr<pugi::xml_document> doc_;
+
+    std::string_view data_mode_;
+    std::string_view start_time_;
+    std::string_view end_time_;
+    std::vector<CommunicationSessionGroupView> groups_;
+    std::vector<CommunicationSessionView> comm_sessions_;
+    std::vector<ParticipantView> participants_;
+    std::vector<MediaStreamView> media_streams_;
+    std::vector<CSRSAssociationView> csrs_associations_;
+    std::vector<ParticipantSessionAssociationView> participant_session_associations_;
+    std::vector<ParticipantStreamAssociationView> participant_stream_associations_;
+
+    void Clear();
+
+   public:
+    RecordingSessionView();
+    ~RecordingSessionView();
+
+    RecordingSessionView(const RecordingSessionView &) = delete;
+    RecordingSessionView &operator=(const RecordingSessionView &) = delete;
+
+    /**
+     * @brief Take over the document and parse it, false if it is not a recording document
+     */
+    bool Parse(std::string xml_content);
+
+    /**
+     * @brief Data mode, "complete" if the document has none
+     */
+    std::string_view DataMode() const { return data_mode_; }
+    std::string_view StartTime() const { return start_time_; }
+    std::string_view EndTime() const { return end_time_; }
+
+    const std::vector<CommunicationSessionGroupView> &Groups() const { return groups_; }
+    const std::vector<CommunicationSessionView> &CommSessions() const { return comm_sessions_; }
+    const std::vector<ParticipantView> &Participants() const { return participants_; }
+    const std::vector<MediaStreamView> &MediaStreams() const { return media_streams_; }
+    const std::vector<CSRSAssociationView> &CS_RS_Associations() const { return csrs_associations_; }
+    const std::vector<ParticipantSessionAssociationView> &ParticipantSessionAssociations() const
+    {
+        return participant_session_associations_;
+    }
+    const std::vector<ParticipantStreamAssociationView> &ParticipantStreamAssociations() const
+    {
+        return participant_stream_associations_;
+    }
+};
+
+}  // namespace siprec_metadata
@@ -0,0 +1,227 @@
+#include "session_registry.h"
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace siprec_metadata;
+
+namespace
+{
+std::vector<std::string> SipSessionIdsOf(const RecordingSession& session)
+{
+    std::vector<std::string> keys;
+    for (const auto& comm_session : session.CommSessions()) {
+        for (const auto& sip_session_id : comm_session.SipSessionIds()) {
+            keys.push_back(sip_session_id);
+        }
+    }
+    std::ranges::sort(keys);
+    const auto duplicates = std::ranges::unique(keys);
+    keys.erase(duplicates.begin(), duplicates.end());
+    return keys;
+}
+}  // namespace
+
+struct SessionRegistry::Entry
+{
+    mutable std::shared_mutex mutex;
+    RecordingSession session;
+    std::vector<std::string> keys;           // sorted
+    std::vector<std::string> clashing_keys;  // sorted, SIP session IDs registered for another recording session
+    bool evicted = false;
+};
+
+struct alignas(64) SessionRegistry::Shard
+{
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+};
+
+namespace
+{
+// Exclusive locks of all shards touched by a set of keys, always taken in shard order
+class ShardLocks
+{
+   private:
+    std::vector<std::unique_lock<std::shared_mutex>> locks_;
+
+   public:
+    template <typename ShardOf>
+    ShardLocks(const std::vector<std::string>& keys, ShardOf shard_of)
+    {
+        std::vector<std::shared_mutex*> mutexes;
+        mutexes.reserve(keys.size());
+        for (const auto& key : keys) {
+            mutexes.push_back(&shard_of(key).mutex);
+        }
+        std::ranges::sort(mutexes);
+        const auto duplicates = std::ranges::unique(mutexes);
+        mutexes.erase(duplicates.begin(), duplicates.end());
+        locks_.reserve(mutexes.size());
+        for (auto* mutex : mutexes) {
+            locks_.emplace_back(*mutex);
+        }
+    }
+};
+}  // namespace
+
+SessionRegistry::SessionRegistry(std::size_t shard_count)
+    : shard_count_(std::max<std::size_t>(shard_count, 1)), shards_(std::make_unique<Shard[]>(shard_count_))
+{
+}
+
+SessionRegistry::~SessionRegistry() = default;
+
+SessionRegistry::Shard& SessionRegistry::ShardOf(const std::string& sip_session_id) const
+{
+    return shards_[std::hash<std::string>{}(sip_session_id) % shard_count_];
+}
+
+std::shared_ptr<SessionRegistry::Entry> SessionRegistry::Lookup(const std::string& sip_session_id) const
+{
+    auto& shard = ShardOf(sip_session_id);
+    std::shared_lock lock(shard.mutex);
+    auto entry_it = shard.entries.find(sip_session_id);
+    if (entry_it == shard.entries.end())
+        return nullptr;
+    return entry_it->second;
+}
+
+bool SessionRegistry::Insert(RecordingSession session)
+{
+    auto keys = SipSessionIdsOf(session);
+    if (keys.empty())
+        return false;
+
+    auto entry = std::make_shared<Entry>();
+    entry->session = std::move(session);
+    entry->keys = std::move(keys);
+
+    ShardLocks locks(entry->keys, [this](const std::string& key) -> Shard& { return ShardOf(key); });
+    for (const auto& key : entry->keys) {
+        if (ShardOf(key).entries.contains(key))
+            return false;
+    }
+    for (const auto& key : entry->keys) {
+        ShardOf(key).entries.emplace(key, entry);
+    }
+    ++size_;
+    return true;
+}
+
+bool SessionRegistry::Contains(const std::string& sip_session_id) const { return (Lookup(sip_session_id) != nullptr); }
+
+std::optional<RecordingSession> SessionRegistry::Find(const std::string& sip_session_id) const
+{
+    std::optional<RecordingSession> session;
+    Visit(sip_session_id, [&](const RecordingSession& registered) { session = registered; });
+    return session;
+}
+
+std::shared_ptr<const RecordingSessionSnapshot> SessionRegistry::Snapshot(const std::string& sip_session_id) const
+{
+    std::shared_ptr<const RecordingSessionSnapshot> snapshot;
+    Visit(sip_session_id, [&](const RecordingSession& registered) { snapshot = registered.Snapshot(); });
+    return snapshot;
+}
+
+bool SessionRegistry::Visit(const std::string& sip_session_id, const Visitor& visitor) const
+{
+    auto entry = Lookup(sip_session_id);
+    if (not entry)
+        return false;
+
+    std::shared_lock lock(entry->mutex);
+    if (entry->evicted)
+        return false;
+    visitor(entry->session);
+    return true;
+}
+
+bool SessionRegistry::Update(const std::string& sip_session_id, const Updater& updater)
+{
+    auto entry = Lookup(sip_session_id);
+    if (not entry)
+        return false;
+
+    std::unique_lock lock(entry->mutex);
+    if (entry->evicted)
+        return false;
+    updater(entry->session);
+
+    auto keys = SipSessionIdsOf(entry->session);
+    auto known = [&](const std::string& key) {
+        return std::ranges::binary_search(entry->keys, key) or std::ranges::binary_search(entry->clashing_keys, key);
+    };
+    if ((keys.size() == entry->keys.size() + entry->clashing_keys.size()) and std::ranges::all_of(keys, known))
+        return true;
+
+    std::vector<std::string> touched_keys;
+    for (const auto& key : entry->keys) {
+        if (not std::ranges::binary_search(keys, key))
+            touched_keys.push_back(key);
+    }
+    for (const auto& key : keys) {
+        if (not known(key))
+            touched_keys.push_back(key);
+    }
+    ShardLocks locks(touched_keys, [this](const std::string& key) -> Shard& { return ShardOf(key); });
+
+    std::vector<std::string> registered_keys;
+    std::vector<std::string> clashing_keys;
+    registered_keys.reserve(keys.size());
+    for (const auto& key : entry->keys) {
+        if (not std::ranges::binary_search(keys, key)) {
+            auto& entries = ShardOf(key).entries;
+            auto entry_it = entries.find(key);
+            if ((entry_it != entries.end()) and (entry_it->second == entry))
+                entries.erase(entry_it);
+        }
+    }
+    for (const auto& key : keys) {
+        if (std::ranges::binary_search(entry->keys, key))
+            registered_keys.push_back(key);
+        else if (std::ranges::binary_search(entry->clashing_keys, key))
+            clashing_keys.push_back(key);
+        else if (ShardOf(key).entries.emplace(key, entry).second)
+            registered_keys.push_back(key);
+        else
+            clashing_keys.push_back(key);
+    }
+    entry->keys = std::move(registered_keys);
+    entry->clashing_keys = std::move(clashing_keys);
+
+    // Without a key the recording session can not be found any more
+    if (entry->keys.empty()) {
+        entry->evicted = true;
+        --size_;
+    }
+    return true;
+}
+
+bool SessionRegistry::Evict(const std::string& sip_session_id)
+{
+    auto entry = Lookup(sip_session_id);
+    if (not entry)
+        return false;
+
+    std::unique_lock lock(entry->mutex);
+    if (entry->evicted)
+        return false;
+    entry->evicted = true;
+
+    ShardLocks locks(entry->keys, [this](const std::string& key) -> Shard& { return ShardOf(key); });
+    for (const auto& key : entry->keys) {
+        auto& entries = ShardOf(key).entries;
+        auto entry_it = entries.find(key);
+        if ((entry_it != entries.end()) and (entry_it->second == entry))
+            entries.erase(entry_it);
+    }
+    --size_;
+    return true;
+}
+
+std::size_t SessionRegistry::Size() const { return size_.load(); }
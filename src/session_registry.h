@@ -0,0 +1,91 @@
+// session_registry.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "siprec_metadata.h"
+
+namespace siprec_metadata
+{
+
+/**
+ * @brief Concurrent registry of recording sessions keyed by SIP session ID
+ *
+ * Every sipSessionID of every communication session of a registered recording session is a key of that session.
+ * Keys are spread over shards guarded by their own shared mutexes, and each recording session is guarded by its own
+ * mutex, so lookups never block each other and updates of different calls never contend.
+ *
+ */
+class SessionRegistry
+{
+   public:
+    using Visitor = std::function<void(const RecordingSession &)>;
+    using Updater = std::function<void(RecordingSession &)>;
+
+    explicit SessionRegistry(std::size_t shard_count = 64);
+    ~SessionRegistry();
+
+    SessionRegistry(const SessionRegistry &) = delete;
+    SessionRegistry &operator=(const SessionRegistry &) = delete;
+
+    /**
+     * @brief Register a recording session under all of its SIP session IDs
+     *
+     * Fails if the session has no SIP session IDs or if any of them is already registered.
+     */
+    bool Insert(RecordingSession session);
+
+    bool Contains(const std::string &sip_session_id) const;
+
+    /**
+     * @brief Copy of the recording session registered under the SIP session ID
+     */
+    std::optional<RecordingSession> Find(const std::string &sip_session_id) const;
+
+    /**
+     * @brief Immutable snapshot of the recording session registered under the SIP session ID
+     */
+    std::shared_ptr<const RecordingSessionSnapshot> Snapshot(const std::string &sip_session_id) const;
+
+    /**
+     * @brief Call visitor with the recording session under a shared lock, without copying it
+     */
+    bool Visit(const std::string &sip_session_id, const Visitor &visitor) const;
+
+    /**
+     * @brief Call updater with the recording session under an exclusive lock
+     *
+     * SIP session IDs added or removed by the updater are re-keyed afterwards. Added IDs which are already registered
+     * for another recording session stay with that session. A recording session left without a registered ID is
+     * evicted.
+     */
+    bool Update(const std::string &sip_session_id, const Updater &updater);
+
+    /**
+     * @brief Remove the recording session registered under the SIP session ID together with all of its keys
+     */
+    bool Evict(const std::string &sip_session_id);
+
+    /**
+     * @brief Number of registered recording sessions
+     */
+    std::size_t Size() const;
+
+   private:
+    struct Entry;
+    struct Shard;
+
+    std::size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<std::size_t> size_ = 0;
+
+    Shard &ShardOf(const std::string &sip_session_id) const;
+    std::shared_ptr<Entry> Lookup(const std::string &sip_session_id) const;
+};
+
+}  // namespace siprec_metadata
@@ -1,13 +1,27 @@
 #include "siprec_metadata.h"
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <random>
 #include <ranges>
+#include <spanstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include "pugixml.hpp"
+#include "siprec_metadata_internal.h"
+#include "siprec_metadata_schema.h"
 
 using namespace siprec_metadata;
 
@@ -80,338 +94,390 @@ std::string base64_encode(std::string_view data)
     return encoded;
 }
 
-std::string generate_unique_id()
+std::optional<std::string> base64_decode(std::string_view encoded)
 {
-    const auto uuid = generate_v4();
-    return base64_encode(uuid);
-}
+    // Accepts canonical encodings only: base64_encode(base64_decode(s)) == s
+    if (encoded.size() % 4 != 0)
+        return std::nullopt;
 
-bool FromXML(std::list<Participant>& participants, const pugi::xml_node& node)
-{
-    auto participant_id_attr = node.attribute("participant_id");
-    if (not participant_id_attr) {
-        return false;
-    }
-    Participant participant{participant_id_attr.value()};
+    std::string decoded;
+    decoded.reserve(encoded.size() / 4 * 3);
 
-    for (auto name_id_node : node.children("nameID")) {
-        std::string aor = name_id_node.attribute("aor").value();
-        if (auto name_node = name_id_node.child("name")) {
-            std::string name = name_node.text().get();
-            participant.AddNameId(name, aor);
+    for (size_t i = 0; i < encoded.size(); i += 4) {
+        uint32_t triple = 0;
+        int bytes = 3;
+        for (size_t j = 0; j < 4; ++j) {
+            const char c = encoded[i + j];
+            if (c == '=') {
+                // Padding is allowed only in the last two positions of the last group
+                if ((i + 4 != encoded.size()) or (j < 2) or ((j == 2) and (encoded[i + 3] != '=')))
+                    return std::nullopt;
+                bytes = std::min<int>(bytes, static_cast<int>(j) - 1);
+                triple <<= 6;
+                continue;
+            }
+            const auto pos = base64_chars.find(c);
+            if (pos == std::string_view::npos)
+                return std::nullopt;
+            triple = (triple << 6) | static_cast<uint32_t>(pos);
+        }
+        // Bits below the last decoded byte must be zero, so that every accepted string is canonical
+        if ((bytes < 3) and ((triple & (0xFFFFFFu >> (8 * bytes))) != 0))
+            return std::nullopt;
+        for (int k = 0; k < bytes; ++k) {
+            decoded.push_back(static_cast<char>((triple >> (16 - 8 * k)) & 0xFF));
         }
     }
 
-    participants.push_back(participant);
-
-    return true;
+    return decoded;
 }
 
-bool FromXML(std::list<ParticipantSessionAssociation>& participant_session_associations, const pugi::xml_node& node)
+std::string generate_unique_id()
 {
-    ParticipantSessionAssociation participant_session_association;
-
-    participant_session_association.SetParticipant(node.attribute("participant_id").value());
-    participant_session_association.SetSession(node.attribute("session_id").value());
-
-    if (auto associate_time_node = node.child("associate-time")) {
-        participant_session_association.SetAssociateTime(associate_time_node.text().get());
-    }
-
-    if (auto disassociate_time_node = node.child("disassociate-time")) {
-        participant_session_association.SetDisassociateTime(disassociate_time_node.text().get());
-    }
-
-    for (auto param_node : node.children("param")) {
-        participant_session_association.AddParam(param_node.text().get());
-    }
-
-    participant_session_associations.push_back(participant_session_association);
-
-    return true;
+    const auto uuid = generate_v4();
+    return base64_encode(uuid);
 }
 
-bool FromXML(std::list<ParticipantStreamAssociation>& participant_stream_associations, const pugi::xml_node& node)
+namespace
 {
-    auto participant_id_attr = node.attribute("participant_id");
-    if (not participant_id_attr)
-        return false;
-
-    const std::string participant_id = participant_id_attr.value();
-
-    for (auto send_node : node.children("send")) {
-        const std::string stream_id = send_node.text().get();
-
-        auto participant_stream_association_it = std::ranges::find_if(
-            participant_stream_associations, [&](const ParticipantStreamAssociation& participant_stream_association) {
-                return ((participant_stream_association.ParticipantId() == participant_id)
-                        and (participant_stream_association.StreamId() == stream_id));
-            });
-        if (participant_stream_association_it == participant_stream_associations.end()) {
-            ParticipantStreamAssociation participant_stream_association;
-            participant_stream_association.SetParticipant(participant_id);
-            participant_stream_association.SetStream(stream_id);
-            participant_stream_association.SetSend(true);
-            participant_stream_associations.push_back(participant_stream_association);
-        } else {
-            participant_stream_association_it->SetSend(true);
+// End of the element starting at begin, the document has been accepted by the parser
+std::size_t ElementEnd(std::string_view xml, std::size_t begin)
+{
+    std::size_t depth = 0;
+    std::size_t pos = begin;
+    for (;;) {
+        const std::size_t lt = xml.find('<', pos);
+        if (lt == std::string_view::npos)
+            return std::string_view::npos;
+        const std::string_view tag = xml.substr(lt);
+
+        std::string_view terminator;
+        if (tag.starts_with("<!--"))
+            terminator = "-->";
+        else if (tag.starts_with("<![CDATA["))
+            terminator = "]]>";
+        else if (tag.starts_with("<?"))
+            terminator = "?>";
+        if (not terminator.empty()) {
+            const std::size_t end = xml.find(terminator, lt + 2);
+            if (end == std::string_view::npos)
+                return std::string_view::npos;
+            pos = end + terminator.size();
+            continue;
         }
-    }
 
-    for (auto recv_node : node.children("recv")) {
-        const std::string stream_id = recv_node.text().get();
-
-        auto participant_stream_association_it = std::ranges::find_if(
-            participant_stream_associations, [&](const ParticipantStreamAssociation& participant_stream_association) {
-                return ((participant_stream_association.ParticipantId() == participant_id)
-                        and (participant_stream_association.StreamId() == stream_id));
-            });
-        if (participant_stream_association_it == participant_stream_associations.end()) {
-            ParticipantStreamAssociation participant_stream_association;
-            participant_stream_association.SetParticipant(participant_id);
-            participant_stream_association.SetStream(stream_id);
-            participant_stream_association.SetRecv(true);
-            participant_stream_associations.push_back(participant_stream_association);
-        } else {
-            participant_stream_association_it->SetRecv(true);
+        // Attribute values may contain '>'
+        std::size_t gt = lt + 1;
+        char quote = 0;
+        while ((gt < xml.size()) and ((xml[gt] != '>') or (quote != 0))) {
+            if ((quote == 0) and ((xml[gt] == '"') or (xml[gt] == '\'')))
+                quote = xml[gt];
+            else if (xml[gt] == quote)
+                quote = 0;
+            ++gt;
         }
-    }
+        if (gt >= xml.size())
+            return std::string_view::npos;
+        pos = gt + 1;
 
-    return true;
+        if (tag.starts_with("</"))
+            --depth;
+        else if (xml[gt - 1] != '/')
+            ++depth;
+        if (depth == 0)
+            return pos;
+    }
 }
 
-bool FromXML(std::list<CSRSAssociation>& csrs_associations, const pugi::xml_node& node)
+struct StringWriter : pugi::xml_writer
 {
-    CSRSAssociation csrs_association;
-    csrs_association.SetSession(node.attribute("session_id").value());
+    std::string out;
 
-    if (auto associate_time_node = node.child("associate-time")) {
-        csrs_association.SetAssociateTime(Timestamp::from_rfc3339(associate_time_node.text().get()));
-    }
+    void write(const void* data, size_t size) override { out.append(static_cast<const char*>(data), size); }
+};
 
-    if (auto disassociate_time_node = node.child("disassociate-time")) {
-        csrs_association.SetDisassociateTime(Timestamp::from_rfc3339(disassociate_time_node.text().get()));
+// Append a child element the parser does not know to the extensions of the element, as bytes of the document
+template <typename T>
+void AddExtension(T& element, const pugi::xml_node& child, std::string_view xml)
+{
+    // Offsets are known for documents parsed from one buffer, otherwise the element is printed
+    const std::ptrdiff_t name_offset = child.offset_debug();
+    if ((name_offset > 0) and (static_cast<std::size_t>(name_offset) <= xml.size())) {
+        const std::size_t begin = name_offset - 1;
+        const std::size_t end = ElementEnd(xml, begin);
+        if (end != std::string_view::npos) {
+            element.AddExtension(xml.substr(begin, end - begin));
+            return;
+        }
     }
-
-    csrs_associations.push_back(csrs_association);
-
-    return true;
+    StringWriter writer;
+    child.print(writer, "", pugi::format_raw);
+    element.AddExtension(writer.out);
 }
 
-bool FromXML(std::list<MediaStream>& streams, const pugi::xml_node& node)
+// New element constructed in place at the end of the list, with its id if it has one
+template <typename Entity>
+Entity& EmplaceElement(std::list<Entity>& elements, const pugi::xml_node& node)
 {
-    auto stream_id_attr = node.attribute("stream_id");
-    if (not stream_id_attr) {
-        return false;
-    }
-    MediaStream stream{stream_id_attr.value()};
-
-    auto session_id_attr = node.attribute("session_id");
-    if (not session_id_attr) {
-        return false;
-    }
-    stream.SetSessionId(session_id_attr.value());
-
-    if (auto label_node = node.child("label")) {
-        stream.SetLabel(label_node.text().get());
-    }
-
-    if (auto content_type_node = node.child("content-type")) {
-        stream.SetContentType(content_type_node.text().get());
-    }
-
-    streams.push_back(stream);
-
-    return true;
+    if constexpr (requires { schema::Schema<Entity>::key; })
+        return elements.emplace_back(node.attribute(schema::Schema<Entity>::key.name).value());
+    else
+        return elements.emplace_back();
 }
 
-bool FromXML(std::list<CommunicationSession>& sessions, const pugi::xml_node& node)
+template <typename Entity>
+void ReadField(Entity& element, const pugi::xml_node& node, const schema::Attribute<Entity>& field)
 {
-    auto session_id_attr = node.attribute("session_id");
-    if (not session_id_attr) {
-        return false;
-    }
-    CommunicationSession session{session_id_attr.value()};
-
-    if (auto group_ref_node = node.child("group-ref")) {
-        session.SetGroupRef(group_ref_node.text().get());
-    }
-
-    if (auto reason_node = node.child("reason")) {
-        session.SetReason(reason_node.text().get());
-    }
-
-    if (auto start_time_node = node.child("start-time")) {
-        session.SetStartTime(Timestamp::from_rfc3339(start_time_node.text().get()));
-    }
-
-    if (auto stop_time_node = node.child("stop-time")) {
-        session.SetStopTime(Timestamp::from_rfc3339(stop_time_node.text().get()));
-    }
-
-    for (auto sip_session_node : node.children("sipSessionID")) {
-        session.AddSipSessionId(sip_session_node.text().get());
-    }
-
-    sessions.push_back(session);
-
-    return true;
+    (element.*field.set)(node.attribute(field.name).value());
 }
 
-bool FromXML(std::list<CommunicationSessionGroup>& groups, const pugi::xml_node& node)
+template <typename Entity, typename Value, typename Argument>
+void ReadField(Entity& element, const pugi::xml_node& child, const schema::Text<Entity, Value, Argument>& field)
 {
-    auto group_id_attr = node.attribute("group_id");
-    if (not group_id_attr) {
-        return false;
-    }
-    CommunicationSessionGroup group{group_id_attr.value()};
-
-    if (auto associate_time_node = node.child("associate-time")) {
-        group.SetAssociateTime(Timestamp::from_rfc3339(associate_time_node.text().get()));
-    }
-
-    if (auto disassociate_time_node = node.child("disassociate-time")) {
-        group.SetDisassociateTime(Timestamp::from_rfc3339(disassociate_time_node.text().get()));
-    }
-
-    groups.push_back(group);
-
-    return true;
+    (element.*field.set)(child.text().get());
 }
 
-pugi::xml_node ToXML(const Participant& participant, pugi::xml_node& parent)
+template <typename Entity, typename Value>
+void ReadField(Entity& element, const pugi::xml_node& child, const schema::Time<Entity, Value>& field)
 {
-    auto participant_node = parent.append_child("participant");
-    participant_node.append_attribute("participant_id").set_value(participant.ParticipantId());
-
-    for (const auto& [name, aor] : participant.NameIds()) {
-        auto name_id_node = participant_node.append_child("nameID");
-        name_id_node.append_attribute("aor").set_value(aor);
-        if (!name.empty()) {
-            auto name_node = name_id_node.append_child("name");
-            name_node.append_attribute("xml:lang").set_value("it");
-            name_node.text().set(name);
-        }
-    }
-
-    return participant_node;
+    (element.*field.set)(Timestamp::from_rfc3339(child.text().get()));
 }
 
-pugi::xml_node ToXML(const MediaStream& stream, pugi::xml_node& parent)
+template <typename Entity>
+void ReadField(Entity& element, const pugi::xml_node& child, const schema::TextList<Entity>& field)
 {
-    auto stream_node = parent.append_child("stream");
-    stream_node.append_attribute("stream_id").set_value(stream.StreamId());
-    stream_node.append_attribute("session_id").set_value(stream.SessionId());
-
-    if (not stream.Label().empty()) {
-        stream_node.append_child("label").text().set(stream.Label());
-    }
-
-    if (stream.ContentType()) {
-        stream_node.append_child("content-type").text().set(stream.ContentType().value());
-    }
-
-    return stream_node;
+    (element.*field.add)(child.text().get());
 }
 
-pugi::xml_node ToXML(const ParticipantSessionAssociation& participant_session_association, pugi::xml_node& parent)
+void ReadField(Participant& participant, const pugi::xml_node& child, const schema::NameIds& field)
 {
-    auto assoc_node = parent.append_child("participantsessionassoc");
-    assoc_node.append_attribute("participant_id").set_value(participant_session_association.ParticipantId());
-    assoc_node.append_attribute("session_id").set_value(participant_session_association.SessionId());
-
-    assoc_node.append_child("associate-time").text().set(participant_session_association.AssociateTime().to_rfc3339());
+    if (auto name_node = child.child(field.display_name))
+        participant.AddNameId(name_node.text().get(), child.attribute(field.aor).value());
+}
 
-    if (participant_session_association.DisassociateTime()) {
-        assoc_node.append_child("disassociate-time")
-            .text()
-            .set(participant_session_association.DisassociateTime().value().to_rfc3339());
-    }
+// Fields read from any number of elements, the others from the first one as pugixml's child() would find it
+template <typename Field>
+constexpr bool is_repeated = false;
+template <typename Entity>
+constexpr bool is_repeated<schema::TextList<Entity>> = true;
+template <>
+constexpr bool is_repeated<schema::NameIds> = true;
+}  // namespace
+
+template <typename Entity>
+bool FromXML(std::list<Entity>& elements, const pugi::xml_node& node, std::string_view xml)
+{
+    using Schema = schema::Schema<Entity>;
+
+    bool required_present = std::apply(
+        [&](const auto&... attributes) {
+            return ((not attributes.required or node.attribute(attributes.name)) and ...);
+        },
+        Schema::attributes);
+    if constexpr (requires { Schema::key; })
+        required_present = required_present and node.attribute(Schema::key.name);
+    if (not required_present)
+        return false;
 
-    for (const auto& param : participant_session_association.Params()) {
-        assoc_node.append_child("param").text().set(param);
+    Entity& element = EmplaceElement(elements, node);
+    std::apply([&](const auto&... attributes) { (ReadField(element, node, attributes), ...); }, Schema::attributes);
+
+    // One pass over the children, each is matched against the schema by its name
+    constexpr std::size_t child_count = schema::child_count<Entity>;
+    static_assert(child_count <= 32);
+    std::uint32_t read = 0;
+    for (auto child : node.children()) {
+        if (child.type() != pugi::node_element)
+            continue;
+        const std::size_t index = schema::child_matcher<Entity>.Find(child.name());
+        if (index == child_count) {
+            AddExtension(element, child, xml);
+            continue;
+        }
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ([&] {
+                if (index != I)
+                    return;
+                const auto& field = std::get<I>(Schema::children);
+                if (not is_repeated<std::remove_cvref_t<decltype(field)>>) {
+                    if (read & (1u << I))
+                        return;
+                    read |= 1u << I;
+                }
+                ReadField(element, child, field);
+            }(), ...);
+        }(std::make_index_sequence<child_count>());
     }
 
-    return assoc_node;
+    return true;
 }
 
-pugi::xml_node ToXML(const CSRSAssociation& csrs_association, pugi::xml_node& parent)
+template bool FromXML(std::list<CommunicationSessionGroup>&, const pugi::xml_node&, std::string_view);
+template bool FromXML(std::list<CommunicationSession>&, const pugi::xml_node&, std::string_view);
+template bool FromXML(std::list<Participant>&, const pugi::xml_node&, std::string_view);
+template bool FromXML(std::list<MediaStream>&, const pugi::xml_node&, std::string_view);
+template bool FromXML(std::list<CSRSAssociation>&, const pugi::xml_node&, std::string_view);
+template bool FromXML(std::list<ParticipantSessionAssociation>&, const pugi::xml_node&, std::string_view);
+
+bool FromXML(std::list<ParticipantStreamAssociation>& participant_stream_associations, const pugi::xml_node& node,
+             std::string_view xml, RawElements& extensions)
 {
-    auto assoc_node = parent.append_child("sessionrecordingassoc");
-    assoc_node.append_attribute("session_id").set_value(csrs_association.SessionId());
+    using Schema = schema::Schema<ParticipantStreamAssociation>;
+
+    auto participant_id_attr = node.attribute(Schema::participant);
+    if (not participant_id_attr)
+        return false;
 
-    assoc_node.append_child("associate-time").text().set(csrs_association.AssociateTime().to_rfc3339());
+    const std::string_view participant_id = participant_id_attr.value();
+
+    for (auto child : node.children()) {
+        if (child.type() != pugi::node_element)
+            continue;
+        const std::size_t index = schema::child_matcher<ParticipantStreamAssociation>.Find(child.name());
+        if (index == schema::child_count<ParticipantStreamAssociation>) {
+            struct
+            {
+                RawElements& elements;
+                void AddExtension(std::string_view element) { elements.Append(element); }
+            } sink{extensions};
+            AddExtension(sink, child, xml);
+            continue;
+        }
+        const std::string_view stream_id = child.text().get();
 
-    if (csrs_association.DisassociateTime()) {
-        assoc_node.append_child("disassociate-time")
-            .text()
-            .set(csrs_association.DisassociateTime().value().to_rfc3339());
+        auto participant_stream_association_it = std::ranges::find_if(
+            participant_stream_associations, [&](const ParticipantStreamAssociation& participant_stream_association) {
+                return ((participant_stream_association.ParticipantId() == participant_id)
+                        and (participant_stream_association.StreamId() == stream_id));
+            });
+        if (participant_stream_association_it == participant_stream_associations.end()) {
+            auto& participant_stream_association = participant_stream_associations.emplace_back();
+            participant_stream_association.SetParticipant(participant_id);
+            participant_stream_association.SetStream(stream_id);
+            participant_stream_association_it = std::prev(participant_stream_associations.end());
+        }
+        if (index == Schema::Send)
+            participant_stream_association_it->SetSend(true);
+        else
+            participant_stream_association_it->SetRecv(true);
     }
 
-    return assoc_node;
+    return true;
 }
 
-pugi::xml_node ToXML(const CommunicationSession& communication_session, pugi::xml_node& parent)
+// Share the elements of the previous snapshot which have not been modified since
+template <typename T>
+RecordingSessionSnapshot::Elements<T> ShareElements(const std::list<T>& elements,
+                                                    const RecordingSessionSnapshot::Elements<T>* previous)
 {
-    auto session_node = parent.append_child("session");
-    session_node.append_attribute("session_id").set_value(communication_session.SessionId());
-
-    if (communication_session.Reason()) {
-        session_node.append_child("reason").text().set(communication_session.Reason().value());
-    }
-
-    if (communication_session.StartTime()) {
-        session_node.append_child("start-time").text().set(communication_session.StartTime().value().to_rfc3339());
-    }
-
-    if (communication_session.StopTime()) {
-        session_node.append_child("stop-time").text().set(communication_session.StopTime().value().to_rfc3339());
-    }
+    RecordingSessionSnapshot::Elements<T> shared;
+    shared.reserve(elements.size());
 
-    for (const auto& sip_session_id : communication_session.SipSessionIds()) {
-        session_node.append_child("sipSessionID").text().set(sip_session_id);
-    }
+    // Elements usually keep their positions, other ones are looked up by revision
+    std::unordered_map<std::uint64_t, std::shared_ptr<const T>> previous_by_revision;
+    bool previous_indexed = false;
 
-    if (communication_session.GroupRef()) {
-        session_node.append_child("group-ref").text().set(communication_session.GroupRef().value());
+    std::size_t index = 0;
+    for (const auto& element : elements) {
+        if (previous and (index < previous->size()) and ((*previous)[index]->Revision() == element.Revision())) {
+            shared.push_back((*previous)[index]);
+        } else {
+            if (previous and not previous_indexed) {
+                previous_by_revision.reserve(previous->size());
+                for (const auto& previous_element : *previous) {
+                    previous_by_revision.emplace(previous_element->Revision(), previous_element);
+                }
+                previous_indexed = true;
+            }
+            auto previous_it = previous_by_revision.find(element.Revision());
+            if (previous_it != previous_by_revision.end()) {
+                shared.push_back(previous_it->second);
+            } else {
+                shared.push_back(std::make_shared<const T>(element));
+            }
+        }
+        ++index;
     }
 
-    return session_node;
+    return shared;
 }
+}  // namespace siprec_metadata
 
-pugi::xml_node ToXML(const CommunicationSessionGroup& group, pugi::xml_node& parent)
+std::uint64_t detail::NextRevision()
 {
-    auto group_node = parent.append_child("group");
-    group_node.append_attribute("group_id").set_value(group.GroupId());
-
-    if (group.AssociateTime()) {
-        group_node.append_child("associate-time").text().set(group.AssociateTime().value().to_rfc3339());
-    }
+    // Revisions are handed out to threads in blocks to keep the shared counter off the hot path
+    constexpr std::uint64_t block_size = 1024;
+    static std::atomic<std::uint64_t> next_block{0};
+    thread_local std::uint64_t next = 0;
+    thread_local std::uint64_t block_end = 0;
 
-    if (group.DisassociateTime()) {
-        group_node.append_child("disassociate-time").text().set(group.DisassociateTime().value().to_rfc3339());
+    if (next == block_end) {
+        next = next_block.fetch_add(block_size, std::memory_order_relaxed);
+        block_end = next + block_size;
     }
-
-    return group_node;
+    return next++;
 }
-}  // namespace siprec_metadata
 
 bool Timestamp::operator==(const Timestamp& other) const { return (time_ == other.time_); }
 
+bool Timestamp::operator<(const Timestamp& other) const { return (time_ < other.time_); }
+
 std::string Timestamp::to_rfc3339() const
 {
-    auto time_t = std::chrono::system_clock::to_time_t(time_);
-    std::tm tm = *std::gmtime(&time_t);
+    char buffer[rfc3339_max_size];
+    return std::string(buffer, to_rfc3339(buffer));
+}
+
+std::size_t Timestamp::to_rfc3339(char* buffer) const
+{
+    // Digits of a number, most significant first and padded with zeros to the width
+    auto put = [&](char* out, std::int64_t value, int width) {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count < width) {
+            digits[count++] = '0';
+        }
+        while (count > 0) {
+            *out++ = digits[--count];
+        }
+        return out;
+    };
 
-    char buffer[30];
-    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
-    return std::string(buffer);
+    // Seconds are truncated as by system_clock::to_time_t()
+    const auto seconds = std::chrono::time_point_cast<std::chrono::seconds>(time_);
+    const auto day = std::chrono::floor<std::chrono::days>(seconds);
+    const std::chrono::year_month_day date{day};
+    const std::chrono::hh_mm_ss time{seconds - day};
+
+    char* out = buffer;
+    std::int64_t year = static_cast<int>(date.year());
+    if (year < 0) {
+        *out++ = '-';
+        year = -year;
+    }
+    out = put(out, year, 4);
+    *out++ = '-';
+    out = put(out, static_cast<unsigned>(date.month()), 2);
+    *out++ = '-';
+    out = put(out, static_cast<unsigned>(date.day()), 2);
+    *out++ = 'T';
+    out = put(out, time.hours().count(), 2);
+    *out++ = ':';
+    out = put(out, time.minutes().count(), 2);
+    *out++ = ':';
+    out = put(out, time.seconds().count(), 2);
+    *out++ = 'Z';
+    return out - buffer;
 }
 
-Timestamp Timestamp::from_rfc3339(const std::string& rfc3339)
+Timestamp Timestamp::from_rfc3339(std::string_view rfc3339)
 {
     std::chrono::sys_seconds tp;
-    std::istringstream ss(rfc3339);
+    std::ispanstream ss(rfc3339);
 
     // Парсим напрямую в системное время (всегда UTC)
     ss >> std::chrono::parse("%Y-%m-%dT%H:%M:%SZ", tp);
@@ -434,7 +500,7 @@ Timestamp Timestamp::now() { return Timestamp(std::chrono::system_clock::now());
 
 Participant::Participant() : participant_id_(generate_unique_id()) {}
 
-Participant::Participant(const std::string& id) : participant_id_(id)
+Participant::Participant(std::string_view id) : participant_id_(id)
 {
     if (participant_id_.empty())
         participant_id_ = generate_unique_id();
@@ -442,12 +508,14 @@ Participant::Participant(const std::string& id) : participant_id_(id)
 
 bool Participant::operator==(const Participant& other) const
 {
-    return ((participant_id_ == other.participant_id_) and (name_id_ == other.name_id_));
+    return ((participant_id_ == other.participant_id_) and (name_id_ == other.name_id_)
+            and (extensions_ == other.extensions_)
+            and (stream_association_extensions_ == other.stream_association_extensions_));
 }
 
 MediaStream::MediaStream() : stream_id_(generate_unique_id()) {}
 
-MediaStream::MediaStream(const std::string& stream_id) : stream_id_(stream_id)
+MediaStream::MediaStream(std::string_view stream_id) : stream_id_(stream_id)
 {
     if (stream_id_.empty())
         stream_id_ = generate_unique_id();
@@ -456,22 +524,43 @@ MediaStream::MediaStream(const std::string& stream_id) : stream_id_(stream_id)
 bool MediaStream::operator==(const MediaStream& other) const
 {
     return ((stream_id_ == other.stream_id_) and (label_ == other.label_) and (content_type_ == other.content_type_)
-            and (session_id_ == other.session_id_));
+            and (session_id_ == other.session_id_) and (extensions_ == other.extensions_));
 }
 
 const std::string& MediaStream::StreamId() const { return stream_id_; }
 
 const std::string& MediaStream::Label() const { return label_; }
 
-const std::optional<std::string>& MediaStream::ContentType() const { return content_type_; }
+const std::optional<InternedString>& MediaStream::ContentType() const { return content_type_; }
 
 const std::string& MediaStream::SessionId() const { return session_id_; }
 
-void MediaStream::SetSessionId(const std::string& session_id) { session_id_ = session_id; }
+const RawElements& MediaStream::Extensions() const { return extensions_; }
+
+void MediaStream::SetSessionId(std::string_view session_id)
+{
+    const InternedString previous = std::exchange(session_id_, InternedString(session_id));
+    Modified();
+    Indexes().SessionChanged(*this, previous);
+}
+
+void MediaStream::SetLabel(std::string_view label)
+{
+    label_ = label;
+    Modified();
+}
 
-void MediaStream::SetLabel(const std::string& label) { label_ = label; }
+void MediaStream::SetContentType(std::string_view content_type)
+{
+    content_type_ = content_type;
+    Modified();
+}
 
-void MediaStream::SetContentType(const std::string& content_type) { content_type_ = content_type; }
+void MediaStream::AddExtension(std::string_view element)
+{
+    extensions_.Append(element);
+    Modified();
+}
 
 bool ParticipantStreamAssociation::operator==(const ParticipantStreamAssociation& other) const
 {
@@ -482,7 +571,7 @@ bool ParticipantStreamAssociation::operator==(const ParticipantStreamAssociation
 
 const Timestamp& ParticipantStreamAssociation::AssociateTime() const { return associate_time_; }
 
-const auto& ParticipantStreamAssociation::DisassociateTime() const { return disassociate_time_; }
+const std::optional<Timestamp>& ParticipantStreamAssociation::DisassociateTime() const { return disassociate_time_; }
 
 bool ParticipantStreamAssociation::IsSender() const { return send_; }
 
@@ -492,36 +581,63 @@ const std::string& ParticipantStreamAssociation::ParticipantId() const { return
 
 const std::string& ParticipantStreamAssociation::StreamId() const { return stream_id_; }
 
-void ParticipantStreamAssociation::SetParticipant(const std::string& participant_id)
+void ParticipantStreamAssociation::SetParticipant(std::string_view participant_id)
 {
     participant_id_ = participant_id;
+    Modified();
+    Indexes().Invalidate();
 }
 
-void ParticipantStreamAssociation::SetStream(const std::string& stream_id) { stream_id_ = stream_id; }
+void ParticipantStreamAssociation::SetStream(std::string_view stream_id)
+{
+    stream_id_ = stream_id;
+    Modified();
+    Indexes().Invalidate();
+}
 
-void ParticipantStreamAssociation::SetSend(bool send) { send_ = send; }
+void ParticipantStreamAssociation::SetSend(bool send)
+{
+    send_ = send;
+    Modified();
+    Indexes().Invalidate();
+}
 
-void ParticipantStreamAssociation::SetRecv(bool recv) { recv_ = recv; }
+void ParticipantStreamAssociation::SetRecv(bool recv)
+{
+    recv_ = recv;
+    Modified();
+    Indexes().Invalidate();
+}
 
-void ParticipantStreamAssociation::SetAssociateTime(const Timestamp& time) { associate_time_ = time; }
+void ParticipantStreamAssociation::SetAssociateTime(const Timestamp& time)
+{
+    associate_time_ = time;
+    Modified();
+}
 
-void ParticipantStreamAssociation::SetAssociateTime(const std::string& time_rfc3339)
+void ParticipantStreamAssociation::SetAssociateTime(std::string_view time_rfc3339)
 {
     associate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
 }
 
-void ParticipantStreamAssociation::SetDisassociateTime(const Timestamp& time) { disassociate_time_ = time; }
+void ParticipantStreamAssociation::SetDisassociateTime(const Timestamp& time)
+{
+    disassociate_time_ = time;
+    Modified();
+}
 
-void ParticipantStreamAssociation::SetDisassociateTime(const std::string& time_rfc3339)
+void ParticipantStreamAssociation::SetDisassociateTime(std::string_view time_rfc3339)
 {
     disassociate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
 }
 
 bool ParticipantSessionAssociation::operator==(const ParticipantSessionAssociation& other) const
 {
     return ((associate_time_ == other.associate_time_) and (disassociate_time_ == other.disassociate_time_)
             and (params_ == other.params_) and (participant_id_ == other.participant_id_)
-            and (session_id_ == other.session_id_));
+            and (session_id_ == other.session_id_) and (extensions_ == other.extensions_));
 }
 
 const Timestamp& ParticipantSessionAssociation::AssociateTime() const { return associate_time_; }
@@ -530,36 +646,65 @@ const std::optional<Timestamp>& ParticipantSessionAssociation::DisassociateTime(
 
 const std::list<std::string>& ParticipantSessionAssociation::Params() const { return params_; }
 
+const RawElements& ParticipantSessionAssociation::Extensions() const { return extensions_; }
+
 const std::string& ParticipantSessionAssociation::ParticipantId() const { return participant_id_; }
 
 const std::string& ParticipantSessionAssociation::SessionId() const { return session_id_; }
 
-void ParticipantSessionAssociation::SetParticipant(const std::string& participant_id)
+void ParticipantSessionAssociation::SetParticipant(std::string_view participant_id)
 {
     participant_id_ = participant_id;
+    Modified();
+    Indexes().Invalidate();
 }
 
-void ParticipantSessionAssociation::SetSession(const std::string& session_id) { session_id_ = session_id; }
+void ParticipantSessionAssociation::SetSession(std::string_view session_id)
+{
+    session_id_ = session_id;
+    Modified();
+    Indexes().Invalidate();
+}
 
-void ParticipantSessionAssociation::AddParam(const std::string& param) { params_.push_back(param); }
+void ParticipantSessionAssociation::AddParam(std::string param)
+{
+    params_.push_back(std::move(param));
+    Modified();
+}
 
-void ParticipantSessionAssociation::SetAssociateTime(const Timestamp& time) { associate_time_ = time; }
+void ParticipantSessionAssociation::AddExtension(std::string_view element)
+{
+    extensions_.Append(element);
+    Modified();
+}
 
-void ParticipantSessionAssociation::SetAssociateTime(const std::string& time_rfc3339)
+void ParticipantSessionAssociation::SetAssociateTime(const Timestamp& time)
+{
+    associate_time_ = time;
+    Modified();
+}
+
+void ParticipantSessionAssociation::SetAssociateTime(std::string_view time_rfc3339)
 {
     associate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
 }
 
-void ParticipantSessionAssociation::SetDisassociateTime(const Timestamp& time) { disassociate_time_ = time; }
+void ParticipantSessionAssociation::SetDisassociateTime(const Timestamp& time)
+{
+    disassociate_time_ = time;
+    Modified();
+}
 
-void ParticipantSessionAssociation::SetDisassociateTime(const std::string& time_rfc3339)
+void ParticipantSessionAssociation::SetDisassociateTime(std::string_view time_rfc3339)
 {
     disassociate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
 }
 
 CommunicationSession::CommunicationSession() : session_id_(generate_unique_id()) {}
 
-CommunicationSession::CommunicationSession(const std::string& id) : session_id_(id)
+CommunicationSession::CommunicationSession(std::string_view id) : session_id_(id)
 {
     if (session_id_.empty())
         session_id_ = generate_unique_id();
@@ -569,7 +714,8 @@ bool CommunicationSession::operator==(const CommunicationSession& other) const
 {
     return ((session_id_ == other.session_id_) and (reason_ == other.reason_)
             and (sip_session_ids_ == other.sip_session_ids_) and (group_ref_ == other.group_ref_)
-            and (start_time_ == other.start_time_) and (stop_time_ == other.stop_time_));
+            and (start_time_ == other.start_time_) and (stop_time_ == other.stop_time_)
+            and (extensions_ == other.extensions_));
 }
 
 const std::string& CommunicationSession::SessionId() const { return session_id_; }
@@ -578,25 +724,54 @@ const std::optional<std::string>& CommunicationSession::Reason() const { return
 
 const std::list<std::string>& CommunicationSession::SipSessionIds() const { return sip_session_ids_; }
 
-const std::optional<std::string>& CommunicationSession::GroupRef() const { return group_ref_; }
+const RawElements& CommunicationSession::Extensions() const { return extensions_; }
+
+const std::optional<InternedString>& CommunicationSession::GroupRef() const { return group_ref_; }
 
 const std::optional<Timestamp>& CommunicationSession::StartTime() const { return start_time_; }
 
 const std::optional<Timestamp>& CommunicationSession::StopTime() const { return stop_time_; }
 
-void CommunicationSession::SetReason(const std::string& reason) { reason_ = reason; }
+void CommunicationSession::SetReason(std::string reason)
+{
+    reason_ = std::move(reason);
+    Modified();
+}
+
+void CommunicationSession::AddSipSessionId(std::string session_id)
+{
+    const auto& added = sip_session_ids_.emplace_back(std::move(session_id));
+    Modified();
+    Indexes().SipSessionIdAdded(*this, added);
+}
 
-void CommunicationSession::AddSipSessionId(const std::string& session_id) { sip_session_ids_.push_back(session_id); }
+void CommunicationSession::SetGroupRef(std::string_view group_ref)
+{
+    group_ref_ = group_ref;
+    Modified();
+}
 
-void CommunicationSession::SetGroupRef(const std::string& group_ref) { group_ref_ = group_ref; }
+void CommunicationSession::SetStartTime(const Timestamp& time)
+{
+    start_time_ = time;
+    Modified();
+}
 
-void CommunicationSession::SetStartTime(const Timestamp& time) { start_time_ = time; }
+void CommunicationSession::SetStopTime(const Timestamp& time)
+{
+    stop_time_ = time;
+    Modified();
+}
 
-void CommunicationSession::SetStopTime(const Timestamp& time) { stop_time_ = time; }
+void CommunicationSession::AddExtension(std::string_view element)
+{
+    extensions_.Append(element);
+    Modified();
+}
 
 CommunicationSessionGroup::CommunicationSessionGroup() : group_id_(generate_unique_id()) {}
 
-CommunicationSessionGroup::CommunicationSessionGroup(const std::string& id) : group_id_(id)
+CommunicationSessionGroup::CommunicationSessionGroup(std::string_view id) : group_id_(id)
 {
     if (group_id_.empty())
         group_id_ = generate_unique_id();
@@ -605,7 +780,7 @@ CommunicationSessionGroup::CommunicationSessionGroup(const std::string& id) : gr
 bool CommunicationSessionGroup::operator==(const CommunicationSessionGroup& other) const
 {
     return ((group_id_ == other.group_id_) and (associate_time_ == other.associate_time_)
-            and (disassociate_time_ == other.disassociate_time_));
+            and (disassociate_time_ == other.disassociate_time_) and (extensions_ == other.extensions_));
 }
 
 const std::string& CommunicationSessionGroup::GroupId() const { return group_id_; }
@@ -614,24 +789,42 @@ const std::optional<Timestamp>& CommunicationSessionGroup::AssociateTime() const
 
 const std::optional<Timestamp>& CommunicationSessionGroup::DisassociateTime() const { return disassociate_time_; }
 
-void CommunicationSessionGroup::SetAssociateTime(const Timestamp& time) { associate_time_ = time; }
+const RawElements& CommunicationSessionGroup::Extensions() const { return extensions_; }
+
+void CommunicationSessionGroup::SetAssociateTime(const Timestamp& time)
+{
+    associate_time_ = time;
+    Modified();
+}
 
-void CommunicationSessionGroup::SetAssociateTime(const std::string& time_rfc3339)
+void CommunicationSessionGroup::SetAssociateTime(std::string_view time_rfc3339)
 {
     associate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
 }
 
-void CommunicationSessionGroup::SetDisassociateTime(const Timestamp& time) { disassociate_time_ = time; }
+void CommunicationSessionGroup::SetDisassociateTime(const Timestamp& time)
+{
+    disassociate_time_ = time;
+    Modified();
+}
 
-void CommunicationSessionGroup::SetDisassociateTime(const std::string& time_rfc3339)
+void CommunicationSessionGroup::SetDisassociateTime(std::string_view time_rfc3339)
 {
     disassociate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
+}
+
+void CommunicationSessionGroup::AddExtension(std::string_view element)
+{
+    extensions_.Append(element);
+    Modified();
 }
 
 bool CSRSAssociation::operator==(const CSRSAssociation& other) const
 {
     return ((associate_time_ == other.associate_time_) and (disassociate_time_ == other.disassociate_time_)
-            and (session_id_ == other.session_id_));
+            and (session_id_ == other.session_id_) and (extensions_ == other.extensions_));
 }
 
 const Timestamp& CSRSAssociation::AssociateTime() const { return associate_time_; }
@@ -640,45 +833,76 @@ const std::optional<Timestamp>& CSRSAssociation::DisassociateTime() const { retu
 
 const std::string& CSRSAssociation::SessionId() const { return session_id_; }
 
-void CSRSAssociation::SetSession(const CommunicationSession& session) { session_id_ = session.SessionId(); }
+const RawElements& CSRSAssociation::Extensions() const { return extensions_; }
+
+void CSRSAssociation::SetSession(const CommunicationSession& session)
+{
+    session_id_ = session.SessionId();
+    Modified();
+    Indexes().Invalidate();
+}
 
-void CSRSAssociation::SetSession(const std::string& session_id) { session_id_ = session_id; }
+void CSRSAssociation::SetSession(std::string_view session_id)
+{
+    session_id_ = session_id;
+    Modified();
+    Indexes().Invalidate();
+}
 
-void CSRSAssociation::SetAssociateTime(const std::string& time_rfc3339)
+void CSRSAssociation::SetAssociateTime(std::string_view time_rfc3339)
 {
     associate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
 }
 
-void CSRSAssociation::SetAssociateTime(const Timestamp& timestamp) { associate_time_ = timestamp; }
+void CSRSAssociation::SetAssociateTime(const Timestamp& timestamp)
+{
+    associate_time_ = timestamp;
+    Modified();
+}
 
-void CSRSAssociation::SetDisassociateTime(const std::string& time_rfc3339)
+void CSRSAssociation::SetDisassociateTime(std::string_view time_rfc3339)
 {
     disassociate_time_ = Timestamp::from_rfc3339(time_rfc3339);
+    Modified();
+}
+
+void CSRSAssociation::SetDisassociateTime(const Timestamp& timestamp)
+{
+    disassociate_time_ = timestamp;
+    Modified();
 }
 
-void CSRSAssociation::SetDisassociateTime(const Timestamp& timestamp) { disassociate_time_ = timestamp; }
+void CSRSAssociation::AddExtension(std::string_view element)
+{
+    extensions_.Append(element);
+    Modified();
+}
 
-CommunicationSessionGroup& RecordingSession::AddGroup(const std::string& group_id)
+CommunicationSessionGroup& RecordingSession::AddGroup(std::string_view group_id)
 {
     groups_.emplace_back(group_id);
     return groups_.back();
 }
 
-CommunicationSession& RecordingSession::AddCommSession(const std::string& session_id)
+CommunicationSession& RecordingSession::AddCommSession(std::string_view session_id)
 {
     comm_sessions_.emplace_back(session_id);
+    IndexAppended(comm_sessions_);
     return comm_sessions_.back();
 }
 
-Participant& RecordingSession::AddParticipant(const std::string& participant_id)
+Participant& RecordingSession::AddParticipant(std::string_view participant_id)
 {
     participants_.emplace_back(participant_id);
+    IndexAppended(participants_);
     return participants_.back();
 }
 
-MediaStream& RecordingSession::AddStream(const std::string& stream_id)
+MediaStream& RecordingSession::AddStream(std::string_view stream_id)
 {
     media_streams_.emplace_back(stream_id);
+    IndexAppended(media_streams_);
     return media_streams_.back();
 }
 
@@ -694,30 +918,30 @@ void RecordingSession::AddAssociation(CommunicationSessionGroup& group, Communic
 
 CSRSAssociation& RecordingSession::AddAssociation(CommunicationSession& comm_session)
 {
-    CSRSAssociation csrs_association;
+    auto& csrs_association = csrs_associations_.emplace_back();
     csrs_association.SetSession(comm_session);
-    csrs_associations_.emplace_back(csrs_association);
-    return csrs_associations_.back();
+    IndexAppended(csrs_associations_);
+    return csrs_association;
 }
 
 ParticipantSessionAssociation& RecordingSession::AddAssociation(const CommunicationSession& session,
                                                                 const Participant& participant)
 {
-    ParticipantSessionAssociation participant_session_association;
+    auto& participant_session_association = participant_session_associations_.emplace_back();
     participant_session_association.SetParticipant(participant.ParticipantId());
     participant_session_association.SetSession(session.SessionId());
-    participant_session_associations_.push_back(participant_session_association);
-    return participant_session_associations_.back();
+    IndexAppended(participant_session_associations_);
+    return participant_session_association;
 }
 
 void RecordingSession::AddAssociation(Participant& participant, const MediaStream& stream, bool send, bool recv)
 {
-    ParticipantStreamAssociation participant_stream_association;
+    auto& participant_stream_association = participant_stream_associations_.emplace_back();
     participant_stream_association.SetParticipant(participant.ParticipantId());
     participant_stream_association.SetStream(stream.StreamId());
     participant_stream_association.SetSend(send);
     participant_stream_association.SetRecv(recv);
-    participant_stream_associations_.emplace_back(participant_stream_association);
+    IndexAppended(participant_stream_associations_);
 }
 
 const std::optional<Timestamp>& RecordingSession::StartTime() const { return start_time_; }
@@ -726,12 +950,18 @@ const std::optional<Timestamp>& RecordingSession::EndTime() const { return end_t
 
 const std::string& RecordingSession::DataMode() const { return data_mode_; }
 
+const std::list<std::pair<std::string, std::string>>& RecordingSession::Attributes() const { return attributes_; }
+
+const RawElements& RecordingSession::Extensions() const { return extensions_; }
+
 const std::list<CommunicationSessionGroup>& RecordingSession::Groups() const { return groups_; }
 
 const std::list<CommunicationSession>& RecordingSession::CommSessions() const { return comm_sessions_; }
 
 const std::list<MediaStream>& RecordingSession::MediaStreams() const { return media_streams_; }
 
+const std::list<Participant>& RecordingSession::Participants() const { return participants_; }
+
 const std::list<CSRSAssociation>& RecordingSession::CS_RS_Associations() const { return csrs_associations_; }
 
 const std::list<ParticipantSessionAssociation>& RecordingSession::ParticipantSessionAssociations() const
@@ -748,7 +978,22 @@ void RecordingSession::SetStartTime(const Timestamp& time) { start_time_ = time;
 
 void RecordingSession::SetEndTime(const Timestamp& time) { end_time_ = time; }
 
-void RecordingSession::SetDataMode(const std::string& mode) { data_mode_ = mode; }
+void RecordingSession::SetDataMode(std::string mode)
+{
+    data_mode_ = std::move(mode);
+    data_mode_set_ = true;
+}
+
+void RecordingSession::AddAttribute(std::string name, std::string value)
+{
+    auto it = std::ranges::find(attributes_, name, [](const auto& attribute) { return attribute.first; });
+    if (it != attributes_.end())
+        it->second = std::move(value);
+    else
+        attributes_.emplace_back(std::move(name), std::move(value));
+}
+
+void RecordingSession::AddExtension(std::string_view element) { extensions_.Append(element); }
 
 bool RecordingSession::operator==(const RecordingSession& other) const
 {
@@ -812,77 +1057,16 @@ bool RecordingSession::operator==(const RecordingSession& other) const
     return true;
 }
 
-std::string RecordingSession::ToXML() const
+bool RecordingSession::FromXML(const std::string& xml_content)
 {
     pugi::xml_document doc;
-
-    // XML declaration
-    auto declaration = doc.append_child(pugi::node_declaration);
-    declaration.append_attribute("version") = "1.0";
-    declaration.append_attribute("encoding") = "UTF-8";
-
-    auto recording_node = doc.append_child("recording");
-    recording_node.append_attribute("xmlns").set_value("urn:ietf:params:xml:ns:recording:1");
-
-    recording_node.append_child("datamode").text().set(data_mode_);
-
-    if (start_time_) {
-        recording_node.append_child("start-time").text().set(start_time_->to_rfc3339());
-    }
-
-    if (end_time_) {
-        recording_node.append_child("end-time").text().set(end_time_->to_rfc3339());
-    }
-
-    for (const auto& group : groups_) {
-        siprec_metadata::ToXML(group, recording_node);
-    }
-
-    for (const auto& session : comm_sessions_) {
-        siprec_metadata::ToXML(session, recording_node);
-    }
-
-    for (const auto& participant : participants_) {
-        siprec_metadata::ToXML(participant, recording_node);
-    }
-
-    for (const auto& stream : media_streams_) {
-        siprec_metadata::ToXML(stream, recording_node);
-    }
-
-    for (const auto& assoc : csrs_associations_) {
-        siprec_metadata::ToXML(assoc, recording_node);
-    }
-
-    for (const auto& assoc : participant_session_associations_) {
-        siprec_metadata::ToXML(assoc, recording_node);
-    }
-
-    for (const auto& participant : participants_) {
-        auto assoc_node = recording_node.append_child("participantstreamassoc");
-        assoc_node.append_attribute("participant_id").set_value(participant.ParticipantId());
-        for (const auto& assoc : participant_stream_associations_) {
-            if (assoc.ParticipantId() == participant.ParticipantId()) {
-                if (assoc.IsSender()) {
-                    assoc_node.append_child("send").text().set(assoc.StreamId());
-                }
-                if (assoc.IsReceiver()) {
-                    assoc_node.append_child("recv").text().set(assoc.StreamId());
-                }
-            }
-        }
-    }
-
-    // Convert to string
-    std::ostringstream oss;
-    doc.save(oss, "  ");
-    return oss.str();
+    return FromXML(doc, xml_content);
 }
 
-bool RecordingSession::FromXML(const std::string& xml_content)
+bool RecordingSession::FromXML(pugi::xml_document& doc, std::string_view xml_content)
 {
-    pugi::xml_document doc;
-    if (!doc.load_string(xml_content.c_str())) {
+    // load_buffer() copies the document, since pugixml decodes escapes within the buffer it parses
+    if (!doc.load_buffer(xml_content.data(), xml_content.size(), pugi::parse_default, pugi::encoding_utf8)) {
         return false;
     }
 
@@ -891,54 +1075,234 @@ bool RecordingSession::FromXML(const std::string& xml_content)
         return false;
     }
 
-    if (auto data_mode_node = recording_node.child("datamode")) {
-        SetDataMode(data_mode_node.text().get());
+    // Everything is parsed into a staging area first and spliced into the session only when the whole document has
+    // been accepted, so a failure never leaves a half-populated session behind.
+    std::optional<std::string> data_mode;
+    std::optional<Timestamp> start_time;
+    std::optional<Timestamp> end_time;
+    RecordingSession staged;
+    std::vector<std::pair<std::string_view, RawElements>> stream_association_extensions;
+
+    for (auto attribute : recording_node.attributes()) {
+        if (std::string_view(attribute.name()) != "xmlns")
+            staged.AddAttribute(attribute.name(), attribute.value());
+    }
+
+    // One pass over the children, each is dispatched by its name
+    using Schema = schema::Schema<RecordingSession>;
+    for (auto child : recording_node.children()) {
+        if (child.type() != pugi::node_element)
+            continue;
+        bool parsed = true;
+        switch (schema::child_matcher<RecordingSession>.Find(child.name())) {
+            case Schema::DataMode:
+                if (not data_mode)
+                    data_mode = child.text().get();
+                break;
+            case Schema::StartTime:
+                if (not start_time)
+                    start_time = Timestamp::from_rfc3339(child.text().get());
+                break;
+            case Schema::EndTime:
+                if (not end_time)
+                    end_time = Timestamp::from_rfc3339(child.text().get());
+                break;
+            case Schema::Group:
+                parsed = siprec_metadata::FromXML(staged.groups_, child, xml_content);
+                break;
+            case Schema::Session:
+                parsed = siprec_metadata::FromXML(staged.comm_sessions_, child, xml_content);
+                break;
+            case Schema::Stream:
+                parsed = siprec_metadata::FromXML(staged.media_streams_, child, xml_content);
+                break;
+            case Schema::Participant:
+                parsed = siprec_metadata::FromXML(staged.participants_, child, xml_content);
+                break;
+            case Schema::SessionRecordingAssoc:
+                parsed = siprec_metadata::FromXML(staged.csrs_associations_, child, xml_content);
+                break;
+            case Schema::ParticipantSessionAssoc:
+                parsed = siprec_metadata::FromXML(staged.participant_session_associations_, child, xml_content);
+                break;
+            case Schema::ParticipantStreamAssoc: {
+                RawElements extensions;
+                parsed = siprec_metadata::FromXML(staged.participant_stream_associations_, child, xml_content,
+                                                  extensions);
+                if (not extensions.empty())
+                    stream_association_extensions.emplace_back(
+                        child.attribute(schema::Schema<ParticipantStreamAssociation>::participant).value(),
+                        std::move(extensions));
+                break;
+            }
+            default:
+                siprec_metadata::AddExtension(staged, child, xml_content);
+                break;
+        }
+        if (not parsed)
+            return false;
     }
 
-    if (auto start_time_node = recording_node.child("start-time")) {
-        SetStartTime(Timestamp::from_rfc3339(start_time_node.text().get()));
+    // Commit
+    if (data_mode)
+        SetDataMode(std::move(data_mode.value()));
+    if (start_time)
+        start_time_ = start_time;
+    if (end_time)
+        end_time_ = end_time;
+    for (auto& [name, value] : staged.attributes_) {
+        AddAttribute(std::move(name), std::move(value));
+    }
+    extensions_.Append(staged.extensions_);
+
+    // Extensions of stream associations stay with their participant, from the document or else from the session
+    for (const auto& [participant_id, extensions] : stream_association_extensions) {
+        auto by_id = [&](const Participant& participant) { return participant.ParticipantId() == participant_id; };
+        auto participant = std::ranges::find_if(staged.participants_, by_id);
+        if (participant == staged.participants_.end()) {
+            participant = std::ranges::find_if(participants_, by_id);
+            if (participant == participants_.end())
+                continue;
+        }
+        for (std::size_t i = 0; i < extensions.size(); ++i) {
+            participant->AddStreamAssociationExtension(extensions[i]);
+        }
     }
+    Splice(staged);
 
-    if (auto end_time_node = recording_node.child("end-time")) {
-        SetEndTime(Timestamp::from_rfc3339(end_time_node.text().get()));
-    }
+    return true;
+}
 
-    for (auto group_node : recording_node.children("group")) {
-        if (not siprec_metadata::FromXML(groups_, group_node))
-            return false;
-    }
+std::vector<std::optional<RecordingSession>> RecordingSession::ParseBatch(
+    std::span<const std::string_view> xml_contents, unsigned threads)
+{
+    // Documents are handed out in small chunks from a shared counter, so a worker that gets short documents simply
+    // takes more chunks. pugixml releases the memory of a document when the next one is loaded, so every document is
+    // parsed into a parser document of its own.
+    constexpr size_t chunk_size = 16;
+
+    std::vector<std::optional<RecordingSession>> results(xml_contents.size());
+    std::atomic<size_t> next_chunk{0};
+    std::mutex failure_mutex;
+    std::exception_ptr failure;
+    auto worker = [&] {
+        try {
+            while (true) {
+                const size_t first = next_chunk.fetch_add(chunk_size, std::memory_order_relaxed);
+                if (first >= xml_contents.size())
+                    break;
+                const size_t last = std::min(first + chunk_size, xml_contents.size());
+                for (size_t i = first; i < last; ++i) {
+                    pugi::xml_document doc;
+                    RecordingSession recording_session;
+                    if (recording_session.FromXML(doc, xml_contents[i]))
+                        results[i].emplace(std::move(recording_session));
+                }
+            }
+        } catch (...) {
+            // The other workers stop at their next chunk and the first failure is rethrown to the caller
+            next_chunk.store(xml_contents.size(), std::memory_order_relaxed);
+            std::lock_guard lock(failure_mutex);
+            if (not failure)
+                failure = std::current_exception();
+        }
+    };
 
-    for (auto session_node : recording_node.children("session")) {
-        if (not siprec_metadata::FromXML(comm_sessions_, session_node))
-            return false;
-    }
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, (xml_contents.size() + chunk_size - 1) / chunk_size));
 
-    for (auto stream_node : recording_node.children("stream")) {
-        if (not siprec_metadata::FromXML(media_streams_, stream_node))
-            return false;
+    {
+        // Threads started before a failure to start another one are joined when the pool goes out of scope
+        std::vector<std::jthread> pool;
+        pool.reserve(threads);
+        for (unsigned i = 1; i < threads; ++i) {
+            pool.emplace_back(worker);
+        }
+        worker();
     }
+    if (failure)
+        std::rethrow_exception(failure);
+    return results;
+}
 
-    for (auto participant_node : recording_node.children("participant")) {
-        if (not siprec_metadata::FromXML(participants_, participant_node))
-            return false;
-    }
+// Ids are interned, so views of them stay valid while elements with the same id are replaced
+using IdPair = std::pair<std::string_view, std::string_view>;
 
-    for (auto assoc_node : recording_node.children("sessionrecordingassoc")) {
-        if (not siprec_metadata::FromXML(csrs_associations_, assoc_node))
-            return false;
+struct MergeKeyHash
+{
+    std::size_t operator()(std::string_view key) const noexcept { return std::hash<std::string_view>{}(key); }
+    std::size_t operator()(const IdPair& key) const noexcept
+    {
+        const auto first = (*this)(key.first);
+        return first ^ ((*this)(key.second) + 0x9e3779b97f4a7c15ull + (first << 6) + (first >> 2));
     }
+};
 
-    for (auto assoc_node : recording_node.children("participantsessionassoc")) {
-        if (not siprec_metadata::FromXML(participant_session_associations_, assoc_node))
-            return false;
+// Replace elements with equal keys or append new ones
+template <typename T, typename Key>
+void MergeElements(std::list<T>& elements, const std::list<T>& delta, Key key)
+{
+    if (delta.empty())
+        return;
+    std::unordered_map<decltype(key(delta.front())), typename std::list<T>::iterator, MergeKeyHash> index;
+    index.reserve(elements.size() + delta.size());
+    for (auto it = elements.begin(); it != elements.end(); ++it) {
+        index.try_emplace(key(*it), it);
+    }
+    for (const auto& element : delta) {
+        auto index_it = index.find(key(element));
+        if (index_it != index.end()) {
+            *index_it->second = element;
+        } else {
+            elements.push_back(element);
+            index.emplace(key(elements.back()), std::prev(elements.end()));
+        }
     }
+}
 
-    for (auto assoc_node : recording_node.children("participantstreamassoc")) {
-        if (not siprec_metadata::FromXML(participant_stream_associations_, assoc_node))
-            return false;
-    }
+void RecordingSession::Merge(const RecordingSession& delta)
+{
+    query_index_.Invalidate();
+    if (delta.data_mode_set_)
+        SetDataMode(delta.data_mode_);
+    if (delta.start_time_)
+        start_time_ = delta.start_time_;
+    if (delta.end_time_)
+        end_time_ = delta.end_time_;
+    if (not delta.extensions_.empty())
+        extensions_ = delta.extensions_;
+    for (const auto& [name, value] : delta.attributes_) {
+        AddAttribute(name, value);
+    }
+
+    MergeElements(groups_, delta.groups_, [](const auto& group) -> std::string_view { return group.GroupId(); });
+    MergeElements(comm_sessions_, delta.comm_sessions_,
+                  [](const auto& session) -> std::string_view { return session.SessionId(); });
+    MergeElements(participants_, delta.participants_,
+                  [](const auto& participant) -> std::string_view { return participant.ParticipantId(); });
+    MergeElements(media_streams_, delta.media_streams_,
+                  [](const auto& stream) -> std::string_view { return stream.StreamId(); });
+    MergeElements(csrs_associations_, delta.csrs_associations_,
+                  [](const auto& assoc) -> std::string_view { return assoc.SessionId(); });
+    MergeElements(participant_session_associations_, delta.participant_session_associations_,
+                  [](const auto& assoc) { return IdPair(assoc.ParticipantId(), assoc.SessionId()); });
+    MergeElements(participant_stream_associations_, delta.participant_stream_associations_,
+                  [](const auto& assoc) { return IdPair(assoc.ParticipantId(), assoc.StreamId()); });
+}
 
-    return true;
+void RecordingSession::Splice(RecordingSession& staged)
+{
+    query_index_.Invalidate();
+    groups_.splice(groups_.end(), staged.groups_);
+    comm_sessions_.splice(comm_sessions_.end(), staged.comm_sessions_);
+    media_streams_.splice(media_streams_.end(), staged.media_streams_);
+    participants_.splice(participants_.end(), staged.participants_);
+    csrs_associations_.splice(csrs_associations_.end(), staged.csrs_associations_);
+    participant_session_associations_.splice(participant_session_associations_.end(),
+                                             staged.participant_session_associations_);
+    participant_stream_associations_.splice(participant_stream_associations_.end(),
+                                            staged.participant_stream_associations_);
 }
 
 bool RecordingSession::Check() const
@@ -981,43 +1345,281 @@ bool RecordingSession::Check() const
     return true;
 }
 
-std::string RecordingSession::ToDOT() const
+std::vector<ValidationIssue> RecordingSession::Validate() const
 {
-    std::string dot;
-    dot += "digraph RecordingSession {\n";
+    using Kind = ValidationIssue::Kind;
+
+    std::vector<ValidationIssue> issues;
+    auto report = [&](Kind kind, std::string_view element, std::string_view id, std::string_view reference) {
+        issues.push_back(ValidationIssue{kind, std::string(element), std::string(id), std::string(reference)});
+    };
+    auto check_interval = [&](std::string_view element, std::string_view id, const std::optional<Timestamp>& associate,
+                              const std::optional<Timestamp>& disassociate) {
+        if (associate and disassociate and (disassociate.value() < associate.value()))
+            report(Kind::DisassociateBeforeAssociate, element, id, {});
+    };
 
+    std::unordered_set<std::string_view> group_ids;
+    group_ids.reserve(groups_.size());
     for (const auto& group : groups_) {
-        dot += std::format("group[{}];\n", group.GroupId());
+        if (not group_ids.insert(group.GroupId()).second)
+            report(Kind::DuplicateId, "group", group.GroupId(), group.GroupId());
+        check_interval("group", group.GroupId(), group.AssociateTime(), group.DisassociateTime());
     }
 
+    std::unordered_set<std::string_view> session_ids;
+    session_ids.reserve(comm_sessions_.size());
     for (const auto& session : comm_sessions_) {
-        dot += std::format("session[{}];\n", session.SessionId());
+        if (not session_ids.insert(session.SessionId()).second)
+            report(Kind::DuplicateId, "session", session.SessionId(), session.SessionId());
     }
 
+    std::unordered_set<std::string_view> participant_ids;
+    participant_ids.reserve(participants_.size());
     for (const auto& participant : participants_) {
-        dot += std::format("part[{}];\n", participant.ParticipantId());
+        if (not participant_ids.insert(participant.ParticipantId()).second)
+            report(Kind::DuplicateId, "participant", participant.ParticipantId(), participant.ParticipantId());
     }
 
+    std::unordered_set<std::string_view> stream_ids;
+    stream_ids.reserve(media_streams_.size());
     for (const auto& stream : media_streams_) {
-        dot += std::format("stream[{}];\n", stream.StreamId());
+        if (not stream_ids.insert(stream.StreamId()).second)
+            report(Kind::DuplicateId, "stream", stream.StreamId(), stream.StreamId());
     }
 
-    dot += "}\n";
-    return dot;
+    for (const auto& session : comm_sessions_) {
+        if (session.GroupRef() and not group_ids.contains(session.GroupRef().value()))
+            report(Kind::MissingGroup, "session", session.SessionId(), session.GroupRef().value());
+    }
+
+    for (const auto& stream : media_streams_) {
+        if (not session_ids.contains(stream.SessionId()))
+            report(Kind::MissingSession, "stream", stream.StreamId(), stream.SessionId());
+    }
+
+    for (const auto& assoc : csrs_associations_) {
+        if (not session_ids.contains(assoc.SessionId()))
+            report(Kind::MissingSession, "sessionrecordingassoc", assoc.SessionId(), assoc.SessionId());
+        check_interval("sessionrecordingassoc", assoc.SessionId(), assoc.AssociateTime(), assoc.DisassociateTime());
+    }
+
+    for (const auto& assoc : participant_session_associations_) {
+        if (not participant_ids.contains(assoc.ParticipantId()))
+            report(Kind::MissingParticipant, "participantsessionassoc", assoc.ParticipantId(), assoc.ParticipantId());
+        if (not session_ids.contains(assoc.SessionId()))
+            report(Kind::MissingSession, "participantsessionassoc", assoc.ParticipantId(), assoc.SessionId());
+        check_interval("participantsessionassoc", assoc.ParticipantId(), assoc.AssociateTime(),
+                       assoc.DisassociateTime());
+    }
+
+    for (const auto& assoc : participant_stream_associations_) {
+        if (not participant_ids.contains(assoc.ParticipantId()))
+            report(Kind::MissingParticipant, "participantstreamassoc", assoc.ParticipantId(), assoc.ParticipantId());
+        if (not stream_ids.contains(assoc.StreamId()))
+            report(Kind::MissingStream, "participantstreamassoc", assoc.ParticipantId(), assoc.StreamId());
+        check_interval("participantstreamassoc", assoc.ParticipantId(), assoc.AssociateTime(),
+                       assoc.DisassociateTime());
+    }
+
+    return issues;
+}
+
+std::shared_ptr<const RecordingSessionSnapshot> RecordingSession::Snapshot() const
+{
+    return snapshot_cache_.Refresh([this](const std::shared_ptr<const RecordingSessionSnapshot>& previous) {
+        auto snapshot = std::make_shared<RecordingSessionSnapshot>();
+        snapshot->start_time_ = start_time_;
+        snapshot->end_time_ = end_time_;
+        snapshot->data_mode_ = data_mode_;
+        snapshot->attributes_ = attributes_;
+        snapshot->extensions_ = extensions_;
+        snapshot->groups_ = ShareElements(groups_, previous ? &previous->groups_ : nullptr);
+        snapshot->comm_sessions_ = ShareElements(comm_sessions_, previous ? &previous->comm_sessions_ : nullptr);
+        snapshot->media_streams_ = ShareElements(media_streams_, previous ? &previous->media_streams_ : nullptr);
+        snapshot->participants_ = ShareElements(participants_, previous ? &previous->participants_ : nullptr);
+        snapshot->csrs_associations_ =
+            ShareElements(csrs_associations_, previous ? &previous->csrs_associations_ : nullptr);
+        snapshot->participant_session_associations_ = ShareElements(
+            participant_session_associations_, previous ? &previous->participant_session_associations_ : nullptr);
+        snapshot->participant_stream_associations_ = ShareElements(
+            participant_stream_associations_, previous ? &previous->participant_stream_associations_ : nullptr);
+        return std::shared_ptr<const RecordingSessionSnapshot>(std::move(snapshot));
+    });
 }
 
-/*
-        node [shape=plaintext]
-        A1 -> B1
-        A2 -> B2
-        A3 -> B3
 
-        A1 -> A2 [label=f]
-        A2 -> A3 [label=g]
-        B2 -> B3 [label="g'"]
-        B1 -> B3 [label="(g o f)'" tailport=s headport=s]
+namespace
+{
+// Graphviz writer, chunks are handed to the flush callback whenever the buffer grows past the threshold
+class DOTWriter
+{
+   private:
+    std::string& out_;
+    std::size_t flush_bytes_;
+    const std::function<bool(std::string_view)>* flush_;
+    bool failed_ = false;
+
+    void Escaped(std::string_view text)
+    {
+        for (const char c : text) {
+            if ((c == '"') or (c == '\\')) {
+                out_.push_back('\\');
+                out_.push_back(c);
+            } else if (c == '\n') {
+                out_.append("\\n");
+            } else {
+                out_.push_back(c);
+            }
+        }
+    }
 
-        { rank=same; A1 A2 A3 }
-        { rank=same; B1 B2 B3 }
+    // Node ids are prefixed with the kind, so that equal ids of different elements do not collide
+    void NodeId(std::string_view kind, std::string_view id)
+    {
+        out_.push_back('"');
+        out_.append(kind);
+        if (not id.empty()) {
+            out_.push_back(':');
+            Escaped(id);
+        }
+        out_.push_back('"');
+    }
+
+   public:
+    DOTWriter(std::string& out, std::size_t flush_bytes, const std::function<bool(std::string_view)>* flush)
+        : out_(out), flush_bytes_(flush_bytes), flush_(flush)
+    {
+    }
+
+    bool Flush()
+    {
+        if (flush_ and not failed_ and not out_.empty()) {
+            failed_ = not (*flush_)(out_);
+            out_.clear();
+        }
+        return not failed_;
+    }
+
+    bool Line()
+    {
+        out_.append(";\n");
+        return (out_.size() < flush_bytes_) or Flush();
+    }
+
+    void Text(std::string_view text) { out_.append(text); }
+
+    // Node with a shape and a two-line label: the kind and a caption
+    bool Node(std::string_view kind, std::string_view id, std::string_view shape, std::string_view caption)
+    {
+        out_.append("  ");
+        NodeId(kind, id);
+        out_.append(" [shape=");
+        out_.append(shape);
+        out_.append(", label=\"");
+        out_.append(kind);
+        out_.append("\\n");
+        Escaped(caption);
+        out_.append("\"]");
+        return Line();
+    }
+
+    bool Edge(std::string_view from_kind, std::string_view from_id, std::string_view to_kind, std::string_view to_id,
+              std::string_view label, bool ended)
+    {
+        out_.append("  ");
+        NodeId(from_kind, from_id);
+        out_.append(" -> ");
+        NodeId(to_kind, to_id);
+        out_.append(" [label=\"");
+        out_.append(label);
+        out_.append(ended ? "\", style=dashed]" : "\"]");
+        return Line();
+    }
+};
+}  // namespace
+
+bool RecordingSession::WriteDOT(std::string& out, std::size_t flush_bytes,
+                                const std::function<bool(std::string_view)>* flush) const
+{
+    DOTWriter writer(out, flush_bytes, flush);
+    writer.Text("digraph RecordingSession {\n  node [fontsize=10];\n  edge [fontsize=9];\n");
+
+    // Nodes
+    if (not writer.Node("recording", "", "doublecircle", data_mode_))
+        return false;
+    for (const auto& group : groups_) {
+        if (not writer.Node("group", group.GroupId(), "folder", group.GroupId()))
+            return false;
+    }
+    for (const auto& session : comm_sessions_) {
+        const auto& caption = session.SipSessionIds().empty() ? session.SessionId() : session.SipSessionIds().front();
+        if (not writer.Node("session", session.SessionId(), "box", caption))
+            return false;
+    }
+    for (const auto& participant : participants_) {
+        const std::string& caption =
+            participant.NameIds().empty() ? participant.ParticipantId() : participant.NameIds().front().second.str();
+        if (not writer.Node("participant", participant.ParticipantId(), "ellipse", caption))
+            return false;
+    }
+    for (const auto& stream : media_streams_) {
+        const auto& caption = stream.Label().empty() ? stream.StreamId() : stream.Label();
+        if (not writer.Node("stream", stream.StreamId(), "note", caption))
+            return false;
+    }
+
+    // Edges, ended associations are dashed
+    for (const auto& session : comm_sessions_) {
+        if (session.GroupRef()
+            and not writer.Edge("group", session.GroupRef().value(), "session", session.SessionId(), "group", false))
+            return false;
+    }
+    for (const auto& stream : media_streams_) {
+        if (not stream.SessionId().empty()
+            and not writer.Edge("session", stream.SessionId(), "stream", stream.StreamId(), "stream", false))
+            return false;
+    }
+    for (const auto& assoc : csrs_associations_) {
+        if (not writer.Edge("recording", "", "session", assoc.SessionId(), "recorded",
+                            assoc.DisassociateTime().has_value()))
+            return false;
+    }
+    for (const auto& assoc : participant_session_associations_) {
+        if (not writer.Edge("participant", assoc.ParticipantId(), "session", assoc.SessionId(), "participant",
+                            assoc.DisassociateTime().has_value()))
+            return false;
+    }
+    for (const auto& assoc : participant_stream_associations_) {
+        const bool ended = assoc.DisassociateTime().has_value();
+        if (assoc.IsSender()
+            and not writer.Edge("participant", assoc.ParticipantId(), "stream", assoc.StreamId(), "send", ended))
+            return false;
+        if (assoc.IsReceiver()
+            and not writer.Edge("stream", assoc.StreamId(), "participant", assoc.ParticipantId(), "recv", ended))
+            return false;
+    }
+
+    writer.Text("}\n");
+    return writer.Flush();
+}
+
+std::string RecordingSession::ToDOT() const
+{
+    // About a hundred bytes per node and edge line with base64 ids
+    const std::size_t lines = 1 + groups_.size() + 2 * comm_sessions_.size() + participants_.size()
+                              + 2 * media_streams_.size() + csrs_associations_.size()
+                              + participant_session_associations_.size() + 2 * participant_stream_associations_.size();
+    std::string dot;
+    dot.reserve(128 + 100 * lines);
+    WriteDOT(dot, std::numeric_limits<std::size_t>::max(), nullptr);
+    return dot;
+}
+
+bool RecordingSession::ToDOT(const std::function<bool(std::string_view)>& sink) const
+{
+    std::string chunk;
+    constexpr std::size_t chunk_bytes = 64 * 1024;
+    chunk.reserve(chunk_bytes + 1024);
+    return WriteDOT(chunk, chunk_bytes, &sink);
 }
-*/
\ No newline at end of file
@@ -1,9 +1,20 @@
 // siprec_metadata.h
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 /**
  * @brief Session Initiation Protocol (SIP) Recording Metadata
@@ -11,6 +22,11 @@
  * https://datatracker.ietf.org/doc/rfc7865/
  *
  */
+namespace pugi
+{
+class xml_document;
+}
+
 namespace siprec_metadata
 {
 
@@ -27,78 +43,375 @@ class Timestamp
     Timestamp() = default;
     explicit Timestamp(std::chrono::system_clock::time_point tp) : time_(tp) {}
 
+    std::chrono::system_clock::time_point time_point() const { return time_; }
+
     bool operator==(const Timestamp &other) const;
+    bool operator<(const Timestamp &other) const;
 
     std::string to_rfc3339() const;
 
-    static Timestamp from_rfc3339(const std::string &rfc3339);
+    /** @brief Longest text written by to_rfc3339(char *), with a signed year of up to six digits */
+    static constexpr std::size_t rfc3339_max_size = 24;
+
+    /**
+     * @brief Write the RFC3339 text into a buffer of rfc3339_max_size characters, without allocating
+     * @return number of characters written, the text is not terminated
+     */
+    std::size_t to_rfc3339(char *buffer) const;
+
+    static Timestamp from_rfc3339(std::string_view rfc3339);
 
     static Timestamp now();
 };
 
+namespace detail
+{
+struct InternEntry
+{
+    std::string value;
+    std::size_t hash;
+    std::atomic<std::uint32_t> references;
+};
+
+inline const std::string empty_string;
+}  // namespace detail
+
+/**
+ * @brief Immutable string stored once per process and shared by every handle with the same content
+ *
+ * Ids, AoRs, labels and content types recur across the elements of a session and across sessions. Handles to equal
+ * strings point to the same entry, so they compare as pointers. An entry is freed with its last handle.
+ */
+class InternedString
+{
+   private:
+    detail::InternEntry *entry_ = nullptr;
+
+   public:
+    InternedString() = default;
+    InternedString(std::string_view value);
+    InternedString(const std::string &value) : InternedString(std::string_view(value)) {}
+    InternedString(const char *value) : InternedString(std::string_view(value)) {}
+    InternedString(const InternedString &other);
+    InternedString(InternedString &&other) noexcept : entry_(std::exchange(other.entry_, nullptr)) {}
+    ~InternedString();
+
+    InternedString &operator=(InternedString other) noexcept
+    {
+        std::swap(entry_, other.entry_);
+        return *this;
+    }
+
+    const std::string &str() const { return entry_ ? entry_->value : detail::empty_string; }
+    operator const std::string &() const { return str(); }
+    operator std::string_view() const { return str(); }
+    bool empty() const { return entry_ == nullptr; }
+
+    bool operator==(const InternedString &other) const { return entry_ == other.entry_; }
+    bool operator==(const std::string &other) const { return str() == other; }
+    bool operator==(std::string_view other) const { return str() == other; }
+    bool operator==(const char *other) const { return str() == other; }
+
+    /**
+     * @brief Number of distinct strings held by the process
+     */
+    static std::size_t PoolSize();
+};
+
+class RecordingSession;
+class RecordingSessionSnapshot;
+class Participant;
+class MediaStream;
+class CommunicationSession;
+
+namespace detail
+{
+std::uint64_t NextRevision();
+
+struct QueryIndex;
+
+/**
+ * @brief Link from an element to the query indexes of its recording session
+ *
+ * Copies start unlinked, elements are linked when they are indexed. A change of an indexed key is made in the
+ * indexes in place while they are up to date where that is cheap, otherwise it marks them for a rebuild.
+ */
+class IndexLink
+{
+   private:
+    mutable QueryIndex *index_ = nullptr;
+
+   public:
+    IndexLink() = default;
+    IndexLink(const IndexLink &) {}
+    IndexLink &operator=(const IndexLink &) { return *this; }
+
+    void Link(QueryIndex *index) const { index_ = index; }
+
+    void Invalidate() const;
+    void NameIdAdded(const Participant &participant, std::string_view name, std::string_view aor) const;
+    void SipSessionIdAdded(const CommunicationSession &session, std::string_view sip_session_id) const;
+    void SessionChanged(const MediaStream &stream, std::string_view previous_session_id) const;
+};
+
+/**
+ * @brief Revision stamp of a metadata element
+ *
+ * A process-wide unique revision is taken on construction and on every modification, and copies keep it, so two
+ * elements with equal revisions always have equal content.
+ */
+class Revisioned
+{
+   private:
+    friend struct QueryIndex;
+
+    std::uint64_t revision_ = NextRevision();
+    IndexLink index_link_;
+
+   public:
+    std::uint64_t Revision() const { return revision_; }
+
+   protected:
+    void Modified() { revision_ = NextRevision(); }
+
+    // Setters of indexed keys tell the indexes about the change
+    const IndexLink &Indexes() const { return index_link_; }
+};
+
+/**
+ * @brief Last snapshot taken from a recording session, reused by the next one
+ *
+ * Copies start empty, so the cache never makes a recording session non-copyable.
+ */
+class SnapshotCache
+{
+   private:
+    mutable std::mutex mutex_;
+    std::shared_ptr<const RecordingSessionSnapshot> snapshot_;
+
+   public:
+    SnapshotCache() = default;
+    SnapshotCache(const SnapshotCache &) {}
+    SnapshotCache &operator=(const SnapshotCache &) { return *this; }
+
+    template <typename Update>
+    std::shared_ptr<const RecordingSessionSnapshot> Refresh(Update update)
+    {
+        std::lock_guard lock(mutex_);
+        snapshot_ = update(snapshot_);
+        return snapshot_;
+    }
+};
+
+/**
+ * @brief Query indexes of a recording session, created on first use
+ *
+ * Copies start with indexes of their own, so elements are never linked to the indexes of another session.
+ */
+class QueryIndexHandle
+{
+   private:
+    mutable std::atomic<QueryIndex *> index_ = nullptr;
+
+   public:
+    QueryIndexHandle() = default;
+    ~QueryIndexHandle();
+    QueryIndexHandle(const QueryIndexHandle &) {}
+    QueryIndexHandle &operator=(const QueryIndexHandle &);
+    QueryIndexHandle(QueryIndexHandle &&other) noexcept;
+    QueryIndexHandle &operator=(QueryIndexHandle &&other) noexcept;
+
+    QueryIndex &Get() const;
+    QueryIndex *UpToDate() const;  // nullptr if there are no indexes or they need a rebuild
+    void Invalidate();
+};
+}  // namespace detail
+
+/**
+ * @brief Elements found by a query of RecordingSession, valid until the session is modified
+ *
+ */
+template <typename T>
+class EntityRange
+{
+   private:
+    std::span<const T *const> elements_;
+
+   public:
+    class Iterator
+    {
+       private:
+        const T *const *element_ = nullptr;
+
+       public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        explicit Iterator(const T *const *element) : element_(element) {}
+
+        const T &operator*() const { return **element_; }
+        const T *operator->() const { return *element_; }
+
+        Iterator &operator++()
+        {
+            ++element_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++element_;
+            return previous;
+        }
+
+        bool operator==(const Iterator &other) const = default;
+    };
+
+    EntityRange() = default;
+    explicit EntityRange(std::span<const T *const> elements) : elements_(elements) {}
+
+    Iterator begin() const { return Iterator(elements_.data()); }
+    Iterator end() const { return Iterator(elements_.data() + elements_.size()); }
+    std::size_t size() const { return elements_.size(); }
+    bool empty() const { return elements_.empty(); }
+    const T &front() const { return *elements_.front(); }
+    const T &operator[](std::size_t index) const { return *elements_[index]; }
+};
+
+/**
+ * @brief Child elements outside the model, such as extensiondata, kept as the bytes of the document
+ *
+ * The elements are neither parsed nor modelled. They are stored back to back in one buffer and written out again
+ * unchanged, so extensions of other vendors pass through intact.
+ */
+class RawElements
+{
+   private:
+    std::string bytes_;
+    std::vector<std::size_t> ends_;  // end of every element in bytes_
+
+   public:
+    bool operator==(const RawElements &other) const = default;
+
+    bool empty() const { return ends_.empty(); }
+    std::size_t size() const { return ends_.size(); }
+
+    std::string_view operator[](std::size_t index) const
+    {
+        const std::size_t begin = (index == 0) ? 0 : ends_[index - 1];
+        return std::string_view(bytes_).substr(begin, ends_[index] - begin);
+    }
+
+    /**
+     * @brief Append a well-formed element, it is not checked
+     */
+    void Append(std::string_view element)
+    {
+        bytes_.append(element);
+        ends_.push_back(bytes_.size());
+    }
+
+    void Append(const RawElements &other)
+    {
+        for (std::size_t i = 0; i < other.size(); ++i) {
+            Append(other[i]);
+        }
+    }
+};
+
 /**
  * @brief Participant
  *
  */
-class Participant
+class Participant : public detail::Revisioned
 {
    private:
-    std::string participant_id_;
-    std::list<std::pair<std::string, std::string>> name_id_;  // (Name, AoR)
+    InternedString participant_id_;
+    std::list<std::pair<InternedString, InternedString>> name_id_;  // (Name, AoR)
+    RawElements extensions_;
+    RawElements stream_association_extensions_;
 
    public:
     Participant();
-    explicit Participant(const std::string &id);
+    explicit Participant(std::string_view id);
 
     bool operator==(const Participant &other) const;
 
     const std::string &ParticipantId() const { return participant_id_; }
     const auto &NameIds() const { return name_id_; }
-
-    void AddNameId(const std::string &name, const std::string &aor) { name_id_.emplace_back(name, aor); }
+    const RawElements &Extensions() const { return extensions_; }
+
+    /**
+     * @brief Child elements of the participantstreamassoc element of the participant outside the model
+     */
+    const RawElements &StreamAssociationExtensions() const { return stream_association_extensions_; }
+
+    void AddNameId(std::string_view name, std::string_view aor)
+    {
+        name_id_.emplace_back(name, aor);
+        Modified();
+        Indexes().NameIdAdded(*this, name, aor);
+    }
+
+    void AddExtension(std::string_view element)
+    {
+        extensions_.Append(element);
+        Modified();
+    }
+
+    void AddStreamAssociationExtension(std::string_view element)
+    {
+        stream_association_extensions_.Append(element);
+        Modified();
+    }
 };
 
 /**
  * @brief Media stream
  *
  */
-class MediaStream
+class MediaStream : public detail::Revisioned
 {
    private:
-    std::string stream_id_;
-    std::string label_;
-    std::optional<std::string> content_type_;
-    std::string session_id_;
+    InternedString stream_id_;
+    InternedString label_;
+    std::optional<InternedString> content_type_;
+    InternedString session_id_;
+    RawElements extensions_;
 
    public:
     MediaStream();
-    MediaStream(const std::string &stream_id);
+    MediaStream(std::string_view stream_id);
 
     bool operator==(const MediaStream &other) const;
 
     const std::string &StreamId() const;
     const std::string &Label() const;
-    const std::optional<std::string> &ContentType() const;
+    const std::optional<InternedString> &ContentType() const;
     const std::string &SessionId() const;
+    const RawElements &Extensions() const;
 
-    void SetSessionId(const std::string &session_id);
-    void SetLabel(const std::string &label);
-    void SetContentType(const std::string &content_type);
+    void SetSessionId(std::string_view session_id);
+    void SetLabel(std::string_view label);
+    void SetContentType(std::string_view content_type);
+    void AddExtension(std::string_view element);
 };
 
 /**
  * @brief Participant stream association
  *
  */
-class ParticipantStreamAssociation
+class ParticipantStreamAssociation : public detail::Revisioned
 {
    private:
     Timestamp associate_time_;
     std::optional<Timestamp> disassociate_time_;
     bool send_ = false;
     bool recv_ = false;
-    std::string participant_id_;
-    std::string stream_id_;
+    InternedString participant_id_;
+    InternedString stream_id_;
 
    public:
     ParticipantStreamAssociation() = default;
@@ -106,34 +419,35 @@ class ParticipantStreamAssociation
     bool operator==(const ParticipantStreamAssociation &other) const;
 
     const Timestamp &AssociateTime() const;
-    const auto &DisassociateTime() const;
+    const std::optional<Timestamp> &DisassociateTime() const;
     bool IsSender() const;
     bool IsReceiver() const;
     const std::string &ParticipantId() const;
     const std::string &StreamId() const;
 
-    void SetParticipant(const std::string &participant_id);
-    void SetStream(const std::string &stream_id);
+    void SetParticipant(std::string_view participant_id);
+    void SetStream(std::string_view stream_id);
     void SetSend(bool send);
     void SetRecv(bool recv);
     void SetAssociateTime(const Timestamp &time);
-    void SetAssociateTime(const std::string &time_rfc3339);
+    void SetAssociateTime(std::string_view time_rfc3339);
     void SetDisassociateTime(const Timestamp &time);
-    void SetDisassociateTime(const std::string &time_rfc3339);
+    void SetDisassociateTime(std::string_view time_rfc3339);
 };
 
 /**
  * @brief ParticipantSessionAssociation
  *
  */
-class ParticipantSessionAssociation
+class ParticipantSessionAssociation : public detail::Revisioned
 {
    private:
     Timestamp associate_time_;
     std::optional<Timestamp> disassociate_time_;
     std::list<std::string> params_;
-    std::string participant_id_;
-    std::string session_id_;
+    InternedString participant_id_;
+    InternedString session_id_;
+    RawElements extensions_;
 
    public:
     ParticipantSessionAssociation() = default;
@@ -145,87 +459,96 @@ class ParticipantSessionAssociation
     const std::list<std::string> &Params() const;
     const std::string &ParticipantId() const;
     const std::string &SessionId() const;
+    const RawElements &Extensions() const;
 
-    void SetParticipant(const std::string &participant_id);
-    void SetSession(const std::string &session_id);
-    void AddParam(const std::string &param);
+    void SetParticipant(std::string_view participant_id);
+    void SetSession(std::string_view session_id);
+    void AddParam(std::string param);
+    void AddExtension(std::string_view element);
     void SetAssociateTime(const Timestamp &time);
-    void SetAssociateTime(const std::string &time_rfc3339);
+    void SetAssociateTime(std::string_view time_rfc3339);
     void SetDisassociateTime(const Timestamp &time);
-    void SetDisassociateTime(const std::string &time_rfc3339);
+    void SetDisassociateTime(std::string_view time_rfc3339);
 };
 
 /**
  * @brief Communication Session
  *
  */
-class CommunicationSession
+class CommunicationSession : public detail::Revisioned
 {
    private:
-    std::string session_id_;
+    InternedString session_id_;
     std::optional<std::string> reason_;
     std::list<std::string> sip_session_ids_;
-    std::optional<std::string> group_ref_;
+    std::optional<InternedString> group_ref_;
     std::optional<Timestamp> start_time_;
     std::optional<Timestamp> stop_time_;
+    RawElements extensions_;
 
    public:
     CommunicationSession();
-    explicit CommunicationSession(const std::string &id);
+    explicit CommunicationSession(std::string_view id);
 
     bool operator==(const CommunicationSession &other) const;
 
     const std::string &SessionId() const;
     const std::optional<std::string> &Reason() const;
     const std::list<std::string> &SipSessionIds() const;
-    const std::optional<std::string> &GroupRef() const;
+    const std::optional<InternedString> &GroupRef() const;
     const std::optional<Timestamp> &StartTime() const;
     const std::optional<Timestamp> &StopTime() const;
+    const RawElements &Extensions() const;
 
-    void SetReason(const std::string &reason);
-    void AddSipSessionId(const std::string &session_id);
-    void SetGroupRef(const std::string &group_ref);
+    void SetReason(std::string reason);
+    void AddSipSessionId(std::string session_id);
+    void SetGroupRef(std::string_view group_ref);
     void SetStartTime(const Timestamp &time);
     void SetStopTime(const Timestamp &time);
+    void AddExtension(std::string_view element);
 };
 
 /**
  * @brief Communication sessions group
  *
  */
-class CommunicationSessionGroup
+class CommunicationSessionGroup : public detail::Revisioned
 {
    private:
-    std::string group_id_;
+    InternedString group_id_;
     std::optional<Timestamp> associate_time_;
     std::optional<Timestamp> disassociate_time_;
+    RawElements extensions_;
 
    public:
     CommunicationSessionGroup();
-    explicit CommunicationSessionGroup(const std::string &id);
+    explicit CommunicationSessionGroup(std::string_view id);
 
     bool operator==(const CommunicationSessionGroup &other) const;
 
     const std::string &GroupId() const;
     const std::optional<Timestamp> &AssociateTime() const;
     const std::optional<Timestamp> &DisassociateTime() const;
+    const RawElements &Extensions() const;
 
     void SetAssociateTime(const Timestamp &time);
-    void SetAssociateTime(const std::string &time_rfc3339);
+    void SetAssociateTime(std::string_view time_rfc3339);
     void SetDisassociateTime(const Timestamp &time);
-    void SetDisassociateTime(const std::string &time_rfc3339);
+    void SetDisassociateTime(std::string_view time_rfc3339);
+    void AddExtension(std::string_view element);
 };
 
 /**
  * @brief Assosiation Communication Session - Recording Session
  *
  */
-class CSRSAssociation
+class CSRSAssociation : public detail::Revisioned
 {
    private:
     Timestamp associate_time_;
     std::optional<Timestamp> disassociate_time_;
-    std::string session_id_;
+    InternedString session_id_;
+    RawElements extensions_;
 
    public:
     CSRSAssociation() = default;
@@ -235,13 +558,54 @@ class CSRSAssociation
     const Timestamp &AssociateTime() const;
     const std::optional<Timestamp> &DisassociateTime() const;
     const std::string &SessionId() const;
+    const RawElements &Extensions() const;
 
     void SetSession(const CommunicationSession &session);
-    void SetSession(const std::string &session_id);
-    void SetAssociateTime(const std::string &time_rfc3339);
+    void SetSession(std::string_view session_id);
+    void SetAssociateTime(std::string_view time_rfc3339);
     void SetAssociateTime(const Timestamp &timestamp);
-    void SetDisassociateTime(const std::string &time_rfc3339);
+    void SetDisassociateTime(std::string_view time_rfc3339);
     void SetDisassociateTime(const Timestamp &timestamp);
+    void AddExtension(std::string_view element);
+};
+
+/**
+ * @brief Problem found by RecordingSession::Validate()
+ *
+ */
+struct ValidationIssue
+{
+    enum class Kind
+    {
+        DuplicateId,                  // id is used by more than one element of the same kind
+        MissingGroup,                 // reference to a group which is not in the session
+        MissingSession,               // reference to a communication session which is not in the session
+        MissingParticipant,           // reference to a participant which is not in the session
+        MissingStream,                // reference to a stream which is not in the session
+        DisassociateBeforeAssociate,  // disassociate-time is earlier than associate-time
+    };
+
+    Kind kind;
+    std::string element;    // XML element name of the offending element
+    std::string id;         // id of the offending element (participant_id for participant associations)
+    std::string reference;  // dangling or duplicated id, empty for time issues
+
+    bool operator==(const ValidationIssue &other) const = default;
+};
+
+/**
+ * @brief Number of elements of each kind in a recording session that the query indexes are sized for
+ *
+ * Groups are not indexed, so they are not counted.
+ */
+struct ElementCounts
+{
+    std::size_t comm_sessions = 0;
+    std::size_t participants = 0;
+    std::size_t media_streams = 0;
+    std::size_t csrs_associations = 0;
+    std::size_t participant_session_associations = 0;
+    std::size_t participant_stream_associations = 0;
 };
 
 /**
@@ -254,6 +618,9 @@ class RecordingSession
     std::optional<Timestamp> start_time_;
     std::optional<Timestamp> end_time_;
     std::string data_mode_ = "complete";
+    bool data_mode_set_ = false;  // set by SetDataMode() or read from a document, so Merge() takes it over
+    std::list<std::pair<std::string, std::string>> attributes_;
+    RawElements extensions_;
 
     std::list<CommunicationSessionGroup> groups_;
     std::list<CommunicationSession> comm_sessions_;
@@ -263,32 +630,74 @@ class RecordingSession
     std::list<ParticipantSessionAssociation> participant_session_associations_;
     std::list<ParticipantStreamAssociation> participant_stream_associations_;
 
+    mutable detail::SnapshotCache snapshot_cache_;
+    detail::QueryIndexHandle query_index_;
+
+    detail::QueryIndex &Index() const;
+    // Index the last element of the list in place if the indexes are up to date
+    template <typename T>
+    void IndexAppended(const std::list<T> &elements);
+    void Splice(RecordingSession &staged);
+    bool FromXML(pugi::xml_document &doc, std::string_view xml_content);
+    bool WriteDOT(std::string &out, std::size_t flush_bytes, const std::function<bool(std::string_view)> *flush) const;
+
    public:
     bool operator==(const RecordingSession &other) const;
 
     bool Check() const;
 
+    /**
+     * @brief Find every dangling reference, duplicate id and inverted association interval in one pass
+     */
+    std::vector<ValidationIssue> Validate() const;
+
     const std::optional<Timestamp> &StartTime() const;
     const std::optional<Timestamp> &EndTime() const;
     const std::string &DataMode() const;
+
+    /**
+     * @brief Attributes of the recording element besides its default namespace, such as the namespace declarations
+     * the extensions use, as (name, value) pairs
+     */
+    const std::list<std::pair<std::string, std::string>> &Attributes() const;
+
+    /**
+     * @brief Child elements of the recording element outside the model
+     */
+    const RawElements &Extensions() const;
     const std::list<CommunicationSessionGroup> &Groups() const;
     const std::list<CommunicationSession> &CommSessions() const;
     const std::list<MediaStream> &MediaStreams() const;
+    const std::list<Participant> &Participants() const;
     const std::list<CSRSAssociation> &CS_RS_Associations() const;
     const std::list<ParticipantSessionAssociation> &ParticipantSessionAssociations() const;
     const std::list<ParticipantStreamAssociation> &ParticipantStreamAssociations() const;
 
     void SetStartTime(const Timestamp &time);
     void SetEndTime(const Timestamp &time);
-    void SetDataMode(const std::string &mode);
+    void SetDataMode(std::string mode);
+
+    /**
+     * @brief Add an attribute to the recording element or replace the value of the attribute with the name
+     */
+    void AddAttribute(std::string name, std::string value);
+    void AddExtension(std::string_view element);
+
+    CommunicationSessionGroup &AddGroup(std::string_view group_id = "");
 
-    CommunicationSessionGroup &AddGroup(const std::string &group_id = "");
+    CommunicationSession &AddCommSession(std::string_view session_id = "");
 
-    CommunicationSession &AddCommSession(const std::string &session_id = "");
+    Participant &AddParticipant(std::string_view participant_id = "");
 
-    Participant &AddParticipant(const std::string &participant_id = "");
+    MediaStream &AddStream(std::string_view stream_id = "");
 
-    MediaStream &AddStream(const std::string &stream_id = "");
+    /**
+     * @brief Size the query indexes for the number of elements the session is going to hold
+     *
+     * Elements are kept in lists, so references to them stay valid and there is nothing to reserve for them. The
+     * indexes keep their size when they are rebuilt, so a session growing up to the counts never rehashes them.
+     */
+    void Reserve(const ElementCounts &counts);
 
     void AddAssociation(CommunicationSession &session, MediaStream &stream);
 
@@ -300,11 +709,224 @@ class RecordingSession
 
     void AddAssociation(Participant &participant, const MediaStream &stream, bool send, bool recv);
 
+    /**
+     * @brief Element with the id, nullptr if there is none
+     *
+     * Lookups and queries are answered from indexes which are rebuilt on the first query after a modification.
+     */
+    const Participant *FindParticipant(std::string_view participant_id) const;
+    const MediaStream *FindStream(std::string_view stream_id) const;
+    const CommunicationSession *FindCommSession(std::string_view session_id) const;
+
+    /**
+     * @brief Participants with a nameID of the AoR or name
+     */
+    EntityRange<Participant> ParticipantsByAoR(std::string_view aor) const;
+    EntityRange<Participant> ParticipantsByName(std::string_view name) const;
+
+    /**
+     * @brief Streams a participant sends or receives, ended associations included
+     */
+    EntityRange<MediaStream> StreamsSentBy(std::string_view participant_id) const;
+    EntityRange<MediaStream> StreamsReceivedBy(std::string_view participant_id) const;
+
+    /**
+     * @brief Participants associated with a communication session, ended associations included
+     */
+    EntityRange<Participant> SessionParticipants(std::string_view session_id) const;
+
+    /**
+     * @brief Streams with the session_id of a communication session
+     */
+    EntityRange<MediaStream> SessionStreams(std::string_view session_id) const;
+
+    /**
+     * @brief Communication sessions with the sipSessionID
+     */
+    EntityRange<CommunicationSession> SessionsBySipSessionId(std::string_view sip_session_id) const;
+
+    /**
+     * @brief Remove an element together with the associations that reference it, false if there is none
+     *
+     * A communication session is removed with its streams. The indexes are updated in place, the cost depends on the
+     * number of associations of the element and not on the size of the session. Queries list their elements in
+     * document order only until the first removal. Associations of an element with an id shared by another one stay
+     * with the next element of that id.
+     */
+    bool RemoveParticipant(std::string_view participant_id);
+    bool RemoveStream(std::string_view stream_id);
+    bool RemoveCommSession(std::string_view session_id);
+
+    /**
+     * @brief Remove the associations between two elements, false if there are none
+     */
+    bool RemoveParticipantSessionAssociation(std::string_view participant_id, std::string_view session_id);
+    bool RemoveParticipantStreamAssociation(std::string_view participant_id, std::string_view stream_id);
+
+    /**
+     * @brief Record the disassociate-time on the open associations of an element instead of removing it
+     *
+     * A communication session ends its association with the recording, its participants and the associations of its
+     * streams. Returns false if there was no open association.
+     */
+    bool DisassociateParticipant(std::string_view participant_id, const Timestamp &time);
+    bool DisassociateStream(std::string_view stream_id, const Timestamp &time);
+    bool DisassociateCommSession(std::string_view session_id, const Timestamp &time);
+
+    /**
+     * @brief Apply a partial update
+     *
+     * Every element of the delta replaces the element with the same id (or the association between the same
+     * elements) or is appended if there is none. The data mode, start and end times and the extensions of the
+     * recording are taken from the delta if it has them, and its attributes are added. A delta has a data mode once
+     * it is set or read from a document.
+     */
+    void Merge(const RecordingSession &delta);
+
     std::string ToXML() const;
 
+    /**
+     * @brief Append the XML document to a buffer, reusing its capacity
+     */
+    void AppendXML(std::string &out) const;
+
+    /**
+     * @brief Upper bound of the size of the XML document in bytes, counted without writing it
+     *
+     * The markup is counted from the elements, values from their lengths as if every character was escaped and times
+     * at their longest text. A buffer reserved for it takes AppendXML() without growing.
+     */
+    std::size_t EstimatedXMLSize() const;
+
+    struct XMLRange
+    {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    /**
+     * @brief Append the XML documents of many sessions to one buffer
+     *
+     * Returns the position of every document in the buffer, in input order. With more than one shard, contiguous
+     * groups of sessions are serialized in parallel and appended in order.
+     */
+    static std::vector<XMLRange> ToXMLBatch(std::span<const RecordingSession *const> sessions, std::string &out,
+                                            unsigned shards = 1);
+
+    /**
+     * @brief Parse metadata and append it to the session. The session is left untouched if parsing fails.
+     */
     bool FromXML(const std::string &xml_content);
 
+    /**
+     * @brief Parse many independent metadata documents in parallel
+     *
+     * Results are in input order, std::nullopt for a document that cannot be parsed. Zero threads means one per
+     * hardware thread. The documents are read-only, so each of them is copied into a fresh pugi::xml_document and
+     * parsed there; neither the parser document nor its memory is reused between documents. An exception of a worker,
+     * such as std::bad_alloc, or a failure to start a thread is thrown after every started worker has been joined.
+     */
+    static std::vector<std::optional<RecordingSession>> ParseBatch(std::span<const std::string_view> xml_contents,
+                                                                   unsigned threads = 0);
+
+    /**
+     * @brief JSON document with the same elements as the XML one, written without building a document tree
+     */
+    std::string ToJSON() const;
+    void AppendJSON(std::string &out) const;
+
+    /**
+     * @brief Parse a JSON document and append it to the session. The session is left untouched if parsing fails.
+     */
+    bool FromJSON(std::string_view json);
+
+    /**
+     * @brief Compact versioned binary encoding for storage and replication
+     */
+    std::string ToBinary() const;
+
+    /**
+     * @brief Parse binary encoding and append it to the session. The session is left untouched if parsing fails.
+     */
+    bool FromBinary(std::string_view data);
+
+    /**
+     * @brief Graphviz graph of all elements and associations
+     */
     std::string ToDOT() const;
+
+    /**
+     * @brief Write the graph to a sink in chunks of bounded size, false if the sink fails
+     */
+    bool ToDOT(const std::function<bool(std::string_view)> &sink) const;
+
+    /**
+     * @brief Immutable view of the current state
+     *
+     * Elements not modified since the previous snapshot are shared with it instead of being copied. Only modified
+     * elements are copied, but every element is visited to compare its revision, so the cost grows with the size of
+     * the session.
+     *
+     * The session is read without synchronization, so Snapshot() must be called on the thread that modifies the
+     * session, or while it is not modified. The snapshot it returns may then be handed to and read on any thread.
+     */
+    std::shared_ptr<const RecordingSessionSnapshot> Snapshot() const;
+};
+
+/**
+ * @brief Immutable state of a recording session
+ *
+ * Elements are held by reference count and shared between snapshots of the same session, so a snapshot stays valid
+ * and consistent while the session keeps changing.
+ */
+class RecordingSessionSnapshot
+{
+   public:
+    template <typename T>
+    using Elements = std::vector<std::shared_ptr<const T>>;
+
+   private:
+    friend class RecordingSession;
+
+    std::optional<Timestamp> start_time_;
+    std::optional<Timestamp> end_time_;
+    std::string data_mode_;
+    std::list<std::pair<std::string, std::string>> attributes_;
+    RawElements extensions_;
+
+    Elements<CommunicationSessionGroup> groups_;
+    Elements<CommunicationSession> comm_sessions_;
+    Elements<MediaStream> media_streams_;
+    Elements<Participant> participants_;
+    Elements<CSRSAssociation> csrs_associations_;
+    Elements<ParticipantSessionAssociation> participant_session_associations_;
+    Elements<ParticipantStreamAssociation> participant_stream_associations_;
+
+   public:
+    const std::optional<Timestamp> &StartTime() const { return start_time_; }
+    const std::optional<Timestamp> &EndTime() const { return end_time_; }
+    const std::string &DataMode() const { return data_mode_; }
+    const std::list<std::pair<std::string, std::string>> &Attributes() const { return attributes_; }
+    const RawElements &Extensions() const { return extensions_; }
+    const Elements<CommunicationSessionGroup> &Groups() const { return groups_; }
+    const Elements<CommunicationSession> &CommSessions() const { return comm_sessions_; }
+    const Elements<MediaStream> &MediaStreams() const { return media_streams_; }
+    const Elements<Participant> &Participants() const { return participants_; }
+    const Elements<CSRSAssociation> &CS_RS_Associations() const { return csrs_associations_; }
+    const Elements<ParticipantSessionAssociation> &ParticipantSessionAssociations() const
+    {
+        return participant_session_associations_;
+    }
+    const Elements<ParticipantStreamAssociation> &ParticipantStreamAssociations() const
+    {
+        return participant_stream_associations_;
+    }
+
+    std::string ToXML() const;
+    void AppendXML(std::string &out) const;
+    std::size_t EstimatedXMLSize() const;
+    std::string ToJSON() const;
+    void AppendJSON(std::string &out) const;
 };
 
 }  // namespace siprec_metadata
@@ -0,0 +1,708 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "siprec_metadata.h"
+#include "siprec_metadata_internal.h"
+
+using namespace siprec_metadata;
+
+/*
+ * Binary format, version 3
+ *
+ * All integers are unsigned LEB128 varints, signed ones are zigzag encoded first. Strings are prefixed with their
+ * length. Timestamps are signed nanoseconds since the Unix epoch.
+ *
+ *   magic "SRMB", version
+ *   id table: count, then per id a kind byte followed by the payload
+ *       0 - raw string
+ *       1 - canonical base64 string, stored decoded
+ *       2 - base64 of a lowercase textual UUID (the ids generated by this library), stored as 16 bytes
+ *   data mode, empty if it was never set, optional start time, optional end time, extensions, attributes as a count
+ *   followed by names and values
+ *   groups, sessions, participants, streams, session-recording, participant-session and participant-stream
+ *   associations, each as a count followed by the elements; every id is a reference into the id table
+ *
+ * Optional values are preceded by a presence byte. Extensions are a count followed by the raw elements; every element
+ * but a participant-stream association ends with them, a participant then has the extensions of its stream
+ * associations. Version 2 is the same without attributes and stream association extensions, version 1 is also
+ * without extensions, both are still read.
+ */
+
+namespace
+{
+constexpr std::string_view binary_magic = "SRMB";
+constexpr uint64_t binary_version = 3;
+
+enum IdKind : uint8_t
+{
+    IdRaw = 0,
+    IdBase64 = 1,
+    IdBase64Uuid = 2,
+};
+
+class BinaryWriter
+{
+   private:
+    std::string& out_;
+    std::unordered_map<std::string_view, uint64_t> id_index_;
+
+   public:
+    explicit BinaryWriter(std::string& out) : out_(out) {}
+
+    void PutByte(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+
+    void PutVarint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            PutByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        PutByte(static_cast<uint8_t>(value));
+    }
+
+    void PutBytes(std::string_view bytes)
+    {
+        PutVarint(bytes.size());
+        out_.append(bytes);
+    }
+
+    void PutTime(const Timestamp& time)
+    {
+        const int64_t ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_point().time_since_epoch()).count();
+        PutVarint((static_cast<uint64_t>(ns) << 1) ^ static_cast<uint64_t>(ns >> 63));
+    }
+
+    void PutOptionalTime(const std::optional<Timestamp>& time)
+    {
+        PutByte(time ? 1 : 0);
+        if (time)
+            PutTime(time.value());
+    }
+
+    template <typename Text>
+    void PutOptionalString(const std::optional<Text>& value)
+    {
+        PutByte(value ? 1 : 0);
+        if (value)
+            PutBytes(value.value());
+    }
+
+    void PutExtensions(const RawElements& extensions)
+    {
+        PutVarint(extensions.size());
+        for (size_t i = 0; i < extensions.size(); ++i) {
+            PutBytes(extensions[i]);
+        }
+    }
+
+    void CollectId(std::string_view id) { id_index_.try_emplace(id, id_index_.size()); }
+
+    void PutIdTable()
+    {
+        std::vector<std::string_view> ids(id_index_.size());
+        for (const auto& [id, index] : id_index_) {
+            ids[index] = id;
+        }
+        PutVarint(ids.size());
+        for (const auto id : ids) {
+            PutIdValue(id);
+        }
+    }
+
+    void PutId(std::string_view id) { PutVarint(id_index_.at(id)); }
+
+   private:
+    static bool ParseUuid(std::string_view text, std::array<uint8_t, 16>& uuid)
+    {
+        if (text.size() != 36)
+            return false;
+        size_t pos = 0;
+        for (size_t i = 0; i < uuid.size(); ++i) {
+            if ((pos == 8) or (pos == 13) or (pos == 18) or (pos == 23)) {
+                if (text[pos] != '-')
+                    return false;
+                ++pos;
+            }
+            auto nibble = [](char c) -> int {
+                if ((c >= '0') and (c <= '9'))
+                    return c - '0';
+                if ((c >= 'a') and (c <= 'f'))
+                    return c - 'a' + 10;
+                return -1;
+            };
+            const int high = nibble(text[pos]);
+            const int low = nibble(text[pos + 1]);
+            if ((high < 0) or (low < 0))
+                return false;
+            uuid[i] = static_cast<uint8_t>((high << 4) | low);
+            pos += 2;
+        }
+        return true;
+    }
+
+    void PutIdValue(std::string_view id)
+    {
+        auto decoded = base64_decode(id);
+        if (decoded and not decoded->empty()) {
+            std::array<uint8_t, 16> uuid;
+            if (ParseUuid(decoded.value(), uuid)) {
+                PutByte(IdBase64Uuid);
+                out_.append(reinterpret_cast<const char*>(uuid.data()), uuid.size());
+            } else {
+                PutByte(IdBase64);
+                PutBytes(decoded.value());
+            }
+            return;
+        }
+        PutByte(IdRaw);
+        PutBytes(id);
+    }
+};
+
+class BinaryReader
+{
+   private:
+    std::string_view in_;
+    size_t pos_ = 0;
+    uint64_t version_ = 0;
+    std::vector<std::string> ids_;
+
+   public:
+    explicit BinaryReader(std::string_view in) : in_(in) {}
+
+    bool GetVersion()
+    {
+        return GetVarint(version_) and (version_ >= 1) and (version_ <= binary_version);
+    }
+
+    bool AtEnd() const { return pos_ == in_.size(); }
+
+    bool GetByte(uint8_t& value)
+    {
+        if (pos_ >= in_.size())
+            return false;
+        value = static_cast<uint8_t>(in_[pos_++]);
+        return true;
+    }
+
+    bool GetVarint(uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (not GetByte(byte))
+                return false;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool GetCount(size_t& count)
+    {
+        uint64_t value;
+        // Every element takes at least one byte, which bounds counts of corrupted input
+        if (not GetVarint(value) or (value > in_.size() - pos_))
+            return false;
+        count = static_cast<size_t>(value);
+        return true;
+    }
+
+    bool GetBytes(std::string_view& bytes)
+    {
+        size_t size;
+        if (not GetCount(size))
+            return false;
+        bytes = in_.substr(pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool GetString(std::string& value)
+    {
+        std::string_view bytes;
+        if (not GetBytes(bytes))
+            return false;
+        value.assign(bytes);
+        return true;
+    }
+
+    bool GetBool(bool& value)
+    {
+        uint8_t byte;
+        if (not GetByte(byte) or (byte > 1))
+            return false;
+        value = (byte == 1);
+        return true;
+    }
+
+    bool GetTime(Timestamp& time)
+    {
+        uint64_t zigzag;
+        if (not GetVarint(zigzag))
+            return false;
+        const int64_t ns = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        time = Timestamp(std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns))));
+        return true;
+    }
+
+    bool GetOptionalTime(std::optional<Timestamp>& time)
+    {
+        bool present;
+        if (not GetBool(present))
+            return false;
+        if (not present) {
+            time.reset();
+            return true;
+        }
+        Timestamp value;
+        if (not GetTime(value))
+            return false;
+        time = value;
+        return true;
+    }
+
+    bool GetOptionalString(std::optional<std::string>& value)
+    {
+        bool present;
+        if (not GetBool(present))
+            return false;
+        if (not present) {
+            value.reset();
+            return true;
+        }
+        std::string string;
+        if (not GetString(string))
+            return false;
+        value = std::move(string);
+        return true;
+    }
+
+    bool GetIdTable()
+    {
+        size_t count;
+        if (not GetCount(count))
+            return false;
+        ids_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t kind;
+            if (not GetByte(kind))
+                return false;
+            switch (kind) {
+                case IdRaw: {
+                    std::string id;
+                    if (not GetString(id))
+                        return false;
+                    ids_.push_back(std::move(id));
+                    break;
+                }
+                case IdBase64: {
+                    std::string_view bytes;
+                    if (not GetBytes(bytes))
+                        return false;
+                    ids_.push_back(base64_encode(bytes));
+                    break;
+                }
+                case IdBase64Uuid: {
+                    if (in_.size() - pos_ < 16)
+                        return false;
+                    const auto* uuid = reinterpret_cast<const uint8_t*>(in_.data() + pos_);
+                    pos_ += 16;
+                    constexpr std::string_view hex_digits = "0123456789abcdef";
+                    std::string uuid_str;
+                    uuid_str.reserve(36);
+                    for (size_t j = 0; j < 16; ++j) {
+                        if ((j == 4) or (j == 6) or (j == 8) or (j == 10))
+                            uuid_str.push_back('-');
+                        uuid_str.push_back(hex_digits[uuid[j] >> 4]);
+                        uuid_str.push_back(hex_digits[uuid[j] & 0x0F]);
+                    }
+                    ids_.push_back(base64_encode(uuid_str));
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Raw elements passed to add one by one, encoded since the version
+    template <typename Add>
+    bool GetRawElements(uint64_t since_version, Add add)
+    {
+        if (version_ < since_version)
+            return true;
+        size_t count;
+        if (not GetCount(count))
+            return false;
+        for (size_t i = 0; i < count; ++i) {
+            std::string_view bytes;
+            if (not GetBytes(bytes))
+                return false;
+            add(bytes);
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool GetExtensions(T& element)
+    {
+        return GetRawElements(2, [&](std::string_view bytes) { element.AddExtension(bytes); });
+    }
+
+    bool GetStreamAssociationExtensions(Participant& participant)
+    {
+        return GetRawElements(3, [&](std::string_view bytes) { participant.AddStreamAssociationExtension(bytes); });
+    }
+
+    bool GetAttributes(RecordingSession& session)
+    {
+        if (version_ < 3)
+            return true;
+        size_t count;
+        if (not GetCount(count))
+            return false;
+        for (size_t i = 0; i < count; ++i) {
+            std::string name;
+            std::string value;
+            if (not GetString(name) or not GetString(value))
+                return false;
+            session.AddAttribute(std::move(name), std::move(value));
+        }
+        return true;
+    }
+
+    bool GetId(const std::string*& id)
+    {
+        uint64_t index;
+        if (not GetVarint(index) or (index >= ids_.size()))
+            return false;
+        id = &ids_[index];
+        return true;
+    }
+};
+}  // namespace
+
+std::string RecordingSession::ToBinary() const
+{
+    std::string out;
+    BinaryWriter writer(out);
+
+    for (const auto& group : groups_) {
+        writer.CollectId(group.GroupId());
+    }
+    for (const auto& session : comm_sessions_) {
+        writer.CollectId(session.SessionId());
+        if (session.GroupRef())
+            writer.CollectId(session.GroupRef().value());
+    }
+    for (const auto& participant : participants_) {
+        writer.CollectId(participant.ParticipantId());
+    }
+    for (const auto& stream : media_streams_) {
+        writer.CollectId(stream.StreamId());
+        writer.CollectId(stream.SessionId());
+    }
+    for (const auto& assoc : csrs_associations_) {
+        writer.CollectId(assoc.SessionId());
+    }
+    for (const auto& assoc : participant_session_associations_) {
+        writer.CollectId(assoc.ParticipantId());
+        writer.CollectId(assoc.SessionId());
+    }
+    for (const auto& assoc : participant_stream_associations_) {
+        writer.CollectId(assoc.ParticipantId());
+        writer.CollectId(assoc.StreamId());
+    }
+
+    out.append(binary_magic);
+    writer.PutVarint(binary_version);
+    writer.PutIdTable();
+
+    writer.PutBytes(data_mode_set_ ? std::string_view(data_mode_) : std::string_view());
+    writer.PutOptionalTime(start_time_);
+    writer.PutOptionalTime(end_time_);
+    writer.PutExtensions(extensions_);
+    writer.PutVarint(attributes_.size());
+    for (const auto& [name, value] : attributes_) {
+        writer.PutBytes(name);
+        writer.PutBytes(value);
+    }
+
+    writer.PutVarint(groups_.size());
+    for (const auto& group : groups_) {
+        writer.PutId(group.GroupId());
+        writer.PutOptionalTime(group.AssociateTime());
+        writer.PutOptionalTime(group.DisassociateTime());
+        writer.PutExtensions(group.Extensions());
+    }
+
+    writer.PutVarint(comm_sessions_.size());
+    for (const auto& session : comm_sessions_) {
+        writer.PutId(session.SessionId());
+        writer.PutOptionalString(session.Reason());
+        writer.PutVarint(session.SipSessionIds().size());
+        for (const auto& sip_session_id : session.SipSessionIds()) {
+            writer.PutBytes(sip_session_id);
+        }
+        writer.PutByte(session.GroupRef() ? 1 : 0);
+        if (session.GroupRef())
+            writer.PutId(session.GroupRef().value());
+        writer.PutOptionalTime(session.StartTime());
+        writer.PutOptionalTime(session.StopTime());
+        writer.PutExtensions(session.Extensions());
+    }
+
+    writer.PutVarint(participants_.size());
+    for (const auto& participant : participants_) {
+        writer.PutId(participant.ParticipantId());
+        writer.PutVarint(participant.NameIds().size());
+        for (const auto& [name, aor] : participant.NameIds()) {
+            writer.PutBytes(name);
+            writer.PutBytes(aor);
+        }
+        writer.PutExtensions(participant.Extensions());
+        writer.PutExtensions(participant.StreamAssociationExtensions());
+    }
+
+    writer.PutVarint(media_streams_.size());
+    for (const auto& stream : media_streams_) {
+        writer.PutId(stream.StreamId());
+        writer.PutId(stream.SessionId());
+        writer.PutBytes(stream.Label());
+        writer.PutOptionalString(stream.ContentType());
+        writer.PutExtensions(stream.Extensions());
+    }
+
+    writer.PutVarint(csrs_associations_.size());
+    for (const auto& assoc : csrs_associations_) {
+        writer.PutId(assoc.SessionId());
+        writer.PutTime(assoc.AssociateTime());
+        writer.PutOptionalTime(assoc.DisassociateTime());
+        writer.PutExtensions(assoc.Extensions());
+    }
+
+    writer.PutVarint(participant_session_associations_.size());
+    for (const auto& assoc : participant_session_associations_) {
+        writer.PutId(assoc.ParticipantId());
+        writer.PutId(assoc.SessionId());
+        writer.PutTime(assoc.AssociateTime());
+        writer.PutOptionalTime(assoc.DisassociateTime());
+        writer.PutVarint(assoc.Params().size());
+        for (const auto& param : assoc.Params()) {
+            writer.PutBytes(param);
+        }
+        writer.PutExtensions(assoc.Extensions());
+    }
+
+    writer.PutVarint(participant_stream_associations_.size());
+    for (const auto& assoc : participant_stream_associations_) {
+        writer.PutId(assoc.ParticipantId());
+        writer.PutId(assoc.StreamId());
+        writer.PutByte((assoc.IsSender() ? 1 : 0) | (assoc.IsReceiver() ? 2 : 0));
+        writer.PutTime(assoc.AssociateTime());
+        writer.PutOptionalTime(assoc.DisassociateTime());
+    }
+
+    return out;
+}
+
+bool RecordingSession::FromBinary(std::string_view data)
+{
+    if (not data.starts_with(binary_magic))
+        return false;
+
+    BinaryReader reader(data.substr(binary_magic.size()));
+    if (not reader.GetVersion() or not reader.GetIdTable())
+        return false;
+
+    std::string data_mode;
+    std::optional<Timestamp> start_time;
+    std::optional<Timestamp> end_time;
+    RecordingSession staged;
+    if (not reader.GetString(data_mode) or not reader.GetOptionalTime(start_time)
+        or not reader.GetOptionalTime(end_time) or not reader.GetExtensions(staged) or not reader.GetAttributes(staged))
+        return false;
+
+    const std::string* id;
+    size_t count;
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        std::optional<Timestamp> associate_time;
+        std::optional<Timestamp> disassociate_time;
+        if (not reader.GetId(id) or not reader.GetOptionalTime(associate_time)
+            or not reader.GetOptionalTime(disassociate_time))
+            return false;
+        auto& group = staged.AddGroup(*id);
+        if (associate_time)
+            group.SetAssociateTime(associate_time.value());
+        if (disassociate_time)
+            group.SetDisassociateTime(disassociate_time.value());
+        if (not reader.GetExtensions(group))
+            return false;
+    }
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        std::optional<std::string> reason;
+        size_t sip_session_id_count;
+        if (not reader.GetId(id) or not reader.GetOptionalString(reason) or not reader.GetCount(sip_session_id_count))
+            return false;
+        auto& session = staged.AddCommSession(*id);
+        if (reason)
+            session.SetReason(std::move(reason.value()));
+        for (size_t j = 0; j < sip_session_id_count; ++j) {
+            std::string sip_session_id;
+            if (not reader.GetString(sip_session_id))
+                return false;
+            session.AddSipSessionId(std::move(sip_session_id));
+        }
+        bool has_group_ref;
+        if (not reader.GetBool(has_group_ref))
+            return false;
+        if (has_group_ref) {
+            if (not reader.GetId(id))
+                return false;
+            session.SetGroupRef(*id);
+        }
+        std::optional<Timestamp> start;
+        std::optional<Timestamp> stop;
+        if (not reader.GetOptionalTime(start) or not reader.GetOptionalTime(stop))
+            return false;
+        if (start)
+            session.SetStartTime(start.value());
+        if (stop)
+            session.SetStopTime(stop.value());
+        if (not reader.GetExtensions(session))
+            return false;
+    }
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        size_t name_id_count;
+        if (not reader.GetId(id) or not reader.GetCount(name_id_count))
+            return false;
+        auto& participant = staged.AddParticipant(*id);
+        for (size_t j = 0; j < name_id_count; ++j) {
+            std::string name;
+            std::string aor;
+            if (not reader.GetString(name) or not reader.GetString(aor))
+                return false;
+            participant.AddNameId(name, aor);
+        }
+        if (not reader.GetExtensions(participant) or not reader.GetStreamAssociationExtensions(participant))
+            return false;
+    }
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string* session_id;
+        std::string label;
+        std::optional<std::string> content_type;
+        if (not reader.GetId(id) or not reader.GetId(session_id) or not reader.GetString(label)
+            or not reader.GetOptionalString(content_type))
+            return false;
+        auto& stream = staged.AddStream(*id);
+        stream.SetSessionId(*session_id);
+        stream.SetLabel(label);
+        if (content_type)
+            stream.SetContentType(content_type.value());
+        if (not reader.GetExtensions(stream))
+            return false;
+    }
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        Timestamp associate_time;
+        std::optional<Timestamp> disassociate_time;
+        if (not reader.GetId(id) or not reader.GetTime(associate_time)
+            or not reader.GetOptionalTime(disassociate_time))
+            return false;
+        auto& assoc = staged.csrs_associations_.emplace_back();
+        assoc.SetSession(*id);
+        assoc.SetAssociateTime(associate_time);
+        if (disassociate_time)
+            assoc.SetDisassociateTime(disassociate_time.value());
+        if (not reader.GetExtensions(assoc))
+            return false;
+    }
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string* session_id;
+        Timestamp associate_time;
+        std::optional<Timestamp> disassociate_time;
+        size_t param_count;
+        if (not reader.GetId(id) or not reader.GetId(session_id) or not reader.GetTime(associate_time)
+            or not reader.GetOptionalTime(disassociate_time) or not reader.GetCount(param_count))
+            return false;
+        auto& assoc = staged.participant_session_associations_.emplace_back();
+        assoc.SetParticipant(*id);
+        assoc.SetSession(*session_id);
+        assoc.SetAssociateTime(associate_time);
+        if (disassociate_time)
+            assoc.SetDisassociateTime(disassociate_time.value());
+        for (size_t j = 0; j < param_count; ++j) {
+            std::string param;
+            if (not reader.GetString(param))
+                return false;
+            assoc.AddParam(std::move(param));
+        }
+        if (not reader.GetExtensions(assoc))
+            return false;
+    }
+
+    if (not reader.GetCount(count))
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string* stream_id;
+        uint8_t direction;
+        Timestamp associate_time;
+        std::optional<Timestamp> disassociate_time;
+        if (not reader.GetId(id) or not reader.GetId(stream_id) or not reader.GetByte(direction) or (direction > 3)
+            or not reader.GetTime(associate_time) or not reader.GetOptionalTime(disassociate_time))
+            return false;
+        auto& assoc = staged.participant_stream_associations_.emplace_back();
+        assoc.SetParticipant(*id);
+        assoc.SetStream(*stream_id);
+        assoc.SetSend((direction & 1) != 0);
+        assoc.SetRecv((direction & 2) != 0);
+        assoc.SetAssociateTime(associate_time);
+        if (disassociate_time)
+            assoc.SetDisassociateTime(disassociate_time.value());
+    }
+
+    if (not reader.AtEnd())
+        return false;
+
+    // Commit
+    if (not data_mode.empty())
+        SetDataMode(std::move(data_mode));
+    if (start_time)
+        start_time_ = start_time;
+    if (end_time)
+        end_time_ = end_time;
+    for (auto& [name, value] : staged.attributes_) {
+        AddAttribute(std::move(name), std::move(value));
+    }
+    extensions_.Append(staged.extensions_);
+    Splice(staged);
+
+    return true;
+}
@@ -0,0 +1,809 @@
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "siprec_metadata.h"
+
+using namespace siprec_metadata;
+
+/*
+ * Query indexes
+ *
+ * Every element the indexes are built from is linked to them, so a change of an indexed key made through a
+ * reference returned by AddParticipant() and friends is noticed. Elements added to the session while the indexes are
+ * up to date are indexed in place, and so are keys added to the last element of a list, since the order a rebuild
+ * lists elements in stays the same. Other changes of keys mark the indexes for a rebuild.
+ *
+ * Elements are indexed by list position, so removals find them and their associations without a scan and erase
+ * them from the indexes in place. Keys are owned by the indexes, since the element a key was taken from may be
+ * removed while others with the same key stay.
+ *
+ * Elements with an id are listed in document order, so lookups by id find the first one. The elements of any other
+ * key are kept in buckets which erase an element in constant time by moving the last one into its slot, so a removal
+ * costs as much as the associations of the removed element and queries list elements in document order only until
+ * the first removal.
+ */
+namespace
+{
+struct KeyHash
+{
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view key) const noexcept { return std::hash<std::string_view>{}(key); }
+};
+
+template <typename V>
+using Map = std::unordered_map<std::string, V, KeyHash, std::equal_to<>>;
+
+// Element a value of the indexes refers to
+template <typename V>
+const void* Address(const V& value)
+{
+    if constexpr (std::is_pointer_v<V>)
+        return value;
+    else
+        return &*value;
+}
+
+/**
+ * @brief Elements of one key, each listed once
+ *
+ * Small buckets are searched, larger ones keep the slot of every element, so an element is found in constant time.
+ */
+template <typename V>
+class Bucket
+{
+   private:
+    static constexpr std::size_t small_size = 8;
+
+    std::vector<V> values_;
+    std::unique_ptr<std::unordered_map<const void*, std::size_t>> slots_;  // slot of every element once grown
+
+    std::size_t Find(const V& value) const
+    {
+        if (not slots_)
+            return std::ranges::find(values_, Address(value), Address<V>) - values_.begin();
+        auto found = slots_->find(Address(value));
+        return (found == slots_->end()) ? values_.size() : found->second;
+    }
+
+   public:
+    std::span<const V> Values() const { return values_; }
+    bool Empty() const { return values_.empty(); }
+
+    void Insert(V value)
+    {
+        if (Find(value) != values_.size())
+            return;
+        values_.push_back(value);
+        if (slots_) {
+            slots_->emplace(Address(value), values_.size() - 1);
+        } else if (values_.size() > small_size) {
+            slots_ = std::make_unique<std::unordered_map<const void*, std::size_t>>();
+            for (std::size_t slot = 0; slot < values_.size(); ++slot) {
+                slots_->emplace(Address(values_[slot]), slot);
+            }
+        }
+    }
+
+    // The last element moves into the slot of the erased one
+    bool Erase(V value)
+    {
+        const std::size_t slot = Find(value);
+        if (slot == values_.size())
+            return false;
+        if (slots_)
+            slots_->erase(Address(value));
+        if (slot + 1 != values_.size()) {
+            values_[slot] = values_.back();
+            if (slots_)
+                (*slots_)[Address(values_[slot])] = slot;
+        }
+        values_.pop_back();
+        return true;
+    }
+
+    void Replace(V value, V replacement)
+    {
+        const std::size_t slot = Find(value);
+        if (slot == values_.size())
+            return;
+        if (Find(replacement) != values_.size()) {
+            Erase(value);
+            return;
+        }
+        values_[slot] = replacement;
+        if (slots_) {
+            slots_->erase(Address(value));
+            slots_->emplace(Address(replacement), slot);
+        }
+    }
+
+    std::vector<V> Take() { return std::move(values_); }
+};
+}  // namespace
+
+struct detail::QueryIndex
+{
+    template <typename T>
+    using Elements = Map<Bucket<const T*>>;
+    template <typename T>
+    using Positions = Map<Bucket<typename std::list<T>::const_iterator>>;
+    template <typename T>
+    using ById = Map<std::vector<typename std::list<T>::const_iterator>>;  // document order
+
+    std::mutex mutex;
+    bool dirty = true;
+
+    ById<Participant> participants;
+    ById<MediaStream> streams;
+    ById<CommunicationSession> sessions;
+    Positions<CSRSAssociation> recording_assocs_by_session;
+    Positions<ParticipantSessionAssociation> session_assocs_by_participant;
+    Positions<ParticipantSessionAssociation> session_assocs_by_session;
+    Positions<ParticipantStreamAssociation> stream_assocs_by_participant;
+    Positions<ParticipantStreamAssociation> stream_assocs_by_stream;
+
+    Elements<Participant> participants_by_aor;
+    Elements<Participant> participants_by_name;
+    Elements<MediaStream> streams_sent;
+    Elements<MediaStream> streams_received;
+    Elements<Participant> session_participants;
+    Elements<MediaStream> session_streams;
+    Elements<CommunicationSession> sessions_by_sip_id;
+
+    // Last elements of the lists, null once they are removed
+    const CommunicationSession* last_session = nullptr;
+    const Participant* last_participant = nullptr;
+    const MediaStream* last_stream = nullptr;
+
+    ElementCounts reserved;
+
+    // Index an element after the elements indexed before it
+    void Insert(std::list<CommunicationSession>::const_iterator it);
+    void Insert(std::list<Participant>::const_iterator it);
+    void Insert(std::list<MediaStream>::const_iterator it);
+    void Insert(std::list<CSRSAssociation>::const_iterator it);
+    void Insert(std::list<ParticipantSessionAssociation>::const_iterator it);
+    void Insert(std::list<ParticipantStreamAssociation>::const_iterator it);
+
+    // Reservations only grow, a rebuild for fewer elements keeps the tables sized for the counts reserved before
+    void Reserve(const ElementCounts& counts)
+    {
+        reserved.comm_sessions = std::max(reserved.comm_sessions, counts.comm_sessions);
+        reserved.participants = std::max(reserved.participants, counts.participants);
+        reserved.media_streams = std::max(reserved.media_streams, counts.media_streams);
+        reserved.csrs_associations = std::max(reserved.csrs_associations, counts.csrs_associations);
+        reserved.participant_session_associations =
+            std::max(reserved.participant_session_associations, counts.participant_session_associations);
+        reserved.participant_stream_associations =
+            std::max(reserved.participant_stream_associations, counts.participant_stream_associations);
+
+        sessions.reserve(reserved.comm_sessions);
+        sessions_by_sip_id.reserve(reserved.comm_sessions);
+        session_streams.reserve(std::min(reserved.comm_sessions, reserved.media_streams));
+        participants.reserve(reserved.participants);
+        participants_by_aor.reserve(reserved.participants);
+        participants_by_name.reserve(reserved.participants);
+        streams.reserve(reserved.media_streams);
+
+        // Associations are keyed by the ids of the elements they link, so there are no more keys than either of them
+        const auto csrs = reserved.csrs_associations;
+        const auto session_assocs = reserved.participant_session_associations;
+        const auto stream_assocs = reserved.participant_stream_associations;
+        recording_assocs_by_session.reserve(std::min(reserved.comm_sessions, csrs));
+        session_assocs_by_session.reserve(std::min(reserved.comm_sessions, session_assocs));
+        session_participants.reserve(std::min(reserved.comm_sessions, session_assocs));
+        session_assocs_by_participant.reserve(std::min(reserved.participants, session_assocs));
+        stream_assocs_by_participant.reserve(std::min(reserved.participants, stream_assocs));
+        streams_sent.reserve(std::min(reserved.participants, stream_assocs));
+        streams_received.reserve(std::min(reserved.participants, stream_assocs));
+        stream_assocs_by_stream.reserve(std::min(reserved.media_streams, stream_assocs));
+    }
+
+    void Clear()
+    {
+        participants.clear();
+        streams.clear();
+        sessions.clear();
+        recording_assocs_by_session.clear();
+        session_assocs_by_participant.clear();
+        session_assocs_by_session.clear();
+        stream_assocs_by_participant.clear();
+        stream_assocs_by_stream.clear();
+        participants_by_aor.clear();
+        participants_by_name.clear();
+        streams_sent.clear();
+        streams_received.clear();
+        session_participants.clear();
+        session_streams.clear();
+        sessions_by_sip_id.clear();
+        last_session = nullptr;
+        last_participant = nullptr;
+        last_stream = nullptr;
+    }
+};
+
+static_assert(std::ranges::forward_range<EntityRange<Participant>>);
+
+namespace
+{
+// Elements with an id, a further element with the id goes after the others
+template <typename V>
+void Add(Map<std::vector<V>>& map, std::string_view key, const V& value)
+{
+    if (key.empty())
+        return;
+    auto it = map.find(key);
+    if (it == map.end())
+        it = map.emplace(std::string(key), std::vector<V>()).first;
+    it->second.push_back(value);
+}
+
+template <typename V>
+std::span<const V> Values(const Map<std::vector<V>>& map, std::string_view key)
+{
+    auto it = map.find(key);
+    return (it == map.end()) ? std::span<const V>() : std::span<const V>(it->second);
+}
+
+// Lookups by id return the first element with the id, like a scan of the list would
+template <typename Position>
+const typename std::iterator_traits<Position>::value_type* First(const Map<std::vector<Position>>& positions,
+                                                                  std::string_view id)
+{
+    const auto values = Values(positions, id);
+    return values.empty() ? nullptr : &*values.front();
+}
+
+// Repeated keys of one element, such as two nameIDs with the same AoR, list the element once
+template <typename V>
+void Add(Map<Bucket<V>>& map, std::string_view key, const V& value)
+{
+    if (key.empty())
+        return;
+    auto it = map.find(key);
+    if (it == map.end())
+        it = map.emplace(std::string(key), Bucket<V>()).first;
+    it->second.Insert(value);
+}
+
+template <typename V>
+void Erase(Map<Bucket<V>>& map, std::string_view key, const V& value)
+{
+    auto it = map.find(key);
+    if (it == map.end())
+        return;
+    it->second.Erase(value);
+    if (it->second.Empty())
+        map.erase(it);
+}
+
+template <typename V>
+void Replace(Map<Bucket<V>>& map, std::string_view key, const V& value, const V& replacement)
+{
+    auto it = map.find(key);
+    if (it != map.end())
+        it->second.Replace(value, replacement);
+}
+
+template <typename V>
+std::vector<V> Take(Map<Bucket<V>>& map, std::string_view key)
+{
+    auto it = map.find(key);
+    if (it == map.end())
+        return {};
+    std::vector<V> values = it->second.Take();
+    map.erase(it);
+    return values;
+}
+
+template <typename V>
+std::span<const V> Values(const Map<Bucket<V>>& map, std::string_view key)
+{
+    auto it = map.find(key);
+    return (it == map.end()) ? std::span<const V>() : it->second.Values();
+}
+
+template <typename T>
+EntityRange<T> FindAll(const Map<Bucket<const T*>>& elements, std::string_view key)
+{
+    return EntityRange<T>(Values(elements, key));
+}
+
+template <typename T>
+void IndexElements(detail::QueryIndex& index, const std::list<T>& elements)
+{
+    for (auto it = elements.begin(); it != elements.end(); ++it) {
+        index.Insert(it);
+    }
+}
+
+// An empty erase turns a position taken from a const list into a mutable one without a scan
+template <typename T>
+T& Mutable(std::list<T>& list, typename std::list<T>::const_iterator position)
+{
+    return *list.erase(position, position);
+}
+
+void EraseSessionAssociation(detail::QueryIndex& index, std::list<ParticipantSessionAssociation>& assocs,
+                             std::list<ParticipantSessionAssociation>::const_iterator position)
+{
+    const auto& assoc = *position;
+    Erase(index.session_assocs_by_participant, assoc.ParticipantId(), position);
+    Erase(index.session_assocs_by_session, assoc.SessionId(), position);
+
+    // The participant stays listed for the session while another association between them is left
+    const auto remaining = Values(index.session_assocs_by_participant, assoc.ParticipantId());
+    const bool associated = std::ranges::any_of(remaining, [&](const auto& other) {
+        return other->SessionId() == assoc.SessionId();
+    });
+    const Participant* participant = First(index.participants, assoc.ParticipantId());
+    if (participant and not associated)
+        Erase(index.session_participants, assoc.SessionId(), participant);
+
+    assocs.erase(position);
+}
+
+void EraseStreamAssociation(detail::QueryIndex& index, std::list<ParticipantStreamAssociation>& assocs,
+                            std::list<ParticipantStreamAssociation>::const_iterator position)
+{
+    const auto& assoc = *position;
+    Erase(index.stream_assocs_by_participant, assoc.ParticipantId(), position);
+    Erase(index.stream_assocs_by_stream, assoc.StreamId(), position);
+
+    const auto remaining = Values(index.stream_assocs_by_participant, assoc.ParticipantId());
+    auto associated = [&](bool sender) {
+        return std::ranges::any_of(remaining, [&](const auto& other) {
+            return (other->StreamId() == assoc.StreamId()) and (sender ? other->IsSender() : other->IsReceiver());
+        });
+    };
+    if (const MediaStream* stream = First(index.streams, assoc.StreamId())) {
+        if (assoc.IsSender() and not associated(true))
+            Erase(index.streams_sent, assoc.ParticipantId(), stream);
+        if (assoc.IsReceiver() and not associated(false))
+            Erase(index.streams_received, assoc.ParticipantId(), stream);
+    }
+
+    assocs.erase(position);
+}
+
+// Associations refer to streams by id, so they stay with the next stream of the same id
+void EraseStream(detail::QueryIndex& index, std::list<MediaStream>& streams,
+                 std::list<ParticipantStreamAssociation>& stream_assocs,
+                 std::list<MediaStream>::const_iterator position)
+{
+    auto found = index.streams.find(position->StreamId());
+    if (found->second.size() > 1) {
+        const bool first = (found->second.front() == position);
+        std::erase(found->second, position);
+        if (first) {
+            const MediaStream* next = &*found->second.front();
+            for (const auto& assoc : Values(index.stream_assocs_by_stream, position->StreamId())) {
+                if (assoc->IsSender())
+                    Replace(index.streams_sent, assoc->ParticipantId(), &*position, next);
+                if (assoc->IsReceiver())
+                    Replace(index.streams_received, assoc->ParticipantId(), &*position, next);
+            }
+        }
+    } else {
+        for (const auto& assoc : Take(index.stream_assocs_by_stream, position->StreamId())) {
+            EraseStreamAssociation(index, stream_assocs, assoc);
+        }
+        index.streams.erase(found);
+    }
+    Erase(index.session_streams, position->SessionId(), &*position);
+    if (index.last_stream == &*position)
+        index.last_stream = nullptr;
+    streams.erase(position);
+}
+
+template <typename T>
+bool EndAssociations(std::list<T>& assocs, std::span<const typename std::list<T>::const_iterator> positions,
+                     const Timestamp& time)
+{
+    bool ended = false;
+    for (const auto& position : positions) {
+        if (position->DisassociateTime())
+            continue;
+        Mutable(assocs, position).SetDisassociateTime(time);
+        ended = true;
+    }
+    return ended;
+}
+}  // namespace
+
+void detail::QueryIndex::Insert(std::list<CommunicationSession>::const_iterator it)
+{
+    it->index_link_.Link(this);
+    Add(sessions, it->SessionId(), it);
+    for (const auto& sip_session_id : it->SipSessionIds()) {
+        Add(sessions_by_sip_id, sip_session_id, &*it);
+    }
+    last_session = &*it;
+}
+
+void detail::QueryIndex::Insert(std::list<Participant>::const_iterator it)
+{
+    it->index_link_.Link(this);
+    Add(participants, it->ParticipantId(), it);
+    for (const auto& [name, aor] : it->NameIds()) {
+        Add(participants_by_name, name, &*it);
+        Add(participants_by_aor, aor, &*it);
+    }
+    last_participant = &*it;
+
+    // Associations indexed before the participant they refer to would list it in their order
+    if ((Values(participants, it->ParticipantId()).size() == 1)
+        and (session_assocs_by_participant.contains(it->ParticipantId())
+             or stream_assocs_by_participant.contains(it->ParticipantId())))
+        dirty = true;
+}
+
+void detail::QueryIndex::Insert(std::list<MediaStream>::const_iterator it)
+{
+    it->index_link_.Link(this);
+    Add(streams, it->StreamId(), it);
+    Add(session_streams, it->SessionId(), &*it);
+    last_stream = &*it;
+
+    if ((Values(streams, it->StreamId()).size() == 1) and stream_assocs_by_stream.contains(it->StreamId()))
+        dirty = true;
+}
+
+void detail::QueryIndex::Insert(std::list<CSRSAssociation>::const_iterator it)
+{
+    it->index_link_.Link(this);
+    Add(recording_assocs_by_session, it->SessionId(), it);
+}
+
+void detail::QueryIndex::Insert(std::list<ParticipantSessionAssociation>::const_iterator it)
+{
+    it->index_link_.Link(this);
+    Add(session_assocs_by_participant, it->ParticipantId(), it);
+    Add(session_assocs_by_session, it->SessionId(), it);
+    if (const Participant* participant = First(participants, it->ParticipantId()))
+        Add(session_participants, it->SessionId(), participant);
+}
+
+void detail::QueryIndex::Insert(std::list<ParticipantStreamAssociation>::const_iterator it)
+{
+    it->index_link_.Link(this);
+    Add(stream_assocs_by_participant, it->ParticipantId(), it);
+    Add(stream_assocs_by_stream, it->StreamId(), it);
+    const MediaStream* stream = First(streams, it->StreamId());
+    if (stream and it->IsSender())
+        Add(streams_sent, it->ParticipantId(), stream);
+    if (stream and it->IsReceiver())
+        Add(streams_received, it->ParticipantId(), stream);
+}
+
+detail::QueryIndexHandle::~QueryIndexHandle() { delete index_.load(); }
+
+detail::QueryIndexHandle& detail::QueryIndexHandle::operator=(const QueryIndexHandle&)
+{
+    // Elements of this session stay linked to the indexes, they are rebuilt for the copied elements
+    Invalidate();
+    return *this;
+}
+
+detail::QueryIndexHandle::QueryIndexHandle(QueryIndexHandle&& other) noexcept : index_(other.index_.exchange(nullptr))
+{
+}
+
+detail::QueryIndexHandle& detail::QueryIndexHandle::operator=(QueryIndexHandle&& other) noexcept
+{
+    if (this != &other)
+        delete index_.exchange(other.index_.exchange(nullptr));
+    return *this;
+}
+
+detail::QueryIndex& detail::QueryIndexHandle::Get() const
+{
+    // Concurrent first queries of a const session may race to create the indexes, the loser drops its own
+    QueryIndex* index = index_.load(std::memory_order_acquire);
+    if (index == nullptr) {
+        auto created = std::make_unique<QueryIndex>();
+        if (index_.compare_exchange_strong(index, created.get(), std::memory_order_acq_rel))
+            index = created.release();
+    }
+    return *index;
+}
+
+detail::QueryIndex* detail::QueryIndexHandle::UpToDate() const
+{
+    QueryIndex* index = index_.load(std::memory_order_acquire);
+    return (index and not index->dirty) ? index : nullptr;
+}
+
+void detail::QueryIndexHandle::Invalidate()
+{
+    if (QueryIndex* index = index_.load(std::memory_order_relaxed))
+        index->dirty = true;
+}
+
+void detail::IndexLink::Invalidate() const
+{
+    if (index_)
+        index_->dirty = true;
+}
+
+void detail::IndexLink::NameIdAdded(const Participant& participant, std::string_view name, std::string_view aor) const
+{
+    if (not index_ or index_->dirty)
+        return;
+    if (&participant != index_->last_participant) {
+        index_->dirty = true;
+        return;
+    }
+    Add(index_->participants_by_name, name, &participant);
+    Add(index_->participants_by_aor, aor, &participant);
+}
+
+void detail::IndexLink::SipSessionIdAdded(const CommunicationSession& session, std::string_view sip_session_id) const
+{
+    if (not index_ or index_->dirty)
+        return;
+    if (&session != index_->last_session) {
+        index_->dirty = true;
+        return;
+    }
+    Add(index_->sessions_by_sip_id, sip_session_id, &session);
+}
+
+void detail::IndexLink::SessionChanged(const MediaStream& stream, std::string_view previous_session_id) const
+{
+    if (not index_ or index_->dirty)
+        return;
+    if (&stream != index_->last_stream) {
+        index_->dirty = true;
+        return;
+    }
+    Erase(index_->session_streams, previous_session_id, &stream);
+    Add(index_->session_streams, stream.SessionId(), &stream);
+}
+
+template <typename T>
+void RecordingSession::IndexAppended(const std::list<T>& elements)
+{
+    if (detail::QueryIndex* index = query_index_.UpToDate())
+        index->Insert(std::prev(elements.end()));
+}
+
+template void RecordingSession::IndexAppended(const std::list<CommunicationSession>&);
+template void RecordingSession::IndexAppended(const std::list<Participant>&);
+template void RecordingSession::IndexAppended(const std::list<MediaStream>&);
+template void RecordingSession::IndexAppended(const std::list<CSRSAssociation>&);
+template void RecordingSession::IndexAppended(const std::list<ParticipantSessionAssociation>&);
+template void RecordingSession::IndexAppended(const std::list<ParticipantStreamAssociation>&);
+
+void RecordingSession::Reserve(const ElementCounts& counts)
+{
+    detail::QueryIndex& index = query_index_.Get();
+    std::lock_guard lock(index.mutex);
+    index.Reserve(counts);
+}
+
+detail::QueryIndex& RecordingSession::Index() const
+{
+    detail::QueryIndex& index = query_index_.Get();
+    std::lock_guard lock(index.mutex);
+    if (not index.dirty)
+        return index;
+
+    index.Clear();
+    index.Reserve(ElementCounts{comm_sessions_.size(), participants_.size(), media_streams_.size(),
+                                csrs_associations_.size(), participant_session_associations_.size(),
+                                participant_stream_associations_.size()});
+    IndexElements(index, comm_sessions_);
+    IndexElements(index, participants_);
+    IndexElements(index, media_streams_);
+    IndexElements(index, csrs_associations_);
+    IndexElements(index, participant_session_associations_);
+    IndexElements(index, participant_stream_associations_);
+
+    index.dirty = false;
+    return index;
+}
+
+const Participant* RecordingSession::FindParticipant(std::string_view participant_id) const
+{
+    return First(Index().participants, participant_id);
+}
+
+const MediaStream* RecordingSession::FindStream(std::string_view stream_id) const
+{
+    return First(Index().streams, stream_id);
+}
+
+const CommunicationSession* RecordingSession::FindCommSession(std::string_view session_id) const
+{
+    return First(Index().sessions, session_id);
+}
+
+EntityRange<Participant> RecordingSession::ParticipantsByAoR(std::string_view aor) const
+{
+    return FindAll(Index().participants_by_aor, aor);
+}
+
+EntityRange<Participant> RecordingSession::ParticipantsByName(std::string_view name) const
+{
+    return FindAll(Index().participants_by_name, name);
+}
+
+EntityRange<MediaStream> RecordingSession::StreamsSentBy(std::string_view participant_id) const
+{
+    return FindAll(Index().streams_sent, participant_id);
+}
+
+EntityRange<MediaStream> RecordingSession::StreamsReceivedBy(std::string_view participant_id) const
+{
+    return FindAll(Index().streams_received, participant_id);
+}
+
+EntityRange<Participant> RecordingSession::SessionParticipants(std::string_view session_id) const
+{
+    return FindAll(Index().session_participants, session_id);
+}
+
+EntityRange<MediaStream> RecordingSession::SessionStreams(std::string_view session_id) const
+{
+    return FindAll(Index().session_streams, session_id);
+}
+
+EntityRange<CommunicationSession> RecordingSession::SessionsBySipSessionId(std::string_view sip_session_id) const
+{
+    return FindAll(Index().sessions_by_sip_id, sip_session_id);
+}
+
+// Ids passed to the removals may be views of the removed element, so they are not used after it is erased
+
+bool RecordingSession::RemoveParticipant(std::string_view participant_id)
+{
+    detail::QueryIndex& index = Index();
+    auto found = index.participants.find(participant_id);
+    if (found == index.participants.end())
+        return false;
+    const auto position = found->second.front();
+
+    // Associations refer to participants by id, so they stay with the next participant of the same id
+    if (found->second.size() > 1) {
+        const Participant* next = &*found->second[1];
+        for (const auto& assoc : Values(index.session_assocs_by_participant, participant_id)) {
+            Replace(index.session_participants, assoc->SessionId(), &*position, next);
+        }
+        found->second.erase(found->second.begin());
+    } else {
+        for (const auto& assoc : Take(index.session_assocs_by_participant, participant_id)) {
+            EraseSessionAssociation(index, participant_session_associations_, assoc);
+        }
+        for (const auto& assoc : Take(index.stream_assocs_by_participant, participant_id)) {
+            EraseStreamAssociation(index, participant_stream_associations_, assoc);
+        }
+        index.participants.erase(found);
+    }
+    for (const auto& [name, aor] : position->NameIds()) {
+        Erase(index.participants_by_name, name, &*position);
+        Erase(index.participants_by_aor, aor, &*position);
+    }
+    if (index.last_participant == &*position)
+        index.last_participant = nullptr;
+    participants_.erase(position);
+    return true;
+}
+
+bool RecordingSession::RemoveStream(std::string_view stream_id)
+{
+    detail::QueryIndex& index = Index();
+    const auto positions = Values(index.streams, stream_id);
+    if (positions.empty())
+        return false;
+    EraseStream(index, media_streams_, participant_stream_associations_, positions.front());
+    return true;
+}
+
+bool RecordingSession::RemoveCommSession(std::string_view session_id)
+{
+    detail::QueryIndex& index = Index();
+    auto found = index.sessions.find(session_id);
+    if (found == index.sessions.end())
+        return false;
+    const auto position = found->second.front();
+
+    // Associations and streams refer to sessions by id, so they stay with the next session of the same id
+    if (found->second.size() > 1) {
+        found->second.erase(found->second.begin());
+    } else {
+        for (const auto& assoc : Take(index.recording_assocs_by_session, session_id)) {
+            csrs_associations_.erase(assoc);
+        }
+        for (const auto& assoc : Take(index.session_assocs_by_session, session_id)) {
+            EraseSessionAssociation(index, participant_session_associations_, assoc);
+        }
+        for (const MediaStream* stream : Take(index.session_streams, session_id)) {
+            const auto positions = Values(index.streams, stream->StreamId());
+            const auto position = std::ranges::find(positions, stream, [](const auto& it) { return &*it; });
+            EraseStream(index, media_streams_, participant_stream_associations_, *position);
+        }
+        index.sessions.erase(found);
+    }
+    for (const auto& sip_session_id : position->SipSessionIds()) {
+        Erase(index.sessions_by_sip_id, sip_session_id, &*position);
+    }
+    if (index.last_session == &*position)
+        index.last_session = nullptr;
+    comm_sessions_.erase(position);
+    return true;
+}
+
+bool RecordingSession::RemoveParticipantSessionAssociation(std::string_view participant_id,
+                                                           std::string_view session_id)
+{
+    detail::QueryIndex& index = Index();
+    std::vector<std::list<ParticipantSessionAssociation>::const_iterator> positions;
+    for (const auto& position : Values(index.session_assocs_by_participant, participant_id)) {
+        if (position->SessionId() == session_id)
+            positions.push_back(position);
+    }
+    for (const auto& position : positions) {
+        EraseSessionAssociation(index, participant_session_associations_, position);
+    }
+    return not positions.empty();
+}
+
+bool RecordingSession::RemoveParticipantStreamAssociation(std::string_view participant_id, std::string_view stream_id)
+{
+    detail::QueryIndex& index = Index();
+    std::vector<std::list<ParticipantStreamAssociation>::const_iterator> positions;
+    for (const auto& position : Values(index.stream_assocs_by_participant, participant_id)) {
+        if (position->StreamId() == stream_id)
+            positions.push_back(position);
+    }
+    for (const auto& position : positions) {
+        EraseStreamAssociation(index, participant_stream_associations_, position);
+    }
+    return not positions.empty();
+}
+
+// Disassociate times are not indexed, so ending associations keeps the indexes up to date
+
+bool RecordingSession::DisassociateParticipant(std::string_view participant_id, const Timestamp& time)
+{
+    detail::QueryIndex& index = Index();
+    const bool sessions_ended = EndAssociations(participant_session_associations_,
+                                                Values(index.session_assocs_by_participant, participant_id), time);
+    const bool streams_ended = EndAssociations(participant_stream_associations_,
+                                               Values(index.stream_assocs_by_participant, participant_id), time);
+    return sessions_ended or streams_ended;
+}
+
+bool RecordingSession::DisassociateStream(std::string_view stream_id, const Timestamp& time)
+{
+    detail::QueryIndex& index = Index();
+    const bool ended =
+        EndAssociations(participant_stream_associations_, Values(index.stream_assocs_by_stream, stream_id), time);
+    return ended;
+}
+
+bool RecordingSession::DisassociateCommSession(std::string_view session_id, const Timestamp& time)
+{
+    detail::QueryIndex& index = Index();
+    bool ended = EndAssociations(csrs_associations_, Values(index.recording_assocs_by_session, session_id), time);
+    ended = EndAssociations(participant_session_associations_, Values(index.session_assocs_by_session, session_id),
+                            time)
+            or ended;
+    for (const MediaStream* stream : Values(index.session_streams, session_id)) {
+        ended = EndAssociations(participant_stream_associations_,
+                                Values(index.stream_assocs_by_stream, stream->StreamId()), time)
+                or ended;
+    }
+    return ended;
+}
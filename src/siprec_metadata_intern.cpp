@@ -0,0 +1,120 @@
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "siprec_metadata.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+struct EntryHash
+{
+    using is_transparent = void;
+
+    std::size_t operator()(const detail::InternEntry* entry) const noexcept { return entry->hash; }
+    std::size_t operator()(std::string_view value) const noexcept { return std::hash<std::string_view>{}(value); }
+};
+
+// Entries in the pool have distinct values, so two of them are equal only if they are the same entry
+struct EntryEqual
+{
+    using is_transparent = void;
+
+    bool operator()(const detail::InternEntry* a, const detail::InternEntry* b) const noexcept { return a == b; }
+    bool operator()(std::string_view a, const detail::InternEntry* b) const noexcept { return a == b->value; }
+    bool operator()(const detail::InternEntry* a, std::string_view b) const noexcept { return a->value == b; }
+};
+
+/*
+ * Entries are spread over shards by hash, so parsers on different threads rarely wait for each other. A reference
+ * count only drops to zero under the lock of its shard, so a lookup never revives an entry which is being freed.
+ */
+class InternPool
+{
+   private:
+    static constexpr std::size_t shard_count = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_set<detail::InternEntry*, EntryHash, EntryEqual> entries;
+    };
+
+    std::array<Shard, shard_count> shards_;
+
+    Shard& ShardOf(std::size_t hash) { return shards_[hash % shard_count]; }
+
+   public:
+    detail::InternEntry* Acquire(std::string_view value)
+    {
+        const std::size_t hash = EntryHash()(value);
+        Shard& shard = ShardOf(hash);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.entries.find(value);
+        if (it != shard.entries.end()) {
+            (*it)->references.fetch_add(1, std::memory_order_relaxed);
+            return *it;
+        }
+        auto* entry = new detail::InternEntry{std::string(value), hash, 1};
+        shard.entries.insert(entry);
+        return entry;
+    }
+
+    void Release(detail::InternEntry* entry)
+    {
+        std::uint32_t references = entry->references.load(std::memory_order_relaxed);
+        while (references > 1) {
+            if (entry->references.compare_exchange_weak(references, references - 1, std::memory_order_acq_rel))
+                return;
+        }
+
+        Shard& shard = ShardOf(entry->hash);
+        std::lock_guard lock(shard.mutex);
+        if (entry->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            shard.entries.erase(entry);
+            delete entry;
+        }
+    }
+
+    std::size_t Size()
+    {
+        std::size_t size = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+};
+
+// Never destroyed, so that strings of sessions with static storage duration outlive it safely
+InternPool& Pool()
+{
+    static InternPool* pool = new InternPool;
+    return *pool;
+}
+}  // namespace
+
+InternedString::InternedString(std::string_view value)
+{
+    if (not value.empty())
+        entry_ = Pool().Acquire(value);
+}
+
+InternedString::InternedString(const InternedString& other) : entry_(other.entry_)
+{
+    if (entry_)
+        entry_->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+InternedString::~InternedString()
+{
+    if (entry_)
+        Pool().Release(entry_);
+}
+
+std::size_t InternedString::PoolSize() { return Pool().Size(); }
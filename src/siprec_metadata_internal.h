@@ -0,0 +1,48 @@
+// siprec_metadata_internal.h
+#pragma once
+
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "siprec_metadata.h"
+
+namespace pugi
+{
+class xml_node;
+}
+
+// Helpers shared by the library translation units, not part of the public interface
+namespace siprec_metadata
+{
+std::string base64_encode(std::string_view data);
+
+// Decodes canonical base64 only, so that decoding and encoding again always gives the original string
+std::optional<std::string> base64_decode(std::string_view encoded);
+
+// Quoted and escaped JSON string
+void AppendJSONString(std::string& out, std::string_view value);
+
+// Parse one element of a recording document and append it, false if a required attribute is missing. Unknown child
+// elements are copied from the document buffer the node was parsed from. Defined for every element type with a
+// schema, see siprec_metadata_schema.h.
+template <typename Entity>
+bool FromXML(std::list<Entity>& elements, const pugi::xml_node& node, std::string_view xml);
+// Stream associations of a participantstreamassoc element, its unknown child elements are appended to extensions
+bool FromXML(std::list<ParticipantStreamAssociation>& participant_stream_associations, const pugi::xml_node& node,
+             std::string_view xml, RawElements& extensions);
+
+template <typename T>
+const T& Deref(const T& element)
+{
+    return element;
+}
+
+template <typename T>
+const T& Deref(const std::shared_ptr<const T>& element)
+{
+    return *element;
+}
+}  // namespace siprec_metadata
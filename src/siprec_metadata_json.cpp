@@ -0,0 +1,891 @@
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "siprec_metadata.h"
+#include "siprec_metadata_internal.h"
+
+using namespace siprec_metadata;
+
+/*
+ * JSON encoding
+ *
+ * One object per recording session with the same elements as the XML document. Absent optional values are omitted,
+ * timestamps are RFC3339 strings.
+ *
+ *   {"datamode":"complete","start_time":"...","end_time":"...",
+ *    "groups":[{"group_id":"...","associate_time":"...","disassociate_time":"..."}],
+ *    "sessions":[{"session_id":"...","reason":"...","start_time":"...","stop_time":"...","sip_session_ids":["..."],
+ *                 "group_ref":"..."}],
+ *    "participants":[{"participant_id":"...","name_ids":[{"name":"...","aor":"..."}]}],
+ *    "streams":[{"stream_id":"...","session_id":"...","label":"...","content_type":"..."}],
+ *    "session_recording_associations":[{"session_id":"...","associate_time":"...","disassociate_time":"..."}],
+ *    "participant_session_associations":[{"participant_id":"...","session_id":"...","associate_time":"...",
+ *                                         "disassociate_time":"...","params":["..."]}],
+ *    "participant_stream_associations":[{"participant_id":"...","stream_id":"...","send":true,"recv":false,
+ *                                        "associate_time":"...","disassociate_time":"..."}]}
+ *
+ * The recording and every element but a participant-stream association may also have "extensions":["..."], the
+ * extension elements of the XML document as strings. The reader skips unknown members, so newer documents stay
+ * readable.
+ */
+
+namespace siprec_metadata
+{
+void AppendJSONString(std::string& out, std::string_view value)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        const auto c = static_cast<uint8_t>(value[i]);
+        if ((c >= 0x20) and (c != '"') and (c != '\\'))
+            continue;
+        out.append(value.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                out.append("\\u00");
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xF]);
+                break;
+        }
+    }
+    out.append(value.data() + run, value.size() - run);
+    out.push_back('"');
+}
+}  // namespace siprec_metadata
+
+namespace
+{
+class JSONWriter
+{
+   private:
+    std::string& out_;
+    bool first_ = true;  // no comma before the next member or array item
+
+   public:
+    explicit JSONWriter(std::string& out) : out_(out) {}
+
+    void Separator()
+    {
+        if (not first_)
+            out_.push_back(',');
+        first_ = false;
+    }
+
+    void String(std::string_view value) { AppendJSONString(out_, value); }
+
+    void Key(std::string_view key)
+    {
+        Separator();
+        out_.push_back('"');
+        out_.append(key);
+        out_.append("\":");
+    }
+
+    void BeginObject()
+    {
+        out_.push_back('{');
+        first_ = true;
+    }
+
+    void EndObject()
+    {
+        out_.push_back('}');
+        first_ = false;
+    }
+
+    void BeginArray(std::string_view key)
+    {
+        Key(key);
+        out_.push_back('[');
+        first_ = true;
+    }
+
+    void EndArray()
+    {
+        out_.push_back(']');
+        first_ = false;
+    }
+
+    void Member(std::string_view key, std::string_view value)
+    {
+        Key(key);
+        String(value);
+    }
+
+    void Member(std::string_view key, bool value)
+    {
+        Key(key);
+        out_.append(value ? "true" : "false");
+    }
+
+    void Member(std::string_view key, const Timestamp& time)
+    {
+        char text[Timestamp::rfc3339_max_size];
+        Member(key, std::string_view(text, time.to_rfc3339(text)));
+    }
+
+    template <typename T>
+    void Member(std::string_view key, const std::optional<T>& value)
+    {
+        if (value)
+            Member(key, value.value());
+    }
+
+    template <typename Strings>
+    void StringArray(std::string_view key, const Strings& values)
+    {
+        BeginArray(key);
+        for (const auto& value : values) {
+            Separator();
+            String(value);
+        }
+        EndArray();
+    }
+
+    void Extensions(const RawElements& extensions, std::string_view key = "extensions")
+    {
+        if (extensions.empty())
+            return;
+        BeginArray(key);
+        for (size_t i = 0; i < extensions.size(); ++i) {
+            Separator();
+            String(extensions[i]);
+        }
+        EndArray();
+    }
+
+    // Object as an array item or the top level value
+    template <typename Function>
+    void Object(Function members)
+    {
+        Separator();
+        BeginObject();
+        members();
+        EndObject();
+    }
+
+    template <typename Elements, typename Function>
+    void ObjectArray(std::string_view key, const Elements& elements, Function members)
+    {
+        BeginArray(key);
+        for (const auto& element : elements) {
+            Object([&] { members(Deref(element)); });
+        }
+        EndArray();
+    }
+};
+
+// Pull parser reading values straight from the input, without building a document tree
+class JSONReader
+{
+   private:
+    static constexpr int max_depth = 64;
+
+    std::string_view input_;
+    size_t pos_ = 0;
+    std::string key_;  // unescaped key when it contains escape sequences
+
+    void SkipSpace()
+    {
+        while ((pos_ < input_.size()) and std::string_view(" \n\r\t").contains(input_[pos_]))
+            ++pos_;
+    }
+
+    bool Consume(char c)
+    {
+        SkipSpace();
+        if ((pos_ >= input_.size()) or (input_[pos_] != c))
+            return false;
+        ++pos_;
+        return true;
+    }
+
+    bool Literal(std::string_view literal)
+    {
+        if (input_.substr(pos_, literal.size()) != literal)
+            return false;
+        pos_ += literal.size();
+        return true;
+    }
+
+    bool Hex4(uint32_t& value)
+    {
+        if (input_.size() - pos_ < 4)
+            return false;
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = input_[pos_++];
+            value <<= 4;
+            if ((c >= '0') and (c <= '9'))
+                value |= static_cast<uint32_t>(c - '0');
+            else if ((c >= 'a') and (c <= 'f'))
+                value |= static_cast<uint32_t>(c - 'a' + 10);
+            else if ((c >= 'A') and (c <= 'F'))
+                value |= static_cast<uint32_t>(c - 'A' + 10);
+            else
+                return false;
+        }
+        return true;
+    }
+
+    static void AppendUTF8(std::string& out, uint32_t code_point)
+    {
+        if (code_point < 0x80) {
+            out.push_back(static_cast<char>(code_point));
+        } else if (code_point < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else if (code_point < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+    // Continue a string after an unescaped prefix
+    bool Unescape(std::string& out)
+    {
+        while (pos_ < input_.size()) {
+            const char c = input_[pos_++];
+            if (c == '"')
+                return true;
+            if (static_cast<uint8_t>(c) < 0x20)
+                return false;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (pos_ >= input_.size())
+                return false;
+            switch (input_[pos_++]) {
+                case '"':
+                    out.push_back('"');
+                    break;
+                case '\\':
+                    out.push_back('\\');
+                    break;
+                case '/':
+                    out.push_back('/');
+                    break;
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'u': {
+                    uint32_t code_point;
+                    if (not Hex4(code_point))
+                        return false;
+                    if ((code_point >= 0xD800) and (code_point < 0xDC00)) {
+                        uint32_t low;
+                        if (not Literal("\\u") or not Hex4(low) or (low < 0xDC00) or (low >= 0xE000))
+                            return false;
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    } else if ((code_point >= 0xDC00) and (code_point < 0xE000)) {
+                        return false;
+                    }
+                    AppendUTF8(out, code_point);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    // String without escape sequences is returned as a view into the input, other ones are unescaped into scratch
+    bool StringView(std::string_view& value, std::string& scratch)
+    {
+        if (not Consume('"'))
+            return false;
+        const size_t start = pos_;
+        while (pos_ < input_.size()) {
+            const char c = input_[pos_];
+            if (c == '"') {
+                value = input_.substr(start, pos_ - start);
+                ++pos_;
+                return true;
+            }
+            if ((c == '\\') or (static_cast<uint8_t>(c) < 0x20))
+                break;
+            ++pos_;
+        }
+        scratch.assign(input_.substr(start, pos_ - start));
+        if (not Unescape(scratch))
+            return false;
+        value = scratch;
+        return true;
+    }
+
+    bool SkipValue(int depth)
+    {
+        if (depth > max_depth)
+            return false;
+        SkipSpace();
+        if (pos_ >= input_.size())
+            return false;
+        switch (input_[pos_]) {
+            case '"': {
+                std::string scratch;
+                std::string_view value;
+                return StringView(value, scratch);
+            }
+            case '{':
+                return Object([&](std::string_view) { return SkipValue(depth + 1); });
+            case '[':
+                return Array([&] { return SkipValue(depth + 1); });
+            case 't':
+                return Literal("true");
+            case 'f':
+                return Literal("false");
+            case 'n':
+                return Literal("null");
+            default: {
+                // Number
+                const size_t start = pos_;
+                while ((pos_ < input_.size()) and std::string_view("+-.0123456789eE").contains(input_[pos_]))
+                    ++pos_;
+                return (pos_ > start);
+            }
+        }
+    }
+
+   public:
+    explicit JSONReader(std::string_view input) : input_(input) {}
+
+    bool AtEnd()
+    {
+        SkipSpace();
+        return (pos_ == input_.size());
+    }
+
+    // Calls member(key) for every member, which must consume the value
+    template <typename Function>
+    bool Object(Function member)
+    {
+        if (not Consume('{'))
+            return false;
+        if (Consume('}'))
+            return true;
+        do {
+            std::string_view key;
+            if (not StringView(key, key_) or not Consume(':'))
+                return false;
+            if (not member(key))
+                return false;
+        } while (Consume(','));
+        return Consume('}');
+    }
+
+    // Calls item() for every item, which must consume it
+    template <typename Function>
+    bool Array(Function item)
+    {
+        if (not Consume('['))
+            return false;
+        if (Consume(']'))
+            return true;
+        do {
+            if (not item())
+                return false;
+        } while (Consume(','));
+        return Consume(']');
+    }
+
+    bool String(std::string& value)
+    {
+        std::string_view view;
+        std::string scratch;
+        if (not StringView(view, scratch))
+            return false;
+        value.assign(view);
+        return true;
+    }
+
+    bool String(std::optional<std::string>& value) { return String(value.emplace()); }
+
+    bool Time(Timestamp& time)
+    {
+        std::string text;
+        if (not String(text))
+            return false;
+        time = Timestamp::from_rfc3339(text);
+        return true;
+    }
+
+    bool Time(std::optional<Timestamp>& time) { return Time(time.emplace()); }
+
+    bool Bool(bool& value)
+    {
+        SkipSpace();
+        if (Literal("true")) {
+            value = true;
+            return true;
+        }
+        value = false;
+        return Literal("false");
+    }
+
+    bool StringArray(std::list<std::string>& values)
+    {
+        return Array([&] { return String(values.emplace_back()); });
+    }
+
+    template <typename T>
+    bool Extensions(T& element)
+    {
+        std::list<std::string> extensions;
+        if (not StringArray(extensions))
+            return false;
+        for (const auto& extension : extensions) {
+            element.AddExtension(extension);
+        }
+        return true;
+    }
+
+    bool Skip() { return SkipValue(0); }
+};
+
+template <typename Source>
+void WriteJSON(const Source& source, std::string& out)
+{
+    JSONWriter writer(out);
+    writer.Object([&] {
+        writer.Member("datamode", source.DataMode());
+        writer.Member("start_time", source.StartTime());
+        writer.Member("end_time", source.EndTime());
+        if (not source.Attributes().empty()) {
+            writer.ObjectArray("attributes", source.Attributes(), [&](const auto& attribute) {
+                writer.Member("name", attribute.first);
+                writer.Member("value", attribute.second);
+            });
+        }
+
+        writer.ObjectArray("groups", source.Groups(), [&](const CommunicationSessionGroup& group) {
+            writer.Member("group_id", group.GroupId());
+            writer.Member("associate_time", group.AssociateTime());
+            writer.Member("disassociate_time", group.DisassociateTime());
+            writer.Extensions(group.Extensions());
+        });
+
+        writer.ObjectArray("sessions", source.CommSessions(), [&](const CommunicationSession& session) {
+            writer.Member("session_id", session.SessionId());
+            writer.Member("reason", session.Reason());
+            writer.Member("start_time", session.StartTime());
+            writer.Member("stop_time", session.StopTime());
+            writer.StringArray("sip_session_ids", session.SipSessionIds());
+            writer.Member("group_ref", session.GroupRef());
+            writer.Extensions(session.Extensions());
+        });
+
+        writer.ObjectArray("participants", source.Participants(), [&](const Participant& participant) {
+            writer.Member("participant_id", participant.ParticipantId());
+            writer.ObjectArray("name_ids", participant.NameIds(), [&](const auto& name_id) {
+                writer.Member("name", name_id.first);
+                writer.Member("aor", name_id.second);
+            });
+            writer.Extensions(participant.Extensions());
+            writer.Extensions(participant.StreamAssociationExtensions(), "stream_association_extensions");
+        });
+
+        writer.ObjectArray("streams", source.MediaStreams(), [&](const MediaStream& stream) {
+            writer.Member("stream_id", stream.StreamId());
+            writer.Member("session_id", stream.SessionId());
+            writer.Member("label", stream.Label());
+            writer.Member("content_type", stream.ContentType());
+            writer.Extensions(stream.Extensions());
+        });
+
+        writer.ObjectArray("session_recording_associations", source.CS_RS_Associations(),
+                           [&](const CSRSAssociation& assoc) {
+                               writer.Member("session_id", assoc.SessionId());
+                               writer.Member("associate_time", assoc.AssociateTime());
+                               writer.Member("disassociate_time", assoc.DisassociateTime());
+                               writer.Extensions(assoc.Extensions());
+                           });
+
+        writer.ObjectArray("participant_session_associations", source.ParticipantSessionAssociations(),
+                           [&](const ParticipantSessionAssociation& assoc) {
+                               writer.Member("participant_id", assoc.ParticipantId());
+                               writer.Member("session_id", assoc.SessionId());
+                               writer.Member("associate_time", assoc.AssociateTime());
+                               writer.Member("disassociate_time", assoc.DisassociateTime());
+                               writer.StringArray("params", assoc.Params());
+                               writer.Extensions(assoc.Extensions());
+                           });
+
+        writer.ObjectArray("participant_stream_associations", source.ParticipantStreamAssociations(),
+                           [&](const ParticipantStreamAssociation& assoc) {
+                               writer.Member("participant_id", assoc.ParticipantId());
+                               writer.Member("stream_id", assoc.StreamId());
+                               writer.Member("send", assoc.IsSender());
+                               writer.Member("recv", assoc.IsReceiver());
+                               writer.Member("associate_time", assoc.AssociateTime());
+                               writer.Member("disassociate_time", assoc.DisassociateTime());
+                           });
+
+        writer.Extensions(source.Extensions());
+    });
+}
+}  // namespace
+
+void RecordingSession::AppendJSON(std::string& out) const { WriteJSON(*this, out); }
+
+std::string RecordingSession::ToJSON() const
+{
+    std::string out;
+    AppendJSON(out);
+    return out;
+}
+
+bool RecordingSession::FromJSON(std::string_view json)
+{
+    JSONReader reader(json);
+
+    std::optional<std::string> data_mode;
+    std::optional<Timestamp> start_time;
+    std::optional<Timestamp> end_time;
+    RecordingSession staged;
+
+    auto group = [&] {
+        std::optional<std::string> id;
+        std::optional<Timestamp> associate_time;
+        std::optional<Timestamp> disassociate_time;
+        std::list<std::string> extensions;
+        const bool parsed = reader.Object([&](std::string_view key) {
+            if (key == "group_id")
+                return reader.String(id);
+            if (key == "associate_time")
+                return reader.Time(associate_time);
+            if (key == "disassociate_time")
+                return reader.Time(disassociate_time);
+            if (key == "extensions")
+                return reader.StringArray(extensions);
+            return reader.Skip();
+        });
+        if (not parsed or not id)
+            return false;
+        auto& group = staged.groups_.emplace_back(id.value());
+        if (associate_time)
+            group.SetAssociateTime(associate_time.value());
+        if (disassociate_time)
+            group.SetDisassociateTime(disassociate_time.value());
+        for (const auto& extension : extensions) {
+            group.AddExtension(extension);
+        }
+        return true;
+    };
+
+    auto session = [&] {
+        std::optional<std::string> id;
+        std::optional<std::string> reason;
+        std::optional<std::string> group_ref;
+        std::optional<Timestamp> start;
+        std::optional<Timestamp> stop;
+        std::list<std::string> sip_session_ids;
+        std::list<std::string> extensions;
+        const bool parsed = reader.Object([&](std::string_view key) {
+            if (key == "session_id")
+                return reader.String(id);
+            if (key == "reason")
+                return reader.String(reason);
+            if (key == "group_ref")
+                return reader.String(group_ref);
+            if (key == "start_time")
+                return reader.Time(start);
+            if (key == "stop_time")
+                return reader.Time(stop);
+            if (key == "sip_session_ids")
+                return reader.StringArray(sip_session_ids);
+            if (key == "extensions")
+                return reader.StringArray(extensions);
+            return reader.Skip();
+        });
+        if (not parsed or not id)
+            return false;
+        auto& session = staged.comm_sessions_.emplace_back(id.value());
+        if (reason)
+            session.SetReason(std::move(reason.value()));
+        if (group_ref)
+            session.SetGroupRef(group_ref.value());
+        if (start)
+            session.SetStartTime(start.value());
+        if (stop)
+            session.SetStopTime(stop.value());
+        for (auto& sip_session_id : sip_session_ids) {
+            session.AddSipSessionId(std::move(sip_session_id));
+        }
+        for (const auto& extension : extensions) {
+            session.AddExtension(extension);
+        }
+        return true;
+    };
+
+    auto participant = [&] {
+        std::optional<std::string> id;
+        std::list<std::pair<std::string, std::string>> name_ids;
+        std::list<std::string> extensions;
+        std::list<std::string> stream_association_extensions;
+        const bool parsed = reader.Object([&](std::string_view key) {
+            if (key == "participant_id")
+                return reader.String(id);
+            if (key == "name_ids") {
+                return reader.Array([&] {
+                    auto& [name, aor] = name_ids.emplace_back();
+                    return reader.Object([&](std::string_view name_id_key) {
+                        if (name_id_key == "name")
+                            return reader.String(name);
+                        if (name_id_key == "aor")
+                            return reader.String(aor);
+                        return reader.Skip();
+                    });
+                });
+            }
+            if (key == "extensions")
+                return reader.StringArray(extensions);
+            if (key == "stream_association_extensions")
+                return reader.StringArray(stream_association_extensions);
+            return reader.Skip();
+        });
+        if (not parsed or not id)
+            return false;
+        auto& participant = staged.participants_.emplace_back(id.value());
+        for (const auto& [name, aor] : name_ids) {
+            participant.AddNameId(name, aor);
+        }
+        for (const auto& extension : extensions) {
+            participant.AddExtension(extension);
+        }
+        for (const auto& extension : stream_association_extensions) {
+            participant.AddStreamAssociationExtension(extension);
+        }
+        return true;
+    };
+
+    auto stream = [&] {
+        std::optional<std::string> id;
+        std::optional<std::string> session_id;
+        std::string label;
+        std::optional<std::string> content_type;
+        std::list<std::string> extensions;
+        const bool parsed = reader.Object([&](std::string_view key) {
+            if (key == "stream_id")
+                return reader.String(id);
+            if (key == "session_id")
+                return reader.String(session_id);
+            if (key == "label")
+                return reader.String(label);
+            if (key == "content_type")
+                return reader.String(content_type);
+            if (key == "extensions")
+                return reader.StringArray(extensions);
+            return reader.Skip();
+        });
+        if (not parsed or not id or not session_id)
+            return false;
+        auto& stream = staged.media_streams_.emplace_back(id.value());
+        stream.SetSessionId(session_id.value());
+        stream.SetLabel(label);
+        if (content_type)
+            stream.SetContentType(content_type.value());
+        for (const auto& extension : extensions) {
+            stream.AddExtension(extension);
+        }
+        return true;
+    };
+
+    auto csrs_association = [&] {
+        auto& assoc = staged.csrs_associations_.emplace_back();
+        return reader.Object([&](std::string_view key) {
+            std::string text;
+            if (key == "session_id") {
+                if (not reader.String(text))
+                    return false;
+                assoc.SetSession(text);
+                return true;
+            }
+            if (key == "associate_time") {
+                if (not reader.String(text))
+                    return false;
+                assoc.SetAssociateTime(text);
+                return true;
+            }
+            if (key == "disassociate_time") {
+                if (not reader.String(text))
+                    return false;
+                assoc.SetDisassociateTime(text);
+                return true;
+            }
+            if (key == "extensions")
+                return reader.Extensions(assoc);
+            return reader.Skip();
+        });
+    };
+
+    auto participant_session_association = [&] {
+        auto& assoc = staged.participant_session_associations_.emplace_back();
+        return reader.Object([&](std::string_view key) {
+            std::string text;
+            if (key == "params") {
+                std::list<std::string> params;
+                if (not reader.StringArray(params))
+                    return false;
+                for (auto& param : params) {
+                    assoc.AddParam(std::move(param));
+                }
+                return true;
+            }
+            if (key == "extensions")
+                return reader.Extensions(assoc);
+            if ((key != "participant_id") and (key != "session_id") and (key != "associate_time")
+                and (key != "disassociate_time"))
+                return reader.Skip();
+            if (not reader.String(text))
+                return false;
+            if (key == "participant_id")
+                assoc.SetParticipant(text);
+            else if (key == "session_id")
+                assoc.SetSession(text);
+            else if (key == "associate_time")
+                assoc.SetAssociateTime(text);
+            else
+                assoc.SetDisassociateTime(text);
+            return true;
+        });
+    };
+
+    auto participant_stream_association = [&] {
+        auto& assoc = staged.participant_stream_associations_.emplace_back();
+        return reader.Object([&](std::string_view key) {
+            if ((key == "send") or (key == "recv")) {
+                bool value;
+                if (not reader.Bool(value))
+                    return false;
+                if (key == "send")
+                    assoc.SetSend(value);
+                else
+                    assoc.SetRecv(value);
+                return true;
+            }
+            if ((key != "participant_id") and (key != "stream_id") and (key != "associate_time")
+                and (key != "disassociate_time"))
+                return reader.Skip();
+            std::string text;
+            if (not reader.String(text))
+                return false;
+            if (key == "participant_id")
+                assoc.SetParticipant(text);
+            else if (key == "stream_id")
+                assoc.SetStream(text);
+            else if (key == "associate_time")
+                assoc.SetAssociateTime(text);
+            else
+                assoc.SetDisassociateTime(text);
+            return true;
+        });
+    };
+
+    const bool parsed = reader.Object([&](std::string_view key) {
+        if (key == "datamode")
+            return reader.String(data_mode);
+        if (key == "start_time")
+            return reader.Time(start_time);
+        if (key == "end_time")
+            return reader.Time(end_time);
+        if (key == "groups")
+            return reader.Array(group);
+        if (key == "sessions")
+            return reader.Array(session);
+        if (key == "participants")
+            return reader.Array(participant);
+        if (key == "streams")
+            return reader.Array(stream);
+        if (key == "session_recording_associations")
+            return reader.Array(csrs_association);
+        if (key == "participant_session_associations")
+            return reader.Array(participant_session_association);
+        if (key == "participant_stream_associations")
+            return reader.Array(participant_stream_association);
+        if (key == "attributes") {
+            return reader.Array([&] {
+                std::string name;
+                std::string value;
+                const bool parsed = reader.Object([&](std::string_view attribute_key) {
+                    if (attribute_key == "name")
+                        return reader.String(name);
+                    if (attribute_key == "value")
+                        return reader.String(value);
+                    return reader.Skip();
+                });
+                if (parsed and not name.empty())
+                    staged.AddAttribute(std::move(name), std::move(value));
+                return parsed;
+            });
+        }
+        if (key == "extensions")
+            return reader.Extensions(staged);
+        return reader.Skip();
+    });
+    if (not parsed or not reader.AtEnd())
+        return false;
+
+    // Commit
+    if (data_mode)
+        SetDataMode(std::move(data_mode.value()));
+    if (start_time)
+        start_time_ = start_time;
+    if (end_time)
+        end_time_ = end_time;
+    for (auto& [name, value] : staged.attributes_) {
+        AddAttribute(std::move(name), std::move(value));
+    }
+    extensions_.Append(staged.extensions_);
+    Splice(staged);
+
+    return true;
+}
+
+void RecordingSessionSnapshot::AppendJSON(std::string& out) const { WriteJSON(*this, out); }
+
+std::string RecordingSessionSnapshot::ToJSON() const
+{
+    std::string out;
+    AppendJSON(out);
+    return out;
+}
@@ -0,0 +1,334 @@
+// siprec_metadata_schema.h
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "siprec_metadata.h"
+
+/*
+ * XML schema of the metadata elements
+ *
+ * Every element type has a table describing its element name, the attribute with its id, its other attributes and
+ * its child elements in document order, together with the accessors that read and write them. The serializer writes
+ * the fields in table order and the parser matches child elements against the table with a perfect hash, so both
+ * directions follow one description and a new field is added in one place.
+ */
+namespace siprec_metadata::schema
+{
+
+/**
+ * @brief Hash table without collisions over a fixed set of names, built at compile time
+ *
+ * A lookup hashes the name once and compares it with the single candidate in its slot.
+ */
+template <std::size_t N>
+class PerfectHash
+{
+   private:
+    static constexpr std::size_t slot_count = std::bit_ceil(2 * N + 1);
+
+    std::array<std::string_view, N> names_;
+    std::uint32_t seed_ = 0;
+    std::array<std::uint8_t, slot_count> slots_{};  // index of the name in the slot plus one, 0 if the slot is empty
+
+    static constexpr std::size_t Slot(std::string_view name, std::uint32_t seed)
+    {
+        std::uint32_t hash = 2166136261u ^ (seed * 16777619u);
+        for (const char c : name) {
+            hash = (hash ^ static_cast<std::uint8_t>(c)) * 16777619u;
+        }
+        return (hash ^ (hash >> 15)) & (slot_count - 1);
+    }
+
+   public:
+    constexpr explicit PerfectHash(const std::array<std::string_view, N> &names) : names_(names)
+    {
+        // Seeds are tried in turn until every name lands in a slot of its own
+        for (bool collision = true; collision; ++seed_) {
+            collision = false;
+            slots_ = {};
+            for (std::size_t i = 0; (i < N) and not collision; ++i) {
+                auto &slot = slots_[Slot(names_[i], seed_)];
+                collision = (slot != 0);
+                slot = static_cast<std::uint8_t>(i + 1);
+            }
+        }
+        --seed_;
+    }
+
+    /**
+     * @brief Index of the name, N if it is none of the names
+     */
+    constexpr std::size_t Find(std::string_view name) const
+    {
+        const std::size_t slot = slots_[Slot(name, seed_)];
+        return ((slot != 0) and (names_[slot - 1] == name)) ? slot - 1 : N;
+    }
+};
+
+// Attribute with the id of the element, passed to its constructor
+template <typename Entity>
+struct Key
+{
+    std::string_view name;
+    const std::string &(Entity::*get)() const;
+};
+
+// Attribute written always; a missing one fails parsing if it is required and is read as empty otherwise
+template <typename Entity>
+struct Attribute
+{
+    std::string_view name;
+    const std::string &(Entity::*get)() const;
+    void (Entity::*set)(std::string_view);
+    bool required;
+};
+
+// Child element with text, written if the value is set or not empty; interned values are set from a view
+template <typename Entity, typename Value, typename Argument = std::string_view>
+struct Text
+{
+    std::string_view name;
+    const Value &(Entity::*get)() const;
+    void (Entity::*set)(Argument);
+};
+
+// Child element with an RFC3339 time, written if the value is set
+template <typename Entity, typename Value>
+struct Time
+{
+    std::string_view name;
+    const Value &(Entity::*get)() const;
+    void (Entity::*set)(const Timestamp &);
+};
+
+// Child element repeated for every value
+template <typename Entity>
+struct TextList
+{
+    std::string_view name;
+    const std::list<std::string> &(Entity::*get)() const;
+    void (Entity::*add)(std::string);
+};
+
+// nameID elements of a participant: the AoR as an attribute and an optional name child
+struct NameIds
+{
+    std::string_view name;
+    std::string_view aor;
+    std::string_view display_name;
+    std::string_view language;
+};
+
+template <typename Entity>
+struct Schema;
+
+template <>
+struct Schema<CommunicationSessionGroup>
+{
+    using E = CommunicationSessionGroup;
+
+    static constexpr std::string_view element = "group";
+    static constexpr Key<E> key{"group_id", &E::GroupId};
+    static constexpr std::tuple<> attributes{};
+    static constexpr std::tuple children{
+        Time<E, std::optional<Timestamp>>{"associate-time", &E::AssociateTime, &E::SetAssociateTime},
+        Time<E, std::optional<Timestamp>>{"disassociate-time", &E::DisassociateTime, &E::SetDisassociateTime},
+    };
+};
+
+template <>
+struct Schema<CommunicationSession>
+{
+    using E = CommunicationSession;
+
+    static constexpr std::string_view element = "session";
+    static constexpr Key<E> key{"session_id", &E::SessionId};
+    static constexpr std::tuple<> attributes{};
+    static constexpr std::tuple children{
+        Text<E, std::optional<std::string>, std::string>{"reason", &E::Reason, &E::SetReason},
+        Time<E, std::optional<Timestamp>>{"start-time", &E::StartTime, &E::SetStartTime},
+        Time<E, std::optional<Timestamp>>{"stop-time", &E::StopTime, &E::SetStopTime},
+        TextList<E>{"sipSessionID", &E::SipSessionIds, &E::AddSipSessionId},
+        Text<E, std::optional<InternedString>>{"group-ref", &E::GroupRef, &E::SetGroupRef},
+    };
+};
+
+template <>
+struct Schema<Participant>
+{
+    using E = Participant;
+
+    static constexpr std::string_view element = "participant";
+    static constexpr Key<E> key{"participant_id", &E::ParticipantId};
+    static constexpr std::tuple<> attributes{};
+    static constexpr std::tuple children{
+        NameIds{"nameID", "aor", "name", "it"},
+    };
+};
+
+template <>
+struct Schema<MediaStream>
+{
+    using E = MediaStream;
+
+    static constexpr std::string_view element = "stream";
+    static constexpr Key<E> key{"stream_id", &E::StreamId};
+    static constexpr std::tuple attributes{
+        Attribute<E>{"session_id", &E::SessionId, &E::SetSessionId, true},
+    };
+    static constexpr std::tuple children{
+        Text<E, std::string>{"label", &E::Label, &E::SetLabel},
+        Text<E, std::optional<InternedString>>{"content-type", &E::ContentType, &E::SetContentType},
+    };
+};
+
+template <>
+struct Schema<CSRSAssociation>
+{
+    using E = CSRSAssociation;
+
+    static constexpr std::string_view element = "sessionrecordingassoc";
+    static constexpr std::tuple attributes{
+        Attribute<E>{"session_id", &E::SessionId, &E::SetSession, false},
+    };
+    static constexpr std::tuple children{
+        Time<E, Timestamp>{"associate-time", &E::AssociateTime, &E::SetAssociateTime},
+        Time<E, std::optional<Timestamp>>{"disassociate-time", &E::DisassociateTime, &E::SetDisassociateTime},
+    };
+};
+
+template <>
+struct Schema<ParticipantSessionAssociation>
+{
+    using E = ParticipantSessionAssociation;
+
+    static constexpr std::string_view element = "participantsessionassoc";
+    static constexpr std::tuple attributes{
+        Attribute<E>{"participant_id", &E::ParticipantId, &E::SetParticipant, false},
+        Attribute<E>{"session_id", &E::SessionId, &E::SetSession, false},
+    };
+    static constexpr std::tuple children{
+        Time<E, Timestamp>{"associate-time", &E::AssociateTime, &E::SetAssociateTime},
+        Time<E, std::optional<Timestamp>>{"disassociate-time", &E::DisassociateTime, &E::SetDisassociateTime},
+        TextList<E>{"param", &E::Params, &E::AddParam},
+    };
+};
+
+/**
+ * @brief Stream associations are grouped into one element per participant, with a child per direction
+ */
+template <>
+struct Schema<ParticipantStreamAssociation>
+{
+    static constexpr std::string_view element = "participantstreamassoc";
+    static constexpr std::string_view participant = "participant_id";
+    static constexpr std::string_view send = "send";
+    static constexpr std::string_view recv = "recv";
+
+    enum Child : std::size_t
+    {
+        Send,
+        Recv,
+    };
+    static constexpr std::array children{send, recv};
+};
+
+/**
+ * @brief The recording element holds its own fields and the elements of every other type
+ */
+template <>
+struct Schema<RecordingSession>
+{
+    static constexpr std::string_view element = "recording";
+    static constexpr std::string_view xmlns = "urn:ietf:params:xml:ns:recording:1";
+    static constexpr std::string_view data_mode = "datamode";
+    static constexpr std::string_view start_time = "start-time";
+    static constexpr std::string_view end_time = "end-time";
+
+    enum Child : std::size_t
+    {
+        DataMode,
+        StartTime,
+        EndTime,
+        Group,
+        Session,
+        Stream,
+        Participant,
+        SessionRecordingAssoc,
+        ParticipantSessionAssoc,
+        ParticipantStreamAssoc,
+    };
+    static constexpr std::array children{
+        data_mode,
+        start_time,
+        end_time,
+        Schema<CommunicationSessionGroup>::element,
+        Schema<CommunicationSession>::element,
+        Schema<MediaStream>::element,
+        Schema<siprec_metadata::Participant>::element,
+        Schema<CSRSAssociation>::element,
+        Schema<ParticipantSessionAssociation>::element,
+        Schema<ParticipantStreamAssociation>::element,
+    };
+};
+
+/**
+ * @brief Names of the child elements of an element type, in table order
+ *
+ * Element types without fields of their own list the names only, indexed by their Child enumeration.
+ */
+template <typename Entity>
+constexpr auto ChildNames()
+{
+    if constexpr (requires { Schema<Entity>::children.size(); })
+        return Schema<Entity>::children;
+    else
+        return std::apply(
+            [](const auto &...children) {
+                return std::array<std::string_view, sizeof...(children)>{children.name...};
+            },
+            Schema<Entity>::children);
+}
+
+template <typename Entity>
+constexpr std::size_t child_count = std::tuple_size_v<std::remove_const_t<decltype(Schema<Entity>::children)>>;
+
+/**
+ * @brief Perfect hash of the child element names, Find() returns the index of the field in the table
+ */
+template <typename Entity>
+constexpr PerfectHash<child_count<Entity>> child_matcher{ChildNames<Entity>()};
+
+/**
+ * @brief Whether a value is written: optional values when set, strings and lists when not empty
+ */
+template <typename Value>
+bool IsPresent(const Value &value)
+{
+    if constexpr (requires { value.has_value(); })
+        return value.has_value();
+    else if constexpr (requires { value.empty(); })
+        return not value.empty();
+    else
+        return true;
+}
+
+template <typename Value>
+const auto &Unwrap(const Value &value)
+{
+    if constexpr (requires { value.has_value(); })
+        return value.value();
+    else
+        return value;
+}
+
+}  // namespace siprec_metadata::schema
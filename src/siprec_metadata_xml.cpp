@@ -0,0 +1,529 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "siprec_metadata.h"
+#include "siprec_metadata_internal.h"
+#include "siprec_metadata_schema.h"
+
+using namespace siprec_metadata;
+
+/*
+ * XML serializer writing straight into a string
+ *
+ * The output is byte for byte what pugixml produces with "  " indentation: elements with a single text child are
+ * written on one line, elements without children are self-closing, and text and attribute values are escaped with
+ * the same rules. Extension elements are the exception, they are copied unchanged from the parsed document.
+ */
+
+namespace
+{
+enum EscapeClass : uint8_t
+{
+    EscapeText = 1,
+    EscapeAttribute = 2,
+};
+
+// Characters which are escaped in text and attribute values
+constexpr std::array<uint8_t, 256> escape_table = [] {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 32; ++c) {
+        table[c] = EscapeText | EscapeAttribute;
+    }
+    table['\t'] = table['\n'] = table['\r'] = EscapeAttribute;
+    table['&'] = table['<'] = EscapeText | EscapeAttribute;
+    table['>'] = EscapeText;
+    table['"'] = EscapeAttribute;
+    return table;
+}();
+
+template <typename Out>
+class XMLWriter
+{
+   private:
+    Out& out_;
+    int depth_ = 0;
+
+    // Text of the last timestamp written, associations of one session usually share their times
+    std::chrono::sys_seconds time_;
+    std::array<char, Timestamp::rfc3339_max_size> time_text_;
+    std::size_t time_size_ = 0;
+
+    void Indent() { out_.append(2 * depth_, ' '); }
+
+    void Escaped(std::string_view value, uint8_t escape_class)
+    {
+        size_t run = 0;
+        for (size_t i = 0; i < value.size(); ++i) {
+            const auto c = static_cast<uint8_t>(value[i]);
+            if ((escape_table[c] & escape_class) == 0)
+                continue;
+            out_.append(value.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+                case 0:
+                    // Values are C strings for pugixml, so they end at the first NUL
+                    return;
+                case '&':
+                    out_.append("&amp;");
+                    break;
+                case '<':
+                    out_.append("&lt;");
+                    break;
+                case '>':
+                    out_.append("&gt;");
+                    break;
+                case '"':
+                    out_.append("&quot;");
+                    break;
+                default:
+                    out_.append("&#");
+                    out_.push_back(static_cast<char>('0' + c / 10));
+                    out_.push_back(static_cast<char>('0' + c % 10));
+                    out_.push_back(';');
+                    break;
+            }
+        }
+        out_.append(value.data() + run, value.size() - run);
+    }
+
+   public:
+    explicit XMLWriter(Out& out) : out_(out) {}
+
+    // Start tag without the closing bracket, attributes may follow
+    void Open(std::string_view name)
+    {
+        Indent();
+        out_.push_back('<');
+        out_.append(name);
+    }
+
+    void Attribute(std::string_view name, std::string_view value)
+    {
+        out_.push_back(' ');
+        out_.append(name);
+        out_.append("=\"");
+        Escaped(value, EscapeAttribute);
+        out_.push_back('"');
+    }
+
+    // Close the start tag of an element with child elements
+    void BeginChildren()
+    {
+        out_.append(">\n");
+        ++depth_;
+    }
+
+    void Close(std::string_view name)
+    {
+        --depth_;
+        Indent();
+        out_.append("</");
+        out_.append(name);
+        out_.append(">\n");
+    }
+
+    // Close the start tag of an element without children
+    void CloseEmpty() { out_.append(" />\n"); }
+
+    // Close the start tag, write the text and the end tag
+    void CloseWithText(std::string_view name, std::string_view text)
+    {
+        out_.push_back('>');
+        Escaped(text, EscapeText);
+        out_.append("</");
+        out_.append(name);
+        out_.append(">\n");
+    }
+
+    void TextElement(std::string_view name, std::string_view text)
+    {
+        Open(name);
+        CloseWithText(name, text);
+    }
+
+    void TimeElement(std::string_view name, const Timestamp& time)
+    {
+        const auto second = std::chrono::time_point_cast<std::chrono::seconds>(time.time_point());
+        if ((time_size_ == 0) or (second != time_)) {
+            time_ = second;
+            time_size_ = time.to_rfc3339(time_text_.data());
+        }
+        // The text has digits and separators only, nothing to escape
+        Open(name);
+        out_.push_back('>');
+        out_.append(time_text_.data(), time_size_);
+        out_.append("</");
+        out_.append(name);
+        out_.append(">\n");
+    }
+
+    void Extensions(const RawElements& elements)
+    {
+        for (std::size_t i = 0; i < elements.size(); ++i) {
+            Indent();
+            out_.append(elements[i]);
+            out_.push_back('\n');
+        }
+    }
+
+    void Declaration() { out_.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"); }
+};
+
+/**
+ * @brief Upper bound of the size XMLWriter writes, with the markup counted exactly
+ *
+ * Values are counted as if every character was escaped and times at their longest text, so nothing is scanned or
+ * formatted.
+ */
+class XMLSizeBound
+{
+   private:
+    static constexpr std::size_t escape_factor = 6;  // "&quot;" is the longest escape of a character
+
+    std::size_t size_ = 0;
+    int depth_ = 0;
+
+    void Indent() { size_ += 2 * depth_; }
+
+   public:
+    std::size_t Size() const { return size_; }
+
+    void Open(std::string_view name)
+    {
+        Indent();
+        size_ += 1 + name.size();
+    }
+
+    void Attribute(std::string_view name, std::string_view value)
+    {
+        size_ += name.size() + 4 + escape_factor * value.size();
+    }
+
+    void BeginChildren()
+    {
+        size_ += 2;
+        ++depth_;
+    }
+
+    void Close(std::string_view name)
+    {
+        --depth_;
+        Indent();
+        size_ += name.size() + 4;
+    }
+
+    void CloseEmpty() { size_ += 4; }
+
+    void CloseWithText(std::string_view name, std::string_view text)
+    {
+        size_ += 1 + escape_factor * text.size() + name.size() + 4;
+    }
+
+    void TextElement(std::string_view name, std::string_view text)
+    {
+        Open(name);
+        CloseWithText(name, text);
+    }
+
+    void TimeElement(std::string_view name, const Timestamp&)
+    {
+        Open(name);
+        size_ += 1 + Timestamp::rfc3339_max_size + name.size() + 4;
+    }
+
+    void Extensions(const RawElements& elements)
+    {
+        for (std::size_t i = 0; i < elements.size(); ++i) {
+            Indent();
+            size_ += elements[i].size() + 1;
+        }
+    }
+
+    void Declaration() { size_ += std::string_view("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n").size(); }
+};
+
+template <typename Writer, typename Entity>
+void WriteField(Writer& writer, const Entity& element, const schema::Attribute<Entity>& field)
+{
+    writer.Attribute(field.name, (element.*field.get)());
+}
+
+template <typename Writer, typename Entity, typename Value, typename Argument>
+void WriteField(Writer& writer, const Entity& element, const schema::Text<Entity, Value, Argument>& field)
+{
+    const auto& value = (element.*field.get)();
+    if (schema::IsPresent(value))
+        writer.TextElement(field.name, schema::Unwrap(value));
+}
+
+template <typename Writer, typename Entity, typename Value>
+void WriteField(Writer& writer, const Entity& element, const schema::Time<Entity, Value>& field)
+{
+    const auto& value = (element.*field.get)();
+    if (schema::IsPresent(value))
+        writer.TimeElement(field.name, schema::Unwrap(value));
+}
+
+template <typename Writer, typename Entity>
+void WriteField(Writer& writer, const Entity& element, const schema::TextList<Entity>& field)
+{
+    for (const auto& value : (element.*field.get)()) {
+        writer.TextElement(field.name, value);
+    }
+}
+
+template <typename Writer>
+void WriteField(Writer& writer, const Participant& participant, const schema::NameIds& field)
+{
+    for (const auto& [name, aor] : participant.NameIds()) {
+        writer.Open(field.name);
+        writer.Attribute(field.aor, aor);
+        if (name.empty()) {
+            writer.CloseEmpty();
+            continue;
+        }
+        writer.BeginChildren();
+        writer.Open(field.display_name);
+        writer.Attribute("xml:lang", field.language);
+        writer.CloseWithText(field.display_name, name);
+        writer.Close(field.name);
+    }
+}
+
+template <typename Entity, typename Field>
+bool IsPresent(const Entity& element, const Field& field)
+{
+    if constexpr (std::is_same_v<Field, schema::NameIds>)
+        return not element.NameIds().empty();
+    else
+        return schema::IsPresent((element.*field.get)());
+}
+
+// Element with the attributes and children of its schema, self-closing if it has no children
+template <typename Writer, typename Entity>
+void WriteXML(Writer& writer, const Entity& element)
+{
+    using Schema = schema::Schema<Entity>;
+
+    writer.Open(Schema::element);
+    if constexpr (requires { Schema::key; })
+        writer.Attribute(Schema::key.name, (element.*Schema::key.get)());
+    std::apply([&](const auto&... attributes) { (WriteField(writer, element, attributes), ...); }, Schema::attributes);
+
+    const bool has_children =
+        not element.Extensions().empty()
+        or std::apply([&](const auto&... children) { return (IsPresent(element, children) or ...); }, Schema::children);
+    if (not has_children) {
+        writer.CloseEmpty();
+        return;
+    }
+    writer.BeginChildren();
+    std::apply([&](const auto&... children) { (WriteField(writer, element, children), ...); }, Schema::children);
+    writer.Extensions(element.Extensions());
+    writer.Close(Schema::element);
+}
+
+// Stream associations are grouped by participant, every participant gets an element even without streams
+template <typename Out, typename Source>
+void WriteStreamAssociations(XMLWriter<Out>& writer, const Source& source)
+{
+    using StreamSchema = schema::Schema<ParticipantStreamAssociation>;
+
+    std::unordered_map<std::string_view, std::vector<const ParticipantStreamAssociation*>> streams_by_participant;
+    for (const auto& assoc : source.ParticipantStreamAssociations()) {
+        if (Deref(assoc).IsSender() or Deref(assoc).IsReceiver())
+            streams_by_participant[Deref(assoc).ParticipantId()].push_back(&Deref(assoc));
+    }
+    for (const auto& participant : source.Participants()) {
+        const auto& extensions = Deref(participant).StreamAssociationExtensions();
+        writer.Open(StreamSchema::element);
+        writer.Attribute(StreamSchema::participant, Deref(participant).ParticipantId());
+        auto assoc_it = streams_by_participant.find(Deref(participant).ParticipantId());
+        if ((assoc_it == streams_by_participant.end()) and extensions.empty()) {
+            writer.CloseEmpty();
+            continue;
+        }
+        writer.BeginChildren();
+        if (assoc_it != streams_by_participant.end()) {
+            for (const auto* assoc : assoc_it->second) {
+                if (assoc->IsSender())
+                    writer.TextElement(StreamSchema::send, assoc->StreamId());
+                if (assoc->IsReceiver())
+                    writer.TextElement(StreamSchema::recv, assoc->StreamId());
+            }
+        }
+        writer.Extensions(extensions);
+        writer.Close(StreamSchema::element);
+    }
+}
+
+// The bound takes every participant element to have children and counts the streams of all of them with the first
+template <typename Source>
+void WriteStreamAssociations(XMLSizeBound& bound, const Source& source)
+{
+    using StreamSchema = schema::Schema<ParticipantStreamAssociation>;
+
+    bool first = true;
+    for (const auto& participant : source.Participants()) {
+        bound.Open(StreamSchema::element);
+        bound.Attribute(StreamSchema::participant, Deref(participant).ParticipantId());
+        bound.BeginChildren();
+        if (first) {
+            for (const auto& assoc : source.ParticipantStreamAssociations()) {
+                if (Deref(assoc).IsSender())
+                    bound.TextElement(StreamSchema::send, Deref(assoc).StreamId());
+                if (Deref(assoc).IsReceiver())
+                    bound.TextElement(StreamSchema::recv, Deref(assoc).StreamId());
+            }
+            first = false;
+        }
+        bound.Extensions(Deref(participant).StreamAssociationExtensions());
+        bound.Close(StreamSchema::element);
+    }
+}
+
+// Serialize either a recording session or its snapshot
+template <typename Writer, typename Source>
+void WriteDocument(Writer& writer, const Source& source)
+{
+    using Schema = schema::Schema<RecordingSession>;
+
+    writer.Declaration();
+    writer.Open(Schema::element);
+    writer.Attribute("xmlns", Schema::xmlns);
+    for (const auto& [name, value] : source.Attributes()) {
+        writer.Attribute(name, value);
+    }
+    writer.BeginChildren();
+
+    writer.TextElement(Schema::data_mode, source.DataMode());
+    if (source.StartTime())
+        writer.TimeElement(Schema::start_time, source.StartTime().value());
+    if (source.EndTime())
+        writer.TimeElement(Schema::end_time, source.EndTime().value());
+
+    for (const auto& group : source.Groups()) {
+        WriteXML(writer, Deref(group));
+    }
+    for (const auto& session : source.CommSessions()) {
+        WriteXML(writer, Deref(session));
+    }
+    for (const auto& participant : source.Participants()) {
+        WriteXML(writer, Deref(participant));
+    }
+    for (const auto& stream : source.MediaStreams()) {
+        WriteXML(writer, Deref(stream));
+    }
+    for (const auto& assoc : source.CS_RS_Associations()) {
+        WriteXML(writer, Deref(assoc));
+    }
+    for (const auto& assoc : source.ParticipantSessionAssociations()) {
+        WriteXML(writer, Deref(assoc));
+    }
+
+    WriteStreamAssociations(writer, source);
+
+    writer.Extensions(source.Extensions());
+    writer.Close(Schema::element);
+}
+}  // namespace
+
+void RecordingSession::AppendXML(std::string& out) const
+{
+    XMLWriter writer(out);
+    WriteDocument(writer, *this);
+}
+
+std::string RecordingSession::ToXML() const
+{
+    std::string out;
+    AppendXML(out);
+    return out;
+}
+
+std::size_t RecordingSession::EstimatedXMLSize() const
+{
+    XMLSizeBound bound;
+    WriteDocument(bound, *this);
+    return bound.Size();
+}
+
+std::vector<RecordingSession::XMLRange> RecordingSession::ToXMLBatch(
+    std::span<const RecordingSession* const> sessions, std::string& out, unsigned shards)
+{
+    std::vector<XMLRange> ranges(sessions.size());
+    shards = static_cast<unsigned>(std::clamp<size_t>(shards, 1, std::max<size_t>(sessions.size(), 1)));
+
+    // Serialize sessions [first, last) into the buffer, ranges are offsets into that buffer
+    auto serialize = [&](size_t first, size_t last, std::string& buffer) {
+        for (size_t i = first; i < last; ++i) {
+            const size_t offset = buffer.size();
+            sessions[i]->AppendXML(buffer);
+            ranges[i] = XMLRange{offset, buffer.size() - offset};
+        }
+    };
+
+    if (shards == 1) {
+        serialize(0, sessions.size(), out);
+        return ranges;
+    }
+
+    // Contiguous shards are serialized in parallel into their own buffers and appended in order
+    std::vector<std::string> buffers(shards);
+    std::vector<std::thread> threads;
+    threads.reserve(shards - 1);
+    const size_t per_shard = (sessions.size() + shards - 1) / shards;
+    for (unsigned shard = 1; shard < shards; ++shard) {
+        const size_t first = std::min(sessions.size(), shard * per_shard);
+        const size_t last = std::min(sessions.size(), first + per_shard);
+        threads.emplace_back(serialize, first, last, std::ref(buffers[shard]));
+    }
+    serialize(0, std::min(sessions.size(), per_shard), buffers[0]);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t total = 0;
+    for (const auto& buffer : buffers) {
+        total += buffer.size();
+    }
+    out.reserve(out.size() + total);
+    for (unsigned shard = 0; shard < shards; ++shard) {
+        const size_t shard_offset = out.size();
+        const size_t first = std::min(sessions.size(), shard * per_shard);
+        const size_t last = std::min(sessions.size(), first + per_shard);
+        for (size_t i = first; i < last; ++i) {
+            ranges[i].offset += shard_offset;
+        }
+        out.append(buffers[shard]);
+    }
+    return ranges;
+}
+
+void RecordingSessionSnapshot::AppendXML(std::string& out) const
+{
+    XMLWriter writer(out);
+    WriteDocument(writer, *this);
+}
+
+std::string RecordingSessionSnapshot::ToXML() const
+{
+    std::string out;
+    AppendXML(out);
+    return out;
+}
+
+std::size_t RecordingSessionSnapshot::EstimatedXMLSize() const
+{
+    XMLSizeBound bound;
+    WriteDocument(bound, *this);
+    return bound.Size();
+}
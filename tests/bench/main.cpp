@@ -0,0 +1,137 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "siprec_metadata.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+// Conference with a mixer stream received by everybody and two streams sent by each participant
+RecordingSession MakeConference(int participant_count)
+{
+    RecordingSession recording_session;
+    recording_session.SetStartTime(Timestamp::now());
+
+    auto& group = recording_session.AddGroup();
+    group.SetAssociateTime(Timestamp::now());
+
+    auto& comm_session = recording_session.AddCommSession();
+    comm_session.AddSipSessionId("ab30317f1a784dc48ff824d0d3715d86;remote=47755a9de7794ba387653f2099600ef2");
+    recording_session.AddAssociation(group, comm_session);
+    recording_session.AddAssociation(comm_session).SetAssociateTime(Timestamp::now());
+
+    auto& mixer = recording_session.AddStream();
+    mixer.SetLabel("mixer");
+    recording_session.AddAssociation(comm_session, mixer);
+
+    for (int i = 0; i < participant_count; ++i) {
+        auto& participant = recording_session.AddParticipant();
+        participant.AddNameId("Participant " + std::to_string(i), "sip:user" + std::to_string(i) + "@example.com");
+        recording_session.AddAssociation(comm_session, participant).SetAssociateTime(Timestamp::now());
+
+        for (int j = 0; j < 2; ++j) {
+            auto& stream = recording_session.AddStream();
+            stream.SetLabel(std::to_string(2 * i + j));
+            stream.SetContentType(j == 0 ? "main" : "slides");
+            recording_session.AddAssociation(comm_session, stream);
+            recording_session.AddAssociation(participant, stream, true, false);
+        }
+        recording_session.AddAssociation(participant, mixer, false, true);
+    }
+
+    return recording_session;
+}
+
+template <typename Function>
+void Measure(const char* name, int iterations, Function function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        function();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::printf("  %-24s %12.1f us/op\n", name, static_cast<double>(ns) / iterations / 1000.0);
+}
+
+void Check(bool condition)
+{
+    if (not condition) {
+        std::fprintf(stderr, "benchmark round trip failed\n");
+        std::exit(1);
+    }
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    const int iterations = (argc > 1) ? std::atoi(argv[1]) : 200;
+
+    for (const int participant_count : {2, 20, 200}) {
+        const auto recording_session = MakeConference(participant_count);
+        const std::string xml = recording_session.ToXML();
+        const std::string json = recording_session.ToJSON();
+        const std::string binary = recording_session.ToBinary();
+
+        std::printf("%d participants: XML %zu bytes, JSON %zu bytes, binary %zu bytes\n", participant_count,
+                    xml.size(), json.size(), binary.size());
+
+        Measure("ToXML", iterations, [&] { Check(not recording_session.ToXML().empty()); });
+        Measure("FromXML", iterations, [&] {
+            RecordingSession parsed;
+            Check(parsed.FromXML(xml));
+        });
+        Measure("ToJSON", iterations, [&] { Check(not recording_session.ToJSON().empty()); });
+        Measure("FromJSON", iterations, [&] {
+            RecordingSession parsed;
+            Check(parsed.FromJSON(json));
+        });
+        Measure("ToBinary", iterations, [&] { Check(not recording_session.ToBinary().empty()); });
+        Measure("FromBinary", iterations, [&] {
+            RecordingSession parsed;
+            Check(parsed.FromBinary(binary));
+        });
+    }
+
+    // Batches of many documents, per document
+    {
+        constexpr int batch_size = 1000;
+        const auto recording_session = MakeConference(20);
+        const std::string xml = recording_session.ToXML();
+        const std::vector<std::string_view> batch(batch_size, xml);
+        const std::vector<const RecordingSession*> sessions(batch_size, &recording_session);
+        std::string out;
+
+        std::printf("batch of %d documents, 20 participants\n", batch_size);
+        const auto per_document = [&](const char* name, auto function) {
+            function();  // warm up buffers
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            std::printf("  %-24s %12.1f us/op\n", name, static_cast<double>(ns) / batch_size / 1000.0);
+        };
+        per_document("ParseBatch 1 thread", [&] { Check(RecordingSession::ParseBatch(batch, 1).back().has_value()); });
+        per_document("ParseBatch all threads", [&] { Check(RecordingSession::ParseBatch(batch).back().has_value()); });
+        per_document("ToXML per session", [&] {
+            for (const auto* session : sessions) {
+                Check(not session->ToXML().empty());
+            }
+        });
+        per_document("ToXMLBatch 1 shard", [&] {
+            out.clear();
+            Check(RecordingSession::ToXMLBatch(sessions, out).size() == sessions.size());
+        });
+        per_document("ToXMLBatch 4 shards", [&] {
+            out.clear();
+            Check(RecordingSession::ToXMLBatch(sessions, out, 4).size() == sessions.size());
+        });
+    }
+
+    return 0;
+}
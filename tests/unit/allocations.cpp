@@ -0,0 +1,139 @@
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "siprec_metadata.h"
+
+using namespace siprec_metadata;
+
+// Every allocation of the test binary goes through these to be counted
+namespace
+{
+thread_local std::size_t allocation_count = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++allocation_count;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+std::string MakeDocument(int count)
+{
+    RecordingSession recording_session;
+    for (int i = 0; i < count; ++i) {
+        auto& session = recording_session.AddCommSession("session-" + std::to_string(i));
+        session.SetReason("transferred by the attendant console");
+        session.AddSipSessionId("ab30317f1a784dc48ff824d0d3715d86;remote=47755a9de7794ba387653f2099600ef2");
+        auto& participant = recording_session.AddParticipant("participant-" + std::to_string(i));
+        participant.AddNameId("Alice", "sip:alice@atlanta.com");
+        recording_session.AddAssociation(session, participant).AddParam("a parameter longer than the small buffer");
+    }
+    return recording_session.ToXML();
+}
+
+std::size_t ParseAllocations(const std::string& xml)
+{
+    RecordingSession recording_session;
+    const std::size_t before = allocation_count;
+    EXPECT_TRUE(recording_session.FromXML(xml));
+    return allocation_count - before;
+}
+}  // namespace
+
+TEST(Allocations, FromXMLPerEntity)
+{
+    constexpr int count = 1000;
+    const std::string xml = MakeDocument(count);
+    const std::string double_xml = MakeDocument(2 * count);
+
+    // Strings are interned once and shared from then on, so the documents are parsed once beforehand
+    RecordingSession interned;
+    ASSERT_TRUE(interned.FromXML(double_xml));
+
+    // Reading the associate-time from the text of the element allocates a string for it and whatever the string
+    // stream of the standard library needs, which is counted separately
+    const std::string time = Timestamp::now().to_rfc3339();
+    const std::size_t before = allocation_count;
+    Timestamp::from_rfc3339(time.c_str());
+    const std::size_t per_time = allocation_count - before;
+
+    // Per session: the list node, the reason and a node and a string for its SIP session id. Per participant: the
+    // list node and a nameID node. Per association: the list node and a node and a string for the parameter. The
+    // pages of the parser add less than one per entity.
+    const std::size_t per_entity = (ParseAllocations(double_xml) - ParseAllocations(xml)) / count;
+    ASSERT_LE(per_entity, 4 + 2 + 3 + per_time);
+}
+
+TEST(Allocations, AddAssociation)
+{
+    RecordingSession recording_session;
+    auto& session = recording_session.AddCommSession("s");
+    auto& participant = recording_session.AddParticipant("p");
+    auto& stream = recording_session.AddStream("st");
+
+    // One list node each, the ids are interned already
+    std::size_t before = allocation_count;
+    recording_session.AddAssociation(session, participant);
+    ASSERT_EQ(allocation_count - before, 1);
+    before = allocation_count;
+    recording_session.AddAssociation(session);
+    ASSERT_EQ(allocation_count - before, 1);
+    before = allocation_count;
+    recording_session.AddAssociation(participant, stream, true, false);
+    ASSERT_EQ(allocation_count - before, 1);
+}
+
+TEST(Allocations, ReserveAndEstimatedXMLSize)
+{
+    // Elements added to indexes that are up to date are indexed in place, tables reserved for them never rehash
+    auto build = [](bool reserve) {
+        RecordingSession recording_session;
+        if (reserve)
+            recording_session.Reserve(ElementCounts{.participants = 1000, .participant_session_associations = 1000});
+        auto& session = recording_session.AddCommSession("s");
+        recording_session.FindCommSession("s");
+        const std::size_t before = allocation_count;
+        for (int i = 0; i < 1000; ++i) {
+            recording_session.AddAssociation(session, recording_session.AddParticipant("p" + std::to_string(i)));
+        }
+        return allocation_count - before;
+    };
+    ASSERT_LT(build(true), build(false));
+
+    // The bound is counted from the elements, without building or formatting anything
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(MakeDocument(100)));
+    auto& stream = recording_session.AddStream("mixed");
+    for (int i = 0; i < 100; ++i) {
+        auto& participant = recording_session.AddParticipant("listener-" + std::to_string(i));
+        recording_session.AddAssociation(participant, stream, false, true);
+    }
+    const std::string xml = recording_session.ToXML();
+    const std::size_t before = allocation_count;
+    ASSERT_GE(recording_session.EstimatedXMLSize(), xml.size());
+    ASSERT_EQ(allocation_count - before, 0);
+}
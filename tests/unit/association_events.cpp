@@ -0,0 +1,77 @@
+#include <string>
+#include <vector>
+
+#include "association_events.h"
+#include "gtest/gtest.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+RecordingSession MakeCall()
+{
+    RecordingSession recording_session;
+    auto& comm_session = recording_session.AddCommSession("session");
+    recording_session.AddAssociation(comm_session).SetAssociateTime(Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    auto& participant = recording_session.AddParticipant("bob");
+    auto& ps_assoc = recording_session.AddAssociation(comm_session, participant);
+    ps_assoc.SetAssociateTime(Timestamp::from_rfc3339("2024-05-06T10:00:01Z"));
+    ps_assoc.SetDisassociateTime(Timestamp::from_rfc3339("2024-05-06T10:05:00Z"));
+    auto& stream = recording_session.AddStream("audio");
+    recording_session.AddAssociation(participant, stream, true, false);
+    return recording_session;
+}
+}  // namespace
+
+TEST(AssociationEventExporter, Lines)
+{
+    std::string output;
+    {
+        AssociationEventExporter exporter([&](std::string_view lines) {
+            output.append(lines);
+            return true;
+        });
+        ASSERT_TRUE(exporter.Export(MakeCall(), "call-\"1\""));
+    }
+
+    const std::string expected =
+        R"({"recording":"call-\"1\"","event":"associate","kind":"session_recording","time":"2024-05-06T10:00:00Z",)"
+        R"("session_id":"session"})"
+        "\n"
+        R"({"recording":"call-\"1\"","event":"associate","kind":"participant_session","time":"2024-05-06T10:00:01Z",)"
+        R"("participant_id":"bob","session_id":"session"})"
+        "\n"
+        R"({"recording":"call-\"1\"","event":"disassociate","kind":"participant_session",)"
+        R"("time":"2024-05-06T10:05:00Z","participant_id":"bob","session_id":"session"})"
+        "\n"
+        R"({"recording":"call-\"1\"","event":"associate","kind":"participant_stream","time":"1970-01-01T00:00:00Z",)"
+        R"("participant_id":"bob","stream_id":"audio","send":true,"recv":false})"
+        "\n";
+    ASSERT_EQ(output, expected);
+}
+
+TEST(AssociationEventExporter, BoundedBuffer)
+{
+    const auto recording_session = MakeCall();
+    std::vector<size_t> chunk_sizes;
+    AssociationEventExporter exporter(
+        [&](std::string_view lines) {
+            EXPECT_EQ(lines.back(), '\n');
+            chunk_sizes.push_back(lines.size());
+            return (chunk_sizes.size() < 5);
+        },
+        1000);
+
+    // The sink refuses the fifth chunk, which stops the export
+    bool exported = true;
+    for (int i = 0; exported and (i < 1000); ++i) {
+        exported = exporter.Export(*recording_session.Snapshot(), "call-" + std::to_string(i));
+    }
+    ASSERT_FALSE(exported);
+    ASSERT_EQ(chunk_sizes.size(), 5);
+    for (const auto size : chunk_sizes) {
+        ASSERT_GE(size, 1000);
+        ASSERT_LT(size, 1500);
+    }
+    ASSERT_FALSE(exporter.Flush());
+}
@@ -0,0 +1,96 @@
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "columnar_export.h"
+#include "gtest/gtest.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+class ColumnarExportTest : public ::testing::Test
+{
+   protected:
+    std::filesystem::path path_ = std::filesystem::temp_directory_path() / "siprec_metadata_columnar_test.srmc";
+
+    void SetUp() override { std::filesystem::remove(path_); }
+    void TearDown() override { std::filesystem::remove(path_); }
+};
+
+RecordingSession MakeCall(int stream_count)
+{
+    RecordingSession recording_session;
+    auto& comm_session = recording_session.AddCommSession();
+    auto& participant = recording_session.AddParticipant();
+    participant.AddNameId("Bob", "sip:bob@biloxi.com");
+    auto& assoc = recording_session.AddAssociation(comm_session, participant);
+    assoc.SetAssociateTime(Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    for (int i = 0; i < stream_count; ++i) {
+        auto& stream = recording_session.AddStream();
+        if (i % 2 == 0)
+            stream.SetContentType("audio/opus");
+        recording_session.AddAssociation(participant, stream, true, i == 0);
+    }
+    return recording_session;
+}
+}  // namespace
+
+TEST_F(ColumnarExportTest, WriteAndScanColumns)
+{
+    ColumnarExporter exporter;
+    for (int i = 0; i < 10; ++i) {
+        exporter.Add(MakeCall(i % 4), "call-" + std::to_string(i));
+    }
+    ASSERT_EQ(exporter.Rows("participants"), 10);
+    ASSERT_EQ(exporter.Rows("streams"), 13);
+    ASSERT_EQ(exporter.Rows("no such table"), 0);
+    ASSERT_TRUE(exporter.Write(path_.string()));
+
+    ColumnarReader reader;
+    ASSERT_TRUE(reader.Open(path_.string()));
+    ASSERT_EQ(reader.Tables().size(), 6);
+
+    // Count streams per content type
+    std::vector<std::uint32_t> codes;
+    std::vector<std::string> dictionary;
+    ASSERT_TRUE(reader.ReadCodes("streams", "content_type", codes));
+    ASSERT_TRUE(reader.ReadDictionary("streams", "content_type", dictionary));
+    ASSERT_EQ(dictionary, std::vector<std::string>{"audio/opus"});
+    std::map<std::string, int> per_content_type;
+    for (const auto code : codes) {
+        per_content_type[(code == null_string_code) ? "" : dictionary.at(code)]++;
+    }
+    ASSERT_EQ(per_content_type, (std::map<std::string, int>{{"", 4}, {"audio/opus", 9}}));
+
+    // Recording keys repeat within a table and are stored once
+    ASSERT_TRUE(reader.ReadDictionary("participant_stream_associations", "recording", dictionary));
+    ASSERT_EQ(dictionary.size(), 7);
+
+    std::vector<std::int64_t> times;
+    ASSERT_TRUE(reader.ReadTimes("participant_session_associations", "associate_time", times));
+    ASSERT_EQ(times.size(), 10);
+    ASSERT_EQ(times.front(), 1714989600ll * 1000000000ll);
+    ASSERT_TRUE(reader.ReadTimes("participant_session_associations", "disassociate_time", times));
+    ASSERT_EQ(times.front(), null_time);
+
+    std::vector<bool> recv;
+    ASSERT_TRUE(reader.ReadBools("participant_stream_associations", "recv", recv));
+    ASSERT_EQ(std::count(recv.begin(), recv.end(), true), 7);
+
+    // Columns are typed
+    ASSERT_FALSE(reader.ReadTimes("streams", "content_type", times));
+    ASSERT_FALSE(reader.ReadCodes("streams", "no such column", codes));
+}
+
+TEST_F(ColumnarExportTest, RejectsTruncatedFile)
+{
+    ColumnarExporter exporter;
+    exporter.Add(MakeCall(3), "call");
+    ASSERT_TRUE(exporter.Write(path_.string()));
+    std::filesystem::resize_file(path_, std::filesystem::file_size(path_) - 1);
+
+    ColumnarReader reader;
+    ASSERT_FALSE(reader.Open(path_.string()));
+}
@@ -0,0 +1,101 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lazy_recording_session.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+RecordingSession MakeRecording()
+{
+    RecordingSession recording_session;
+    recording_session.SetDataMode("partial");
+    recording_session.SetStartTime(Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    auto& comm_session = recording_session.AddCommSession();
+    comm_session.AddSipSessionId("ab30317f1a784dc48ff824d0d3715d86;remote=47755a9de7794ba387653f2099600ef2");
+    auto& alice = recording_session.AddParticipant("a&b <\"alice\">");
+    alice.AddNameId("Alice & Co", "sip:alice@atlanta.com");
+    auto& bob = recording_session.AddParticipant();
+    bob.AddNameId("Bob", "sip:bob@biloxi.com");
+    recording_session.AddAssociation(comm_session, alice);
+    recording_session.AddAssociation(comm_session, bob);
+    for (int i = 0; i < 3; ++i) {
+        auto& stream = recording_session.AddStream();
+        stream.SetSessionId(comm_session.SessionId());
+        stream.SetLabel("label-" + std::to_string(i));
+        recording_session.AddAssociation(i == 0 ? alice : bob, stream, true, i != 0);
+    }
+    return recording_session;
+}
+}  // namespace
+
+TEST(LazyRecordingSession, MatchesFullParse)
+{
+    const RecordingSession recording_session = MakeRecording();
+    const std::string xml = recording_session.ToXML();
+
+    LazyRecordingSession lazy;
+    ASSERT_TRUE(lazy.Parse(xml));
+    ASSERT_EQ(lazy.DataMode(), "partial");
+    ASSERT_EQ(lazy.StartTime(), recording_session.StartTime());
+    ASSERT_FALSE(lazy.EndTime());
+
+    ASSERT_EQ(lazy.ParticipantIds().size(), 2);
+    ASSERT_EQ(lazy.ParticipantIds().front(), "a&b <\"alice\">");
+    for (const auto& participant : recording_session.Participants()) {
+        const Participant* decoded = lazy.FindParticipant(participant.ParticipantId());
+        ASSERT_NE(decoded, nullptr);
+        ASSERT_EQ(*decoded, participant);
+        ASSERT_EQ(lazy.FindParticipant(participant.ParticipantId()), decoded);
+    }
+    ASSERT_EQ(lazy.StreamIds().size(), 3);
+    for (const auto& stream : recording_session.MediaStreams()) {
+        const MediaStream* decoded = lazy.FindStream(stream.StreamId());
+        ASSERT_NE(decoded, nullptr);
+        ASSERT_EQ(*decoded, stream);
+    }
+    const auto& comm_session = recording_session.CommSessions().front();
+    ASSERT_EQ(lazy.CommSessionIds(), std::vector<std::string_view>{comm_session.SessionId()});
+    ASSERT_NE(lazy.FindCommSession(comm_session.SessionId()), nullptr);
+    ASSERT_EQ(*lazy.FindCommSession(comm_session.SessionId()), comm_session);
+    ASSERT_EQ(lazy.FindParticipant("no such participant"), nullptr);
+
+    RecordingSession full;
+    ASSERT_TRUE(lazy.ToRecordingSession(full));
+    ASSERT_EQ(full, recording_session);
+}
+
+TEST(LazyRecordingSession, ScanDocument)
+{
+    LazyRecordingSession lazy;
+    ASSERT_TRUE(lazy.Parse("\xEF\xBB\xBF<?xml version=\"1.0\"?>\n<!-- comment <recording> -->\n"
+                           "<recording xmlns='urn:ietf:params:xml:ns:recording:1'>"
+                           "<datamode><!-- first --><![CDATA[partial]]></datamode>"
+                           "<datamode>complete</datamode>"
+                           "<end-time>\r\n2024-05-06T10:00:00Z\r\n</end-time>"
+                           "<participant participant_id = 'p&#49;&#x32;'/>"
+                           "<participant participant_id=\"q\">"
+                           "<nameID aor=\"sip:q@example.com\"><name>Q</name></nameID>"
+                           "</participant>"
+                           "</recording>"));
+    ASSERT_EQ(lazy.DataMode(), "partial");
+    ASSERT_EQ(lazy.EndTime(), Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    ASSERT_EQ(lazy.ParticipantIds(), (std::vector<std::string_view>{"p12", "q"}));
+    ASSERT_NE(lazy.FindParticipant("p12"), nullptr);
+    ASSERT_NE(lazy.FindParticipant("q"), nullptr);
+    ASSERT_EQ(lazy.FindParticipant("q")->NameIds().front().second, "sip:q@example.com");
+
+    ASSERT_TRUE(lazy.Parse("<recording/>"));
+    ASSERT_EQ(lazy.DataMode(), "complete");
+    ASSERT_TRUE(lazy.ParticipantIds().empty());
+
+    ASSERT_FALSE(lazy.Parse(""));
+    ASSERT_FALSE(lazy.Parse("<session/>"));
+    ASSERT_FALSE(lazy.Parse("<recording><participant></stream></recording>"));
+    ASSERT_FALSE(lazy.Parse("<recording><participant participant_id=\"p\">"));
+    ASSERT_FALSE(lazy.Parse("<recording><!-- unterminated </recording>"));
+    ASSERT_FALSE(lazy.Parse("<recording><participant participant_id=p/></recording>"));
+}
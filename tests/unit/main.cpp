@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <thread>
+
 #include "gtest/gtest.h"
 #include "siprec_metadata.h"
+#include "siprec_metadata_schema.h"
 
 using namespace siprec_metadata;
 
@@ -127,3 +131,809 @@ TEST(SiprecMetadata, Base)
 
     ASSERT_EQ(recording_session, recording_session_new);
 }
+
+TEST(SiprecMetadata, FromXMLFailureLeavesSessionUntouched)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    const RecordingSession recording_session_copy = recording_session;
+
+    // The stream without session_id is rejected after the group and the session have already been parsed
+    const std::string broken_xml = R"x(<?xml version="1.0" encoding="UTF-8"?>
+<recording xmlns="urn:ietf:params:xml:ns:recording:1">
+  <datamode>partial</datamode>
+  <group group_id="0Z8W5kcgQ1mYqL2CG6mQfw==" />
+  <session session_id="CIcFKtD0QSyg2yBbgVgRbg==" />
+  <stream stream_id="cfIQrjy0Sce0eCkLZmQjDA==" />
+</recording>
+)x";
+    ASSERT_FALSE(recording_session.FromXML(broken_xml));
+
+    ASSERT_EQ(recording_session.DataMode(), "complete");
+    ASSERT_EQ(recording_session.Groups().size(), 1);
+    ASSERT_EQ(recording_session.CommSessions().size(), 1);
+    ASSERT_EQ(recording_session, recording_session_copy);
+}
+
+TEST(SiprecMetadata, ValidateReportsEveryIssue)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    ASSERT_TRUE(recording_session.Validate().empty());
+
+    auto& orphan_session = recording_session.AddCommSession("orphan-session");
+    orphan_session.SetGroupRef("missing-group");
+    recording_session.AddStream("orphan-stream").SetSessionId("missing-session");
+    recording_session.AddParticipant("srfBElmCRp2QB23b7Mpk0w==");
+    auto& ghost = recording_session.AddParticipant("ghost");
+    MediaStream missing_stream{"missing-stream"};
+    recording_session.AddAssociation(ghost, missing_stream, true, false);
+    auto& ps_assoc = recording_session.AddAssociation(orphan_session, ghost);
+    ps_assoc.SetAssociateTime("2010-12-16T23:41:07Z");
+    ps_assoc.SetDisassociateTime("2010-12-16T23:40:00Z");
+
+    using Kind = ValidationIssue::Kind;
+    const std::vector<ValidationIssue> expected = {
+        {Kind::DuplicateId, "participant", "srfBElmCRp2QB23b7Mpk0w==", "srfBElmCRp2QB23b7Mpk0w=="},
+        {Kind::MissingGroup, "session", "orphan-session", "missing-group"},
+        {Kind::MissingSession, "stream", "orphan-stream", "missing-session"},
+        {Kind::DisassociateBeforeAssociate, "participantsessionassoc", "ghost", ""},
+        {Kind::MissingStream, "participantstreamassoc", "ghost", "missing-stream"},
+    };
+    ASSERT_EQ(recording_session.Validate(), expected);
+}
+
+TEST(SiprecMetadata, SnapshotSharesUnmodifiedElements)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    auto& stream = recording_session.AddStream("g5b0Tp1vQ8a0Uf6Y3m2xVw==");
+    stream.SetSessionId("hVpd7YQgRW2nD22h7q60JQ==");
+    stream.SetLabel("100");
+
+    auto snapshot = recording_session.Snapshot();
+    const std::string snapshot_xml = snapshot->ToXML();
+    ASSERT_EQ(snapshot_xml, recording_session.ToXML());
+
+    stream.SetLabel("101");
+    auto& participant = recording_session.AddParticipant("Q3ywTnXtRBKO9iXXbmWjyw==");
+    participant.AddNameId("Alice", "sip:alice@atlanta.com");
+
+    auto next_snapshot = recording_session.Snapshot();
+    ASSERT_EQ(next_snapshot->Participants().size(), 3);
+    ASSERT_EQ(next_snapshot->MediaStreams().back()->Label(), "101");
+
+    // The old snapshot is unaffected by the modifications
+    ASSERT_EQ(snapshot->Participants().size(), 2);
+    ASSERT_EQ(snapshot->MediaStreams().back()->Label(), "100");
+    ASSERT_EQ(snapshot->ToXML(), snapshot_xml);
+
+    // Only the modified and the new elements are copied
+    ASSERT_NE(next_snapshot->MediaStreams().back(), snapshot->MediaStreams().back());
+    for (std::size_t i = 0; i + 1 < snapshot->MediaStreams().size(); ++i) {
+        ASSERT_EQ(next_snapshot->MediaStreams()[i], snapshot->MediaStreams()[i]);
+    }
+    ASSERT_EQ(next_snapshot->Participants()[0], snapshot->Participants()[0]);
+    ASSERT_EQ(next_snapshot->Participants()[1], snapshot->Participants()[1]);
+    ASSERT_EQ(next_snapshot->CommSessions()[0], snapshot->CommSessions()[0]);
+    ASSERT_EQ(next_snapshot->ParticipantStreamAssociations(), snapshot->ParticipantStreamAssociations());
+}
+
+TEST(SiprecMetadata, BinaryRoundTrip)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    recording_session.SetStartTime(Timestamp::now());
+    auto& session = recording_session.AddCommSession();
+    session.SetReason("transfer");
+    session.SetStopTime(Timestamp::now());
+    auto& participant = recording_session.AddParticipant("raw participant id");
+    auto& stream = recording_session.AddStream();
+    stream.SetContentType("video/h264");
+    recording_session.AddAssociation(session, stream);
+    auto& ps_assoc = recording_session.AddAssociation(session, participant);
+    ps_assoc.AddParam("role=moderator");
+    ps_assoc.SetDisassociateTime(Timestamp::now());
+    recording_session.AddAssociation(participant, stream, true, true);
+
+    const std::string binary = recording_session.ToBinary();
+    ASSERT_LT(binary.size(), recording_session.ToXML().size() / 3);
+
+    RecordingSession recording_session_new;
+    ASSERT_TRUE(recording_session_new.FromBinary(binary));
+    ASSERT_EQ(recording_session_new, recording_session);
+    ASSERT_EQ(recording_session_new.StartTime(), recording_session.StartTime());
+    ASSERT_EQ(recording_session_new.ToXML(), recording_session.ToXML());
+
+    // Truncated input is rejected and leaves the session untouched
+    for (std::size_t size = 0; size < binary.size(); ++size) {
+        RecordingSession truncated;
+        ASSERT_FALSE(truncated.FromBinary(std::string_view(binary).substr(0, size)));
+        ASSERT_TRUE(truncated.CommSessions().empty());
+    }
+}
+
+TEST(SiprecMetadata, ParseBatch)
+{
+    const std::string broken_xml = "<recording><stream /></recording>";
+    std::vector<std::string_view> xml_contents;
+    for (int i = 0; i < 100; ++i) {
+        xml_contents.push_back((i % 7 == 3) ? std::string_view(broken_xml) : std::string_view(base_xml_etalon));
+    }
+
+    RecordingSession expected;
+    ASSERT_TRUE(expected.FromXML(base_xml_etalon));
+    for (const unsigned threads : {1u, 4u, 0u}) {
+        const auto results = RecordingSession::ParseBatch(xml_contents, threads);
+        ASSERT_EQ(results.size(), xml_contents.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (i % 7 == 3) {
+                ASSERT_FALSE(results[i].has_value());
+            } else {
+                ASSERT_TRUE(results[i].has_value());
+                ASSERT_EQ(*results[i], expected);
+            }
+        }
+    }
+    ASSERT_TRUE(RecordingSession::ParseBatch({}).empty());
+}
+
+TEST(SiprecMetadata, ToXMLBatch)
+{
+    std::vector<RecordingSession> recording_sessions(10);
+    std::vector<const RecordingSession*> pointers;
+    for (size_t i = 0; i < recording_sessions.size(); ++i) {
+        ASSERT_TRUE(recording_sessions[i].FromXML(base_xml_etalon));
+        for (size_t j = 0; j < i; ++j) {
+            recording_sessions[i].AddParticipant().AddNameId("", "sip:a&b<c>\"d\"@example.com");
+        }
+        pointers.push_back(&recording_sessions[i]);
+    }
+
+    for (const unsigned shards : {1u, 3u, 16u}) {
+        std::string out = "prefix";
+        const auto ranges = RecordingSession::ToXMLBatch(pointers, out, shards);
+        ASSERT_EQ(ranges.size(), recording_sessions.size());
+        ASSERT_TRUE(out.starts_with("prefix"));
+        ASSERT_EQ(ranges.front().offset, 6);
+        ASSERT_EQ(ranges.back().offset + ranges.back().length, out.size());
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            ASSERT_EQ(out.substr(ranges[i].offset, ranges[i].length), recording_sessions[i].ToXML());
+        }
+    }
+}
+
+TEST(SiprecMetadata, JSONRoundTrip)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    auto& participant = recording_session.AddParticipant();
+    participant.AddNameId("Quote \" backslash \\ tab \t bell \x07 ünïcode", "sip:alice@atlanta.com");
+    auto& stream = recording_session.AddStream();
+    stream.SetContentType("video/h264");
+    recording_session.AddAssociation(participant, stream, false, true);
+    recording_session.AddAssociation(recording_session.CommSessions().front(), participant).AddParam("a=b");
+
+    const std::string json = recording_session.ToJSON();
+    RecordingSession recording_session_new;
+    ASSERT_TRUE(recording_session_new.FromJSON(json));
+    ASSERT_EQ(recording_session_new, recording_session);
+    ASSERT_EQ(recording_session_new.ToJSON(), json);
+    ASSERT_EQ(recording_session.Snapshot()->ToJSON(), json);
+
+    // Escapes, unknown members and whitespace
+    RecordingSession parsed;
+    ASSERT_TRUE(parsed.FromJSON(R"({ "datamode" : "partial", "version": [1, {"x": null}, -2.5e3, true],
+        "participants": [ {"participant_id": "pé😀", "name_ids": [{"aor": "sip:\/x"}]} ] })"));
+    ASSERT_EQ(parsed.DataMode(), "partial");
+    ASSERT_EQ(parsed.Participants().front().ParticipantId(), "p\xc3\xa9\xf0\x9f\x98\x80");
+    ASSERT_EQ(parsed.Participants().front().NameIds().front().second, "sip:/x");
+
+    // Malformed documents leave the session untouched
+    const RecordingSession parsed_copy = parsed;
+    for (const std::string_view broken :
+         {R"({"participants": [{"name_ids": []}]})", R"({"datamode": "complete")", R"({"datamode": "\ud83d"})",
+          R"({"streams": [{"stream_id": "s"}]})", R"({} trailing)", R"({"sessions": [{"session_id": "s"},]})"}) {
+        ASSERT_FALSE(parsed.FromJSON(broken)) << broken;
+    }
+    ASSERT_EQ(parsed, parsed_copy);
+}
+
+TEST(SiprecMetadata, ToDOT)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    auto& participant = recording_session.AddParticipant();
+    participant.AddNameId("Carol", "sip:\"carol\"@example.com");
+    recording_session.AddAssociation(recording_session.CommSessions().front(), participant)
+        .SetDisassociateTime("2010-12-16T23:45:00Z");
+
+    const std::string dot = recording_session.ToDOT();
+    ASSERT_TRUE(dot.starts_with("digraph RecordingSession {\n"));
+    ASSERT_TRUE(dot.ends_with("}\n"));
+    ASSERT_TRUE(
+        dot.contains(R"("group:7+OTCyoxTmqmqyA/1weDAg==" -> "session:hVpd7YQgRW2nD22h7q60JQ==" [label="group"];)"));
+    ASSERT_TRUE(dot.contains(R"("recording" -> "session:hVpd7YQgRW2nD22h7q60JQ==" [label="recorded"];)"));
+    ASSERT_TRUE(dot.contains(
+        R"("participant:srfBElmCRp2QB23b7Mpk0w==" -> "stream:UAAMm5GRQKSCMVvLyl4rFw==" [label="send"];)"));
+    ASSERT_TRUE(dot.contains(
+        R"("stream:UAAMm5GRQKSCMVvLyl4rFw==" -> "participant:zSfPoSvdSDCmU3A3TRDxAw==" [label="recv"];)"));
+    ASSERT_TRUE(dot.contains(R"(label="participant\nsip:\"carol\"@example.com"];)"));
+    ASSERT_TRUE(dot.contains(R"([label="participant", style=dashed];)"));
+    // Header, 10 nodes, 17 edges and the closing brace
+    ASSERT_EQ(std::ranges::count(dot, '\n'), 3 + 10 + 17 + 1);
+
+    std::string streamed;
+    ASSERT_TRUE(recording_session.ToDOT([&](std::string_view chunk) {
+        streamed.append(chunk);
+        return true;
+    }));
+    ASSERT_EQ(streamed, dot);
+    ASSERT_FALSE(recording_session.ToDOT([](std::string_view) { return false; }));
+}
+
+TEST(SiprecMetadata, QueryIndexes)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    const std::string session_id = "hVpd7YQgRW2nD22h7q60JQ==";
+    const std::string bob_id = "srfBElmCRp2QB23b7Mpk0w==";
+
+    const Participant* bob = recording_session.FindParticipant(bob_id);
+    ASSERT_NE(bob, nullptr);
+    ASSERT_EQ(recording_session.FindParticipant("missing"), nullptr);
+    ASSERT_EQ(recording_session.FindStream("UAAMm5GRQKSCMVvLyl4rFw==")->Label(), "96");
+    ASSERT_EQ(recording_session.FindCommSession(session_id), &recording_session.CommSessions().front());
+
+    const auto by_aor = recording_session.ParticipantsByAoR("sip:bob@biloxi.com");
+    ASSERT_EQ(by_aor.size(), 1);
+    ASSERT_EQ(&by_aor.front(), bob);
+    ASSERT_EQ(recording_session.ParticipantsByName("Paul").front().ParticipantId(), "zSfPoSvdSDCmU3A3TRDxAw==");
+    ASSERT_TRUE(recording_session.ParticipantsByName("Alice").empty());
+
+    std::vector<std::string> labels;
+    for (const auto& stream : recording_session.StreamsSentBy(bob_id)) {
+        labels.push_back(stream.Label());
+    }
+    ASSERT_EQ(labels, (std::vector<std::string>{"96", "97"}));
+    ASSERT_EQ(recording_session.StreamsReceivedBy(bob_id)[1].Label(), "99");
+    ASSERT_EQ(recording_session.SessionParticipants(session_id).size(), 2);
+    ASSERT_EQ(recording_session.SessionStreams(session_id).size(), 4);
+    const auto sessions = recording_session.SessionsBySipSessionId(
+        "ab30317f1a784dc48ff824d0d3715d86;remote=47755a9de7794ba387653f2099600ef2");
+    ASSERT_EQ(sessions.size(), 1);
+    ASSERT_EQ(sessions.front().SessionId(), session_id);
+
+    // Changes made through element references are picked up by the next query
+    auto& alice = recording_session.AddParticipant();
+    ASSERT_TRUE(recording_session.ParticipantsByAoR("sip:alice@atlanta.com").empty());
+    alice.AddNameId("Alice", "sip:alice@atlanta.com");
+    alice.AddNameId("Alice", "sip:alice@atlanta.com");
+    ASSERT_EQ(recording_session.ParticipantsByAoR("sip:alice@atlanta.com").size(), 1);
+    auto& stream = recording_session.AddStream();
+    recording_session.AddAssociation(alice, stream, true, false);
+    recording_session.AddAssociation(recording_session.CommSessions().front(), alice);
+    ASSERT_EQ(recording_session.StreamsSentBy(alice.ParticipantId()).front().StreamId(), stream.StreamId());
+    ASSERT_EQ(recording_session.SessionParticipants(session_id).size(), 3);
+    ASSERT_EQ(recording_session.SessionStreams(session_id).size(), 4);
+    stream.SetSessionId(session_id);
+    ASSERT_EQ(recording_session.SessionStreams(session_id).size(), 5);
+
+    // Copies have indexes of their own
+    RecordingSession copy = recording_session;
+    copy.AddParticipant().AddNameId("", "sip:carol@example.com");
+    ASSERT_EQ(copy.ParticipantsByAoR("sip:carol@example.com").size(), 1);
+    ASSERT_TRUE(recording_session.ParticipantsByAoR("sip:carol@example.com").empty());
+    ASSERT_NE(copy.FindParticipant(alice.ParticipantId()), &alice);
+    ASSERT_EQ(&copy.ParticipantsByAoR("sip:alice@atlanta.com").front(), copy.FindParticipant(alice.ParticipantId()));
+}
+
+// Indexes updated in place answer like indexes built from scratch for a copy, in any order once elements are removed
+void ExpectIndexesMatchRebuilt(const RecordingSession& recording_session)
+{
+    const RecordingSession rebuilt = recording_session;
+    auto ids = [](const auto& range, auto id) {
+        std::vector<std::string> result;
+        for (const auto& element : range) {
+            result.push_back(id(element));
+        }
+        std::ranges::sort(result);
+        return result;
+    };
+    auto participant_id = [](const Participant& participant) { return participant.ParticipantId(); };
+    auto stream_id = [](const MediaStream& stream) { return stream.StreamId(); };
+
+    for (const auto& participant : rebuilt.Participants()) {
+        const auto& id = participant.ParticipantId();
+        EXPECT_EQ(ids(recording_session.StreamsSentBy(id), stream_id), ids(rebuilt.StreamsSentBy(id), stream_id));
+        EXPECT_EQ(ids(recording_session.StreamsReceivedBy(id), stream_id),
+                  ids(rebuilt.StreamsReceivedBy(id), stream_id));
+        for (const auto& [name, aor] : participant.NameIds()) {
+            EXPECT_EQ(ids(recording_session.ParticipantsByAoR(aor), participant_id),
+                      ids(rebuilt.ParticipantsByAoR(aor), participant_id));
+            EXPECT_EQ(ids(recording_session.ParticipantsByName(name), participant_id),
+                      ids(rebuilt.ParticipantsByName(name), participant_id));
+        }
+    }
+    for (const auto& session : rebuilt.CommSessions()) {
+        const auto& id = session.SessionId();
+        EXPECT_EQ(ids(recording_session.SessionParticipants(id), participant_id),
+                  ids(rebuilt.SessionParticipants(id), participant_id));
+        EXPECT_EQ(ids(recording_session.SessionStreams(id), stream_id), ids(rebuilt.SessionStreams(id), stream_id));
+    }
+}
+
+TEST(SiprecMetadata, RemoveAndDisassociate)
+{
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(base_xml_etalon));
+    const std::string session_id = "hVpd7YQgRW2nD22h7q60JQ==";
+    const std::string bob_id = "srfBElmCRp2QB23b7Mpk0w==";
+    const std::string paul_id = "zSfPoSvdSDCmU3A3TRDxAw==";
+    auto& alice = recording_session.AddParticipant();
+    alice.AddNameId("Alice", "sip:alice@atlanta.com");
+    auto& stream = recording_session.AddStream();
+    stream.SetSessionId(session_id);
+    recording_session.AddAssociation(alice, stream, true, false);
+    recording_session.AddAssociation(recording_session.CommSessions().front(), alice);
+    const std::string alice_id = alice.ParticipantId();
+    ExpectIndexesMatchRebuilt(recording_session);
+
+    ASSERT_FALSE(recording_session.RemoveParticipant("missing"));
+    ASSERT_TRUE(recording_session.RemoveParticipant(recording_session.FindParticipant(bob_id)->ParticipantId()));
+    ASSERT_EQ(recording_session.FindParticipant(bob_id), nullptr);
+    ASSERT_TRUE(recording_session.ParticipantsByAoR("sip:bob@biloxi.com").empty());
+    ASSERT_TRUE(recording_session.StreamsSentBy(bob_id).empty());
+    ASSERT_EQ(recording_session.ParticipantSessionAssociations().size(), 2);
+    ASSERT_EQ(recording_session.ParticipantStreamAssociations().size(), 5);
+    ASSERT_EQ(recording_session.SessionParticipants(session_id).size(), 2);
+    ExpectIndexesMatchRebuilt(recording_session);
+
+    ASSERT_TRUE(recording_session.RemoveStream("UAAMm5GRQKSCMVvLyl4rFw=="));
+    ASSERT_EQ(recording_session.StreamsReceivedBy(paul_id).size(), 1);
+    ASSERT_EQ(recording_session.SessionStreams(session_id).size(), 4);
+    ASSERT_TRUE(recording_session.RemoveParticipantStreamAssociation(paul_id, "8zc6e0lYTlWIINA6GR+3ag=="));
+    ASSERT_FALSE(recording_session.RemoveParticipantStreamAssociation(paul_id, "8zc6e0lYTlWIINA6GR+3ag=="));
+    ASSERT_EQ(recording_session.StreamsSentBy(paul_id).size(), 1);
+    ExpectIndexesMatchRebuilt(recording_session);
+
+    // Ended associations are kept and still answer queries
+    const Timestamp left = Timestamp::from_rfc3339("2010-12-16T23:50:00Z");
+    ASSERT_TRUE(recording_session.DisassociateParticipant(alice_id, left));
+    ASSERT_FALSE(recording_session.DisassociateParticipant(alice_id, left));
+    for (const auto& assoc : recording_session.ParticipantStreamAssociations()) {
+        ASSERT_EQ(assoc.DisassociateTime().has_value(), assoc.ParticipantId() == alice_id);
+    }
+    ASSERT_EQ(recording_session.StreamsSentBy(alice_id).size(), 1);
+    ASSERT_TRUE(recording_session.DisassociateCommSession(session_id, left));
+    ASSERT_EQ(recording_session.CS_RS_Associations().front().DisassociateTime(), left);
+    for (const auto& assoc : recording_session.ParticipantSessionAssociations()) {
+        ASSERT_EQ(assoc.DisassociateTime(), left);
+    }
+    ASSERT_TRUE(recording_session.Validate().empty());
+    ExpectIndexesMatchRebuilt(recording_session);
+
+    ASSERT_TRUE(recording_session.RemoveParticipantSessionAssociation(paul_id, session_id));
+    ASSERT_EQ(recording_session.SessionParticipants(session_id).size(), 1);
+    ASSERT_TRUE(recording_session.RemoveCommSession(session_id));
+    ASSERT_TRUE(recording_session.CommSessions().empty());
+    ASSERT_TRUE(recording_session.MediaStreams().empty());
+    ASSERT_TRUE(recording_session.CS_RS_Associations().empty());
+    ASSERT_TRUE(recording_session.ParticipantSessionAssociations().empty());
+    ASSERT_TRUE(recording_session.ParticipantStreamAssociations().empty());
+    ASSERT_EQ(recording_session.Participants().size(), 2);
+    ASSERT_TRUE(recording_session.Validate().empty());
+    ExpectIndexesMatchRebuilt(recording_session);
+}
+
+TEST(SiprecMetadata, IndexesUpdatedInPlace)
+{
+    RecordingSession recording_session;
+    auto& session = recording_session.AddCommSession("s1");
+    auto& alice = recording_session.AddParticipant("alice");
+    ASSERT_EQ(recording_session.FindParticipant("alice"), &alice);
+
+    // Keys added to the last elements
+    alice.AddNameId("Alice", "sip:alice@atlanta.com");
+    session.AddSipSessionId("call-1");
+    auto& first_stream = recording_session.AddStream("st1");
+    first_stream.SetSessionId("s1");
+    recording_session.AddAssociation(alice, first_stream, true, false);
+    recording_session.AddAssociation(session, alice);
+    ExpectIndexesMatchRebuilt(recording_session);
+    ASSERT_EQ(recording_session.SessionsBySipSessionId("call-1").size(), 1);
+
+    // Keys added to earlier elements and associations made before their participant
+    auto& second_stream = recording_session.AddStream("st2");
+    second_stream.SetSessionId("s1");
+    auto& bob = recording_session.AddParticipant("bob");
+    bob.AddNameId("Bob", "sip:bob@biloxi.com");
+    ASSERT_EQ(recording_session.FindStream("st2"), &second_stream);
+    alice.AddNameId("Alice", "sip:alice@example.com");
+    first_stream.SetSessionId("s2");
+    recording_session.AddCommSession("s2").AddSipSessionId("call-2");
+    session.AddSipSessionId("call-2");
+    ExpectIndexesMatchRebuilt(recording_session);
+    ASSERT_EQ(recording_session.SessionsBySipSessionId("call-2").size(), 2);
+    ASSERT_EQ(recording_session.ParticipantsByAoR("sip:alice@example.com").size(), 1);
+
+    ASSERT_EQ(recording_session.StreamsSentBy("carol").size(), 0);
+    auto& carol_stream = recording_session.AddStream("st3");
+    recording_session.AddAssociation(recording_session.AddParticipant("carol"), carol_stream, false, true);
+    ASSERT_EQ(recording_session.StreamsReceivedBy("carol").size(), 1);
+    recording_session.AddAssociation(session, recording_session.AddParticipant("dave"));
+    ASSERT_EQ(recording_session.SessionParticipants("s1").size(), 2);
+    ExpectIndexesMatchRebuilt(recording_session);
+}
+
+TEST(SiprecMetadata, RemoveCommSessionWithDuplicateStreams)
+{
+    RecordingSession recording_session;
+    auto& session = recording_session.AddCommSession("s");
+    auto& participant = recording_session.AddParticipant("p");
+    for (int i = 0; i < 2; ++i) {
+        auto& stream = recording_session.AddStream("st");
+        recording_session.AddAssociation(session, stream);
+    }
+    recording_session.AddAssociation(participant, recording_session.MediaStreams().front(), true, true);
+    ASSERT_EQ(recording_session.SessionStreams("s").size(), 2);
+
+    ASSERT_TRUE(recording_session.RemoveCommSession("s"));
+    ASSERT_TRUE(recording_session.MediaStreams().empty());
+    ASSERT_TRUE(recording_session.ParticipantStreamAssociations().empty());
+    ASSERT_TRUE(recording_session.StreamsSentBy("p").empty());
+    ASSERT_TRUE(recording_session.Validate().empty());
+    ExpectIndexesMatchRebuilt(recording_session);
+}
+
+TEST(SiprecMetadata, RemoveFromLargeSession)
+{
+    RecordingSession recording_session;
+    auto& session = recording_session.AddCommSession("s");
+    auto& mixed = recording_session.AddStream("mixed");
+    mixed.SetSessionId("s");
+    for (int i = 0; i < 1000; ++i) {
+        auto& participant = recording_session.AddParticipant("p" + std::to_string(i));
+        participant.AddNameId("Guest " + std::to_string(i), "sip:" + std::to_string(i) + "@example.com");
+        auto& stream = recording_session.AddStream("st" + std::to_string(i));
+        stream.SetSessionId("s");
+        recording_session.AddAssociation(session, participant);
+        recording_session.AddAssociation(participant, stream, true, false);
+        recording_session.AddAssociation(participant, mixed, false, true);
+    }
+    auto addresses = [](const auto& range) {
+        std::vector<const void*> result;
+        for (const auto& element : range) {
+            result.push_back(&element);
+        }
+        std::ranges::sort(result);
+        return result;
+    };
+    auto participants = addresses(recording_session.SessionParticipants("s"));
+    const Participant* removed = recording_session.FindParticipant("p500");
+    const Participant* kept = recording_session.FindParticipant("p999");
+
+    // Entries of the other elements stay as they were
+    ASSERT_TRUE(recording_session.RemoveParticipant("p500"));
+    std::erase(participants, removed);
+    ASSERT_EQ(addresses(recording_session.SessionParticipants("s")), participants);
+    ASSERT_TRUE(recording_session.ParticipantsByAoR("sip:500@example.com").empty());
+    ASSERT_EQ(recording_session.ParticipantsByName("Guest 999").size(), 1);
+    ASSERT_EQ(recording_session.SessionStreams("s").size(), 1001);
+    ASSERT_EQ(recording_session.FindParticipant("p999"), kept);
+    ASSERT_EQ(recording_session.StreamsSentBy("p999").front().StreamId(), "st999");
+    ASSERT_EQ(recording_session.StreamsReceivedBy("p999").front().StreamId(), "mixed");
+    ExpectIndexesMatchRebuilt(recording_session);
+
+    ASSERT_TRUE(recording_session.RemoveStream("mixed"));
+    ASSERT_TRUE(recording_session.StreamsReceivedBy("p999").empty());
+    ASSERT_EQ(recording_session.StreamsSentBy("p999").front().StreamId(), "st999");
+    ASSERT_EQ(addresses(recording_session.SessionParticipants("s")), participants);
+    ASSERT_EQ(recording_session.SessionStreams("s").size(), 1000);
+    ExpectIndexesMatchRebuilt(recording_session);
+
+    // Associations stay with the next element of the same id
+    auto& duplicate = recording_session.AddParticipant("p999");
+    ASSERT_TRUE(recording_session.RemoveParticipant("p999"));
+    ASSERT_EQ(recording_session.FindParticipant("p999"), &duplicate);
+    ASSERT_EQ(recording_session.SessionParticipants("s").size(), 999);
+    const auto session_participants = addresses(recording_session.SessionParticipants("s"));
+    ASSERT_NE(std::ranges::find(session_participants, &duplicate), session_participants.end());
+    ASSERT_EQ(recording_session.StreamsSentBy("p999").front().StreamId(), "st999");
+    ExpectIndexesMatchRebuilt(recording_session);
+}
+
+TEST(SiprecMetadata, Merge)
+{
+    RecordingSession recording_session;
+    auto& participant = recording_session.AddParticipant();
+    participant.AddNameId("Bob", "sip:bob@biloxi.com");
+    auto& stream = recording_session.AddStream();
+    recording_session.AddAssociation(participant, stream, true, false);
+
+    // Replace the participant, the stream and their association, add a new stream
+    RecordingSession delta;
+    delta.SetDataMode("partial");
+    delta.SetEndTime(Timestamp::from_rfc3339("2024-05-06T10:30:00Z"));
+    auto& changed = delta.AddParticipant(participant.ParticipantId());
+    changed.AddNameId("Robert", "sip:robert@biloxi.com");
+    delta.AddStream(stream.StreamId());
+    auto& new_stream = delta.AddStream();
+    delta.AddAssociation(changed, stream, true, true);
+
+    recording_session.Merge(delta);
+    ASSERT_EQ(recording_session.Participants().size(), 1);
+    ASSERT_EQ(recording_session.Participants().front().NameIds().size(), 1);
+    ASSERT_EQ(recording_session.Participants().front().NameIds().front().second, "sip:robert@biloxi.com");
+    ASSERT_EQ(recording_session.MediaStreams().size(), 2);
+    ASSERT_EQ(recording_session.MediaStreams().back().StreamId(), new_stream.StreamId());
+    ASSERT_EQ(recording_session.ParticipantStreamAssociations().size(), 1);
+    ASSERT_TRUE(recording_session.ParticipantStreamAssociations().front().IsReceiver());
+    ASSERT_TRUE(recording_session.EndTime().has_value());
+    ASSERT_EQ(recording_session.DataMode(), "partial");
+    ASSERT_TRUE(recording_session.Check());
+}
+
+TEST(SiprecMetadata, InternedStrings)
+{
+    const std::size_t pool_size = InternedString::PoolSize();
+    {
+        RecordingSession first;
+        RecordingSession second;
+        ASSERT_TRUE(first.FromXML(base_xml_etalon));
+        ASSERT_TRUE(second.FromXML(base_xml_etalon));
+
+        // Equal ids, AoRs and labels are stored once, within a session and across sessions
+        const auto& participant = first.Participants().front();
+        ASSERT_EQ(&participant.ParticipantId(), &second.Participants().front().ParticipantId());
+        ASSERT_EQ(&participant.ParticipantId(), &first.ParticipantStreamAssociations().front().ParticipantId());
+        ASSERT_EQ(&participant.NameIds().front().second.str(),
+                  &second.Participants().front().NameIds().front().second.str());
+        ASSERT_EQ(&first.MediaStreams().front().SessionId(), &first.CommSessions().front().SessionId());
+        ASSERT_EQ(first, second);
+
+        // 1 group, 1 session, 2 participants, 2 names, 2 AoRs, 4 streams and 4 labels
+        ASSERT_EQ(InternedString::PoolSize(), pool_size + 16);
+    }
+    ASSERT_EQ(InternedString::PoolSize(), pool_size);
+
+    const InternedString aor("sip:alice@atlanta.com");
+    ASSERT_EQ(aor, InternedString(std::string("sip:alice@atlanta.com")));
+    ASSERT_EQ(aor, "sip:alice@atlanta.com");
+    ASSERT_NE(aor, InternedString("sip:bob@biloxi.com"));
+    ASSERT_TRUE(InternedString("").empty());
+
+    // Handles are taken and dropped concurrently while the last one is released
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 10000; ++i) {
+                const InternedString handle("sip:" + std::to_string(i % 7) + "@example.com");
+                const InternedString copy = handle;
+                ASSERT_EQ(copy.str(), handle.str());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(InternedString::PoolSize(), pool_size + 1);
+}
+
+TEST(SiprecMetadata, ExtensionsRoundTrip)
+{
+    const std::string participant_extension = R"x(<extensiondata xmlns:v="urn:vendor">
+        <v:tag note="a > b" other='"quoted"'><![CDATA[<not an element>]]></v:tag>
+        <!-- </extensiondata> -->
+        <v:empty/>
+      </extensiondata>)x";
+    const std::string xml = R"x(<?xml version="1.0" encoding="UTF-8"?>
+<recording xmlns="urn:ietf:params:xml:ns:recording:1" xmlns:ac="urn:vendor:ac">
+  <datamode>complete</datamode>
+  <group group_id="g"><v:state xmlns:v="urn:vendor">open</v:state></group>
+  <session session_id="s"><sipSessionID>abc</sipSessionID><v:call xmlns:v="urn:vendor" id="7"/></session>
+  <participant participant_id="p">
+    <nameID aor="sip:alice@atlanta.com"><name>Alice</name></nameID>
+    )x" + participant_extension + R"x(
+  </participant>
+  <stream stream_id="st" session_id="s"><label>1</label><extensiondata>x &amp; y</extensiondata></stream>
+  <sessionrecordingassoc session_id="s">
+    <associate-time>2024-05-06T10:00:00Z</associate-time><ext/>
+  </sessionrecordingassoc>
+  <participantsessionassoc participant_id="p" session_id="s">
+    <associate-time>2024-05-06T10:00:00Z</associate-time><ext a="1"></ext>
+  </participantsessionassoc>
+  <participantstreamassoc participant_id="p"><send>st</send><ac:stream-extension>x</ac:stream-extension>
+  </participantstreamassoc>
+  <extensiondata><recorder>vendor</recorder></extensiondata>
+  <ac:recording-extension/>
+</recording>)x";
+
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(xml));
+    ASSERT_EQ(recording_session.Groups().front().Extensions()[0], R"x(<v:state xmlns:v="urn:vendor">open</v:state>)x");
+    ASSERT_EQ(recording_session.CommSessions().front().Extensions()[0], R"x(<v:call xmlns:v="urn:vendor" id="7"/>)x");
+    const auto& participant = recording_session.Participants().front();
+    ASSERT_EQ(participant.NameIds().size(), 1);
+    ASSERT_EQ(participant.Extensions().size(), 1);
+    ASSERT_EQ(participant.Extensions()[0], participant_extension);
+    ASSERT_EQ(recording_session.MediaStreams().front().Extensions()[0], "<extensiondata>x &amp; y</extensiondata>");
+    ASSERT_EQ(recording_session.CS_RS_Associations().front().Extensions()[0], "<ext/>");
+    ASSERT_EQ(recording_session.ParticipantSessionAssociations().front().Extensions()[0], R"x(<ext a="1"></ext>)x");
+    ASSERT_EQ(participant.StreamAssociationExtensions()[0], "<ac:stream-extension>x</ac:stream-extension>");
+    ASSERT_EQ(recording_session.Extensions().size(), 2);
+    ASSERT_EQ(recording_session.Extensions()[0], "<extensiondata><recorder>vendor</recorder></extensiondata>");
+    ASSERT_EQ(recording_session.Attributes(),
+              (std::list<std::pair<std::string, std::string>>{{"xmlns:ac", "urn:vendor:ac"}}));
+
+    // Extensions are written back unchanged and survive every encoding
+    const std::string written = recording_session.ToXML();
+    ASSERT_NE(written.find(participant_extension), std::string::npos);
+    ASSERT_NE(written.find(R"x(<recording xmlns="urn:ietf:params:xml:ns:recording:1" xmlns:ac="urn:vendor:ac">)x"),
+              std::string::npos);
+    RecordingSession from_xml;
+    ASSERT_TRUE(from_xml.FromXML(written));
+    ASSERT_EQ(from_xml, recording_session);
+    ASSERT_EQ(from_xml.Extensions(), recording_session.Extensions());
+    ASSERT_EQ(from_xml.ToXML(), written);
+
+    RecordingSession from_binary;
+    ASSERT_TRUE(from_binary.FromBinary(recording_session.ToBinary()));
+    ASSERT_EQ(from_binary, recording_session);
+    ASSERT_EQ(from_binary.ToXML(), written);
+
+    RecordingSession from_json;
+    ASSERT_TRUE(from_json.FromJSON(recording_session.ToJSON()));
+    ASSERT_EQ(from_json, recording_session);
+    ASSERT_EQ(from_json.ToXML(), written);
+
+    ASSERT_EQ(recording_session.Snapshot()->ToXML(), written);
+}
+
+TEST(SiprecMetadata, SchemaDrivenParsing)
+{
+    static_assert(schema::child_matcher<CommunicationSession>.Find("group-ref") == 4);
+    static_assert(schema::child_matcher<CommunicationSession>.Find("group") == 5);
+    ASSERT_EQ(schema::child_matcher<ParticipantSessionAssociation>.Find("param"), 2);
+    ASSERT_EQ(schema::child_matcher<MediaStream>.Find(""), 2);
+
+    // Single valued children are taken from their first element, repeated ones are all kept
+    const std::string xml = R"x(<recording xmlns="urn:ietf:params:xml:ns:recording:1">
+  <session session_id="s">
+    <sipSessionID>a</sipSessionID><reason>first</reason><sipSessionID>b</sipSessionID><reason>second</reason>
+  </session>
+  <stream stream_id="st" session_id="s"><content-type>audio</content-type><content-type>video</content-type></stream>
+</recording>)x";
+    RecordingSession recording_session;
+    ASSERT_TRUE(recording_session.FromXML(xml));
+    const auto& session = recording_session.CommSessions().front();
+    ASSERT_EQ(session.Reason(), "first");
+    ASSERT_EQ(session.SipSessionIds(), (std::list<std::string>{"a", "b"}));
+    ASSERT_EQ(recording_session.MediaStreams().front().ContentType(), "audio");
+    ASSERT_TRUE(session.Extensions().empty());
+
+    ASSERT_FALSE(recording_session.FromXML(R"x(<recording><stream stream_id="st"/></recording>)x"));
+
+    // Children of the recording are dispatched in one pass, in any order
+    static_assert(schema::child_matcher<RecordingSession>.Find("participantstreamassoc")
+                  == schema::Schema<RecordingSession>::ParticipantStreamAssoc);
+    const std::string interleaved = R"x(<recording xmlns="urn:ietf:params:xml:ns:recording:1">
+  <participantstreamassoc participant_id="p"><recv>st</recv><ext/><send>st</send></participantstreamassoc>
+  <participant participant_id="p"/>
+  <datamode>partial</datamode>
+  <stream stream_id="st" session_id="s"/>
+  <session session_id="s"/>
+  <datamode>complete</datamode>
+  <participant participant_id="q"/>
+</recording>)x";
+    RecordingSession interleaved_session;
+    ASSERT_TRUE(interleaved_session.FromXML(interleaved));
+    ASSERT_EQ(interleaved_session.DataMode(), "partial");
+    ASSERT_EQ(interleaved_session.Participants().size(), 2);
+    ASSERT_EQ(interleaved_session.Participants().back().ParticipantId(), "q");
+    ASSERT_EQ(interleaved_session.ParticipantStreamAssociations().size(), 1);
+    ASSERT_TRUE(interleaved_session.ParticipantStreamAssociations().front().IsSender());
+    ASSERT_TRUE(interleaved_session.ParticipantStreamAssociations().front().IsReceiver());
+    ASSERT_TRUE(interleaved_session.Extensions().empty());
+    ASSERT_EQ(interleaved_session.Participants().front().StreamAssociationExtensions()[0], "<ext/>");
+}
+
+TEST(SiprecMetadata, TimestampFormatting)
+{
+    using namespace std::chrono;
+
+    ASSERT_EQ(Timestamp::from_rfc3339("2024-02-29T23:59:59Z").to_rfc3339(), "2024-02-29T23:59:59Z");
+    ASSERT_EQ(Timestamp(sys_days(year(1970) / 1 / 1)).to_rfc3339(), "1970-01-01T00:00:00Z");
+    ASSERT_EQ(Timestamp(sys_days(year(1900) / 3 / 1) + 1h + 2min + 3s).to_rfc3339(), "1900-03-01T01:02:03Z");
+    ASSERT_EQ(Timestamp(sys_days(year(2024) / 5 / 6) + 10h + 999ms).to_rfc3339(), "2024-05-06T10:00:00Z");
+
+    char buffer[Timestamp::rfc3339_max_size];
+    const Timestamp time = Timestamp::from_rfc3339("2024-05-06T10:00:00Z");
+    ASSERT_EQ(std::string_view(buffer, time.to_rfc3339(buffer)), "2024-05-06T10:00:00Z");
+    ASSERT_EQ(Timestamp::from_rfc3339(std::string_view("2024-05-06T10:00:00Zjunk").substr(0, 20)), time);
+
+    // Repeated and changing times within one document
+    RecordingSession recording_session;
+    auto& session = recording_session.AddCommSession();
+    for (int i = 0; i < 3; ++i) {
+        auto& participant = recording_session.AddParticipant();
+        auto& assoc = recording_session.AddAssociation(session, participant);
+        assoc.SetAssociateTime(Timestamp(time.time_point() + milliseconds(100 * i)));
+        if (i == 1)
+            assoc.SetDisassociateTime(Timestamp(time.time_point() + 1s));
+    }
+    const std::string xml = recording_session.ToXML();
+    std::size_t count = 0;
+    for (auto pos = xml.find("2024-05-06T10:00:00Z"); pos != std::string::npos;
+         pos = xml.find("2024-05-06T10:00:00Z", pos + 1)) {
+        ++count;
+    }
+    ASSERT_EQ(count, 3);
+    ASSERT_NE(xml.find("<disassociate-time>2024-05-06T10:00:01Z</disassociate-time>"), std::string::npos);
+}
+
+TEST(SiprecMetadata, SettersTakeViewsAndRvalues)
+{
+    // Views into a buffer, as a SIP parser would hand them out
+    const std::string buffer = "p1;sip:alice@atlanta.com;Alice;audio";
+    const std::string_view view = buffer;
+
+    RecordingSession recording_session;
+    auto& participant = recording_session.AddParticipant(view.substr(0, 2));
+    participant.AddNameId(view.substr(25, 5), view.substr(3, 21));
+    ASSERT_EQ(participant.ParticipantId(), "p1");
+    ASSERT_EQ(participant.NameIds().front().first, "Alice");
+    ASSERT_EQ(participant.NameIds().front().second, "sip:alice@atlanta.com");
+    auto& stream = recording_session.AddStream();
+    stream.SetLabel(view.substr(31));
+    stream.SetContentType(view.substr(31));
+    ASSERT_EQ(stream.Label(), "audio");
+
+    // Owned strings are moved in
+    std::string reason = "a reason too long for the small string buffer";
+    const char* reason_data = reason.data();
+    auto& session = recording_session.AddCommSession();
+    session.SetReason(std::move(reason));
+    ASSERT_EQ(session.Reason()->data(), reason_data);
+    std::string sip_session_id(64, 'x');
+    const char* sip_session_id_data = sip_session_id.data();
+    session.AddSipSessionId(std::move(sip_session_id));
+    ASSERT_EQ(session.SipSessionIds().front().data(), sip_session_id_data);
+}
+
+TEST(SiprecMetadata, ReserveAndEstimatedXMLSize)
+{
+    RecordingSession recording_session;
+    recording_session.Reserve(ElementCounts{.comm_sessions = 1,
+                                            .participants = 100,
+                                            .media_streams = 100,
+                                            .participant_session_associations = 100,
+                                            .participant_stream_associations = 100});
+    recording_session.SetStartTime(Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    auto& session = recording_session.AddCommSession();
+    session.SetReason("a <reason> & \"quotes\"");
+    for (int i = 0; i < 100; ++i) {
+        auto& participant = recording_session.AddParticipant("p\"" + std::to_string(i));
+        participant.AddNameId(i % 2 ? "" : "Name & Co", "sip:" + std::to_string(i) + "@example.com");
+        auto& stream = recording_session.AddStream();
+        stream.SetSessionId(session.SessionId());
+        stream.SetLabel(std::string("tab\there\x01"));
+        recording_session.AddAssociation(session, participant);
+        recording_session.AddAssociation(participant, stream, true, i % 3 == 0);
+        ASSERT_EQ(recording_session.FindParticipant(participant.ParticipantId()), &participant);
+    }
+    recording_session.AddExtension("<extensiondata>x</extensiondata>");
+
+    // The size is an upper bound and a buffer reserved for it does not grow
+    const std::string xml = recording_session.ToXML();
+    ASSERT_GE(recording_session.EstimatedXMLSize(), xml.size());
+    ASSERT_EQ(recording_session.Snapshot()->EstimatedXMLSize(), recording_session.EstimatedXMLSize());
+    std::string out;
+    out.reserve(recording_session.EstimatedXMLSize());
+    const std::size_t capacity = out.capacity();
+    recording_session.AppendXML(out);
+    ASSERT_EQ(out.capacity(), capacity);
+    ASSERT_EQ(out, xml);
+
+    ASSERT_GE(RecordingSession().EstimatedXMLSize(), RecordingSession().ToXML().size());
+}
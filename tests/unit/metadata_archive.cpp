@@ -0,0 +1,136 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "metadata_archive.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+RecordingSession MakeCall(const std::string& sip_session_id, const std::string& aor, const std::string& start,
+                          const std::string& end)
+{
+    RecordingSession recording_session;
+    recording_session.SetStartTime(Timestamp::from_rfc3339(start));
+    if (not end.empty())
+        recording_session.SetEndTime(Timestamp::from_rfc3339(end));
+    auto& comm_session = recording_session.AddCommSession();
+    comm_session.AddSipSessionId(sip_session_id);
+    auto& participant = recording_session.AddParticipant();
+    participant.AddNameId("", aor);
+    recording_session.AddAssociation(comm_session, participant);
+    return recording_session;
+}
+
+class MetadataArchiveTest : public ::testing::Test
+{
+   protected:
+    std::filesystem::path path_ = std::filesystem::temp_directory_path() / "siprec_metadata_archive_test.srma";
+
+    void SetUp() override { std::filesystem::remove(path_); }
+    void TearDown() override { std::filesystem::remove(path_); }
+};
+}  // namespace
+
+TEST_F(MetadataArchiveTest, LookupsByKeyAndTime)
+{
+    MetadataArchiveWriter writer;
+    ASSERT_TRUE(writer.Open(path_.string()));
+    ASSERT_TRUE(writer.Append(
+        MakeCall("call-1", "sip:bob@biloxi.com", "2024-05-06T10:00:00Z", "2024-05-06T10:30:00Z")));  // Monday
+    ASSERT_TRUE(writer.Append(
+        MakeCall("call-2", "sip:bob@biloxi.com", "2024-05-07T09:00:00Z", "2024-05-07T09:10:00Z")));  // Tuesday
+    ASSERT_TRUE(writer.Append(
+        MakeCall("call-3", "sip:alice@atlanta.com", "2024-05-07T11:00:00Z", "2024-05-07T12:00:00Z")));
+    ASSERT_TRUE(writer.Close());
+
+    // Reopening continues after the last record
+    ASSERT_TRUE(writer.Open(path_.string()));
+    ASSERT_EQ(writer.Size(), 3);
+    ASSERT_TRUE(writer.Append(MakeCall("call-4", "sip:bob@biloxi.com", "2024-05-07T23:50:00Z", "")));  // ongoing
+    ASSERT_TRUE(writer.Close());
+
+    MetadataArchiveReader reader;
+    ASSERT_TRUE(reader.Open(path_.string()));
+    ASSERT_EQ(reader.Size(), 4);
+
+    const auto tuesday = Timestamp::from_rfc3339("2024-05-07T00:00:00Z");
+    const auto wednesday = Timestamp::from_rfc3339("2024-05-08T00:00:00Z");
+
+    ASSERT_EQ(reader.FindByAor("sip:bob@biloxi.com"), (std::vector<std::size_t>{0, 1, 3}));
+    ASSERT_EQ(reader.FindByAor("sip:bob@biloxi.com", tuesday, wednesday), (std::vector<std::size_t>{1, 3}));
+    ASSERT_EQ(reader.FindByTime(tuesday, wednesday), (std::vector<std::size_t>{1, 2, 3}));
+    ASSERT_EQ(reader.FindByTime(Timestamp::from_rfc3339("2024-05-06T10:20:00Z"),
+                                Timestamp::from_rfc3339("2024-05-06T10:25:00Z")),
+              (std::vector<std::size_t>{0}));
+    ASSERT_EQ(reader.FindBySessionId("call-3"), (std::vector<std::size_t>{2}));
+    ASSERT_TRUE(reader.FindBySessionId("call-5").empty());
+
+    RecordingSession session;
+    ASSERT_TRUE(reader.Read(2, session));
+    ASSERT_EQ(session.CommSessions().front().SipSessionIds().front(), "call-3");
+    ASSERT_EQ(session.Participants().front().NameIds().front().second, "sip:alice@atlanta.com");
+}
+
+TEST_F(MetadataArchiveTest, RecoversIndexWithoutFooter)
+{
+    {
+        MetadataArchiveWriter writer;
+        ASSERT_TRUE(writer.Open(path_.string()));
+        ASSERT_TRUE(writer.Append(MakeCall("call-1", "sip:bob@biloxi.com", "2024-05-06T10:00:00Z", "")));
+        ASSERT_TRUE(writer.Close());
+    }
+    // Cut the footer off as if the writer had crashed
+    std::filesystem::resize_file(path_, std::filesystem::file_size(path_) - 20);
+
+    MetadataArchiveWriter writer;
+    ASSERT_TRUE(writer.Open(path_.string()));
+    ASSERT_EQ(writer.Size(), 1);
+    ASSERT_TRUE(writer.Append(MakeCall("call-2", "sip:bob@biloxi.com", "2024-05-07T10:00:00Z", "")));
+    ASSERT_TRUE(writer.Close());
+
+    MetadataArchiveReader reader;
+    ASSERT_TRUE(reader.Open(path_.string()));
+    ASSERT_EQ(reader.FindByAor("sip:bob@biloxi.com"), (std::vector<std::size_t>{0, 1}));
+}
+
+TEST_F(MetadataArchiveTest, RecoveryKeepsRecordsAfterABadOne)
+{
+    {
+        MetadataArchiveWriter writer;
+        ASSERT_TRUE(writer.Open(path_.string()));
+        ASSERT_TRUE(writer.Append(MakeCall("call-1", "sip:bob@biloxi.com", "2024-05-06T10:00:00Z", "")));
+        ASSERT_TRUE(writer.Append(MakeCall("call-2", "sip:bob@biloxi.com", "2024-05-07T10:00:00Z", "")));
+        ASSERT_TRUE(writer.Append(MakeCall("call-3", "sip:bob@biloxi.com", "2024-05-08T10:00:00Z", "")));
+        ASSERT_TRUE(writer.Close());
+    }
+    const auto size = std::filesystem::file_size(path_);
+    {
+        // Drop the footer and damage the second record
+        std::fstream file(path_, std::ios::in | std::ios::out | std::ios::binary);
+        std::uint32_t length;
+        file.seekg(8);
+        file.read(reinterpret_cast<char*>(&length), sizeof(length));
+        file.seekp(8 + 4 + length + 4);
+        file.put('X');
+    }
+    std::filesystem::resize_file(path_, size - 20);
+
+    MetadataArchiveWriter writer;
+    ASSERT_TRUE(writer.Open(path_.string()));
+    ASSERT_EQ(writer.Size(), 2);
+    ASSERT_TRUE(writer.Append(MakeCall("call-4", "sip:bob@biloxi.com", "2024-05-09T10:00:00Z", "")));
+    ASSERT_TRUE(writer.Close());
+
+    MetadataArchiveReader reader;
+    ASSERT_TRUE(reader.Open(path_.string()));
+    ASSERT_EQ(reader.FindByAor("sip:bob@biloxi.com"), (std::vector<std::size_t>{0, 1, 2}));
+    RecordingSession third;
+    ASSERT_TRUE(reader.Read(1, third));
+    ASSERT_EQ(third.CommSessions().front().SipSessionIds().front(), "call-3");
+    RecordingSession fourth;
+    ASSERT_TRUE(reader.Read(2, fourth));
+    ASSERT_EQ(fourth.CommSessions().front().SipSessionIds().front(), "call-4");
+}
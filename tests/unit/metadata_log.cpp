@@ -0,0 +1,124 @@
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "metadata_log.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+class MetadataLogTest : public ::testing::Test
+{
+   protected:
+    std::filesystem::path path_ = std::filesystem::temp_directory_path() / "siprec_metadata_log_test.srml";
+
+    void SetUp() override { std::filesystem::remove(path_); }
+    void TearDown() override { std::filesystem::remove(path_); }
+};
+}  // namespace
+
+TEST_F(MetadataLogTest, ConcurrentUpdatesAndReplay)
+{
+    constexpr int threads_count = 8;
+    constexpr int updates_per_thread = 50;
+
+    MetadataLog log;
+    ASSERT_TRUE(log.Open(path_.string()));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&, t] {
+            const auto key = "call-" + std::to_string(t);
+            for (int i = 0; i < updates_per_thread; ++i) {
+                RecordingSession delta;
+                delta.AddParticipant().AddNameId("", "sip:" + std::to_string(i) + "@example.com");
+                const auto sequence = log.LogUpdate(key, delta);
+                ASSERT_NE(sequence, 0);
+                ASSERT_TRUE(log.WaitDurable(sequence));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_NE(log.LogRemove("call-0"), 0);
+    ASSERT_TRUE(log.Close());
+
+    std::unordered_map<std::string, RecordingSession> sessions;
+    ASSERT_TRUE(MetadataLog::Replay(path_.string(), sessions));
+    ASSERT_EQ(sessions.size(), threads_count - 1);
+    ASSERT_FALSE(sessions.contains("call-0"));
+    for (const auto& [key, session] : sessions) {
+        ASSERT_EQ(session.Participants().size(), updates_per_thread);
+    }
+}
+
+TEST_F(MetadataLogTest, TornTailIsCutOff)
+{
+    MetadataLog log;
+    ASSERT_TRUE(log.Open(path_.string()));
+    RecordingSession delta;
+    delta.AddCommSession().AddSipSessionId("hVpd7YQgRW2nD22h7q60JQ==");
+    ASSERT_TRUE(log.WaitDurable(log.LogUpdate("call", delta)));
+    ASSERT_TRUE(log.WaitDurable(log.LogUpdate("call", delta)));
+    ASSERT_TRUE(log.Close());
+
+    // Crash in the middle of the second record
+    const auto size = std::filesystem::file_size(path_);
+    std::filesystem::resize_file(path_, size - 3);
+
+    std::unordered_map<std::string, RecordingSession> sessions;
+    ASSERT_TRUE(MetadataLog::Replay(path_.string(), sessions));
+    ASSERT_EQ(sessions["call"].CommSessions().size(), 1);
+
+    // Reopening drops the torn record so new records are readable
+    ASSERT_TRUE(log.Open(path_.string()));
+    RecordingSession other;
+    other.AddCommSession();
+    ASSERT_TRUE(log.WaitDurable(log.LogUpdate("call", other)));
+    ASSERT_TRUE(log.Close());
+
+    sessions.clear();
+    ASSERT_TRUE(MetadataLog::Replay(path_.string(), sessions));
+    ASSERT_EQ(sessions["call"].CommSessions().size(), 2);
+}
+
+TEST_F(MetadataLogTest, ReplayKeepsDataModeChanges)
+{
+    MetadataLog log;
+    ASSERT_TRUE(log.Open(path_.string()));
+    RecordingSession delta;
+    delta.SetDataMode("partial");
+    delta.AddCommSession();
+    ASSERT_NE(log.LogUpdate("call", delta), 0);
+    delta.SetDataMode("complete");
+    ASSERT_TRUE(log.WaitDurable(log.LogUpdate("call", delta)));
+    ASSERT_TRUE(log.Close());
+
+    std::unordered_map<std::string, RecordingSession> sessions;
+    ASSERT_TRUE(MetadataLog::Replay(path_.string(), sessions));
+    ASSERT_EQ(sessions["call"].DataMode(), "complete");
+    ASSERT_EQ(sessions["call"].CommSessions().size(), 1);
+}
+
+TEST_F(MetadataLogTest, ReplayKeepsDataModeOfPlainDeltas)
+{
+    MetadataLog log;
+    ASSERT_TRUE(log.Open(path_.string()));
+    RecordingSession partial;
+    partial.SetDataMode("partial");
+    ASSERT_NE(log.LogUpdate("call", partial), 0);
+
+    // A delta built in code without a data mode leaves the one of the session
+    RecordingSession delta;
+    delta.AddParticipant().AddNameId("Alice", "sip:alice@atlanta.com");
+    ASSERT_TRUE(log.WaitDurable(log.LogUpdate("call", delta)));
+    ASSERT_TRUE(log.Close());
+
+    std::unordered_map<std::string, RecordingSession> sessions;
+    ASSERT_TRUE(MetadataLog::Replay(path_.string(), sessions));
+    ASSERT_EQ(sessions["call"].DataMode(), "partial");
+    ASSERT_EQ(sessions["call"].Participants().size(), 1);
+}
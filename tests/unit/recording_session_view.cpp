@@ -0,0 +1,100 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "recording_session_view.h"
+
+using namespace siprec_metadata;
+
+TEST(RecordingSessionView, MatchesRecordingSession)
+{
+    RecordingSession recording_session;
+    recording_session.SetDataMode("partial");
+    recording_session.SetStartTime(Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    auto& group = recording_session.AddGroup();
+    group.SetAssociateTime(Timestamp::from_rfc3339("2024-05-06T10:00:00Z"));
+    auto& session = recording_session.AddCommSession();
+    session.SetReason("a & b");
+    session.AddSipSessionId("ab30317f1a784dc48ff824d0d3715d86;remote=47755a9de7794ba387653f2099600ef2");
+    session.AddSipSessionId("second");
+    recording_session.AddAssociation(group, session);
+    auto& participant = recording_session.AddParticipant("<alice>");
+    participant.AddNameId("Alice", "sip:alice@atlanta.com");
+    auto& stream = recording_session.AddStream();
+    stream.SetLabel("1");
+    stream.SetContentType("audio");
+    recording_session.AddAssociation(session, stream);
+    recording_session.AddAssociation(session).SetAssociateTime(Timestamp::from_rfc3339("2024-05-06T10:00:01Z"));
+    recording_session.AddAssociation(session, participant).AddParam("p=1");
+    recording_session.AddAssociation(participant, stream, true, true);
+
+    // The document is moved into the view, its buffer stays where it is
+    std::string xml = recording_session.ToXML();
+    const std::string_view buffer(xml.data(), xml.size());
+    RecordingSessionView view;
+    ASSERT_TRUE(view.Parse(std::move(xml)));
+
+    // Values are views into the document, escapes decoded in place
+    auto in_buffer = [&](std::string_view value) {
+        return (value.data() >= buffer.data()) and (value.data() + value.size() <= buffer.data() + buffer.size());
+    };
+    ASSERT_EQ(view.DataMode(), "partial");
+    ASSERT_TRUE(in_buffer(view.DataMode()));
+    ASSERT_EQ(Timestamp::from_rfc3339(view.StartTime()), recording_session.StartTime());
+    ASSERT_TRUE(view.EndTime().empty());
+
+    ASSERT_EQ(view.Groups().size(), 1);
+    ASSERT_EQ(view.Groups()[0].group_id, group.GroupId());
+    ASSERT_EQ(view.Groups()[0].associate_time, "2024-05-06T10:00:00Z");
+    ASSERT_TRUE(view.Groups()[0].disassociate_time.empty());
+
+    ASSERT_EQ(view.CommSessions().size(), 1);
+    const auto& session_view = view.CommSessions()[0];
+    ASSERT_EQ(session_view.session_id, session.SessionId());
+    ASSERT_EQ(session_view.reason, "a & b");
+    ASSERT_TRUE(in_buffer(session_view.reason));
+    ASSERT_EQ(session_view.sip_session_ids, (std::vector<std::string_view>{session.SipSessionIds().front(), "second"}));
+    ASSERT_EQ(session_view.group_ref, group.GroupId());
+
+    ASSERT_EQ(view.Participants().size(), 1);
+    ASSERT_EQ(view.Participants()[0].participant_id, "<alice>");
+    ASSERT_TRUE(in_buffer(view.Participants()[0].participant_id));
+    ASSERT_EQ(view.Participants()[0].name_ids.size(), 1);
+    ASSERT_EQ(view.Participants()[0].name_ids[0].first, "Alice");
+    ASSERT_EQ(view.Participants()[0].name_ids[0].second, "sip:alice@atlanta.com");
+
+    ASSERT_EQ(view.MediaStreams().size(), 1);
+    ASSERT_EQ(view.MediaStreams()[0].stream_id, stream.StreamId());
+    ASSERT_EQ(view.MediaStreams()[0].session_id, session.SessionId());
+    ASSERT_EQ(view.MediaStreams()[0].label, "1");
+    ASSERT_EQ(view.MediaStreams()[0].content_type, "audio");
+
+    ASSERT_EQ(view.CS_RS_Associations().size(), 1);
+    ASSERT_EQ(view.CS_RS_Associations()[0].session_id, session.SessionId());
+    ASSERT_EQ(view.CS_RS_Associations()[0].associate_time, "2024-05-06T10:00:01Z");
+    ASSERT_EQ(view.ParticipantSessionAssociations().size(), 1);
+    ASSERT_EQ(view.ParticipantSessionAssociations()[0].participant_id, "<alice>");
+    ASSERT_EQ(view.ParticipantSessionAssociations()[0].params, std::vector<std::string_view>{"p=1"});
+    ASSERT_EQ(view.ParticipantStreamAssociations().size(), 1);
+    ASSERT_EQ(view.ParticipantStreamAssociations()[0].send, std::vector<std::string_view>{stream.StreamId()});
+    ASSERT_EQ(view.ParticipantStreamAssociations()[0].recv, std::vector<std::string_view>{stream.StreamId()});
+}
+
+TEST(RecordingSessionView, Rejects)
+{
+    RecordingSessionView view;
+    ASSERT_TRUE(view.Parse("<recording/>"));
+    ASSERT_EQ(view.DataMode(), "complete");
+
+    // The first element of a kind counts even when it is empty
+    ASSERT_TRUE(view.Parse("<recording><start-time/><start-time>2024-05-06T10:00:00Z</start-time>"
+                           "<end-time></end-time><end-time>2024-05-06T11:00:00Z</end-time></recording>"));
+    ASSERT_TRUE(view.StartTime().empty());
+    ASSERT_TRUE(view.EndTime().empty());
+
+    ASSERT_FALSE(view.Parse("<session/>"));
+    ASSERT_FALSE(view.Parse("<recording><participant></recording>"));
+    ASSERT_FALSE(view.Parse("<recording><participant participant_id=\"p\"/><stream stream_id=\"s\"/></recording>"));
+    ASSERT_TRUE(view.Participants().empty());
+}
@@ -0,0 +1,105 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "session_registry.h"
+
+using namespace siprec_metadata;
+
+namespace
+{
+RecordingSession MakeCall(const std::string& sip_session_id)
+{
+    RecordingSession recording_session;
+    auto& comm_session = recording_session.AddCommSession();
+    comm_session.AddSipSessionId(sip_session_id);
+    auto& participant = recording_session.AddParticipant();
+    participant.AddNameId("Bob", "sip:bob@biloxi.com");
+    recording_session.AddAssociation(comm_session, participant);
+    return recording_session;
+}
+}  // namespace
+
+TEST(SessionRegistry, InsertFindUpdateEvict)
+{
+    SessionRegistry registry;
+    ASSERT_TRUE(registry.Insert(MakeCall("call-1")));
+    ASSERT_FALSE(registry.Insert(MakeCall("call-1")));
+    ASSERT_FALSE(registry.Insert(RecordingSession{}));
+    ASSERT_EQ(registry.Size(), 1);
+
+    auto found = registry.Find("call-1");
+    ASSERT_TRUE(found.has_value());
+    ASSERT_EQ(found->Participants().size(), 1);
+    ASSERT_FALSE(registry.Find("call-2").has_value());
+
+    // A new SIP session ID added by an update becomes a key of the same recording session
+    ASSERT_TRUE(registry.Update("call-1", [](RecordingSession& session) {
+        session.AddCommSession().AddSipSessionId("call-1-transfer");
+        session.AddParticipant();
+    }));
+    ASSERT_TRUE(registry.Contains("call-1-transfer"));
+    ASSERT_TRUE(registry.Visit("call-1-transfer", [](const RecordingSession& session) {
+        ASSERT_EQ(session.Participants().size(), 2);
+    }));
+
+    auto snapshot = registry.Snapshot("call-1");
+    ASSERT_NE(snapshot, nullptr);
+    ASSERT_EQ(snapshot->CommSessions().size(), 2);
+
+    ASSERT_TRUE(registry.Evict("call-1-transfer"));
+    ASSERT_FALSE(registry.Contains("call-1"));
+    ASSERT_FALSE(registry.Contains("call-1-transfer"));
+    ASSERT_EQ(registry.Size(), 0);
+}
+
+TEST(SessionRegistry, UpdateRekeying)
+{
+    SessionRegistry registry;
+    ASSERT_TRUE(registry.Insert(MakeCall("call-1")));
+    ASSERT_TRUE(registry.Insert(MakeCall("call-2")));
+
+    // An ID of another recording session stays with it, also over later updates
+    auto add_call_2 = [](RecordingSession& session) { session.AddCommSession().AddSipSessionId("call-2"); };
+    ASSERT_TRUE(registry.Update("call-1", add_call_2));
+    ASSERT_TRUE(registry.Update("call-1", [](RecordingSession& session) { session.SetDataMode("partial"); }));
+    ASSERT_EQ(registry.Find("call-2")->CommSessions().size(), 1);
+    ASSERT_EQ(registry.Find("call-1")->CommSessions().size(), 2);
+
+    // Removing every ID evicts the recording session
+    ASSERT_TRUE(registry.Update("call-1", [](RecordingSession& session) { session = RecordingSession(); }));
+    ASSERT_FALSE(registry.Contains("call-1"));
+    ASSERT_EQ(registry.Size(), 1);
+    ASSERT_TRUE(registry.Evict("call-2"));
+    ASSERT_EQ(registry.Size(), 0);
+}
+
+TEST(SessionRegistry, ConcurrentCalls)
+{
+    constexpr int thread_count = 8;
+    constexpr int calls_per_thread = 500;
+
+    SessionRegistry registry;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&registry, t] {
+            for (int i = 0; i < calls_per_thread; ++i) {
+                const std::string call_id = std::to_string(t) + "-" + std::to_string(i);
+                ASSERT_TRUE(registry.Insert(MakeCall(call_id)));
+                ASSERT_TRUE(registry.Update(call_id, [](RecordingSession& session) { session.AddStream(); }));
+                if (i % 2 == 0) {
+                    ASSERT_TRUE(registry.Evict(call_id));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(registry.Size(), thread_count * calls_per_thread / 2);
+    ASSERT_TRUE(registry.Visit("3-1", [](const RecordingSession& session) {
+        ASSERT_EQ(session.MediaStreams().size(), 1);
+    }));
+}